@@ -0,0 +1,48 @@
+# Summarize `nm -S -t d --size-sort` output of an archive into RAM and flash use.
+#
+# Text and read-only data live in flash, zero-initialized data in RAM only,
+# and initialized data in both (RAM image plus its flash copy).
+
+/:$/ {
+	obj = substr($0, 1, length($0) - 1)
+	next
+}
+
+NF == 4 {
+	size = $2 + 0
+	type = $3
+	name = $4
+
+	if (type ~ /^[TtRr]$/) {
+		ram = 0; flash = size
+	} else if (type ~ /^[DdGg]$/) {
+		ram = size; flash = size
+	} else if (type ~ /^[BbSsCc]$/) {
+		ram = size; flash = 0
+	} else {
+		next
+	}
+
+	printf "%-16s %-32s %c %6d %6d\n", obj, name, type, ram, flash
+	total_ram += ram
+	total_flash += flash
+}
+
+BEGIN {
+	printf "%-16s %-32s %c %6s %6s\n", "OBJECT", "SYMBOL", "T", "RAM", "FLASH"
+}
+
+END {
+	printf "%-16s %-32s   %6d %6d\n", "TOTAL", "", total_ram, total_flash
+
+	failed = 0
+	if (check && ram_budget != "" && total_ram > ram_budget + 0) {
+		printf "RAM budget exceeded: %d > %d bytes\n", total_ram, ram_budget
+		failed = 1
+	}
+	if (check && flash_budget != "" && total_flash > flash_budget + 0) {
+		printf "Flash budget exceeded: %d > %d bytes\n", total_flash, flash_budget
+		failed = 1
+	}
+	exit failed
+}
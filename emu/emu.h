@@ -0,0 +1,327 @@
+/*
+  emu.h - Host emulator of a sprite: virtual MCU time, watchdog timer and the
+  CC1101 radio core of the CC430, at the level of the RF1A interface registers,
+  and the sensors on the I2C bus.
+
+  The firmware sources from src/ are compiled unchanged against the register
+  shim in include/cc430f5137.h, which routes every register access here.
+*/
+
+#ifndef EMU_H
+#define EMU_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EMU_XOSC_FREQ        26000000.0  // Radio crystal
+#define EMU_VLO_FREQ         9400.0      // Nominal VLO, see CC430 data sheet
+#define EMU_REFO_FREQ        32768.0
+#define EMU_SUPPLY_VOLTAGE   3.0
+
+#define EMU_RF1A_ACCESS_CYCLES 4     // CPU cycles charged per RF1A register access
+#define EMU_SFR_ACCESS_CYCLES  4     // ... per SFRIFG1 access
+#define EMU_ISR_CYCLES         24    // Interrupt entry and exit
+#define EMU_I2C_INIT_CYCLES    40    // USCI reset and setup per TI_USCI_I2C_*init()
+
+#define EMU_I2C_MAX_DEVICES    4
+
+// RF1A interface registers
+enum {
+	EMU_RF1AIFCTL1,
+	EMU_RF1AIN,
+	EMU_RF1AINSTRW,
+	EMU_RF1AINSTRB,
+	EMU_RF1AINSTR1B,
+	EMU_RF1ADINB,
+	EMU_RF1ASTATB,
+	EMU_RF1ADOUTB,
+	EMU_RF1ADOUT0B,
+	EMU_RF1ADOUT1B,
+	EMU_RF1AIFG,
+	EMU_RF1AIE,
+	EMU_RF1AIES,
+	EMU_RF1AIV,
+	EMU_RF1A_NREGS
+};
+
+// Radio core states
+enum {
+	EMU_RF_SLEEP,
+	EMU_RF_XOFF,
+	EMU_RF_IDLE,
+	EMU_RF_CALIBRATE,
+	EMU_RF_SETTLING,
+	EMU_RF_FSTXON,
+	EMU_RF_TX,
+	EMU_RF_TXFIFO_UNDERFLOW,
+	EMU_RF_RX,
+	EMU_RF_RXFIFO_OVERFLOW,
+	EMU_RF_NSTATES
+};
+
+// RF1A access trace, see emu_rf1a_trace_open(). The file starts with
+// EMU_RFTRACE_MAGIC and holds one little-endian record per event:
+//   uint64 virtual time in ns, uint8 type, uint8 arg, uint8 value,
+//   uint8 radio state after the event, uint32 data
+#define EMU_RFTRACE_MAGIC      "SPRFTRC1"
+#define EMU_RFTRACE_RECORD     16
+
+enum {
+	EMU_RFTRACE_STROBE,     // arg command strobe, value status byte
+	EMU_RFTRACE_WRITE,      // arg register, value written
+	EMU_RFTRACE_READ,       // arg register, value read
+	EMU_RFTRACE_FIFO,       // value byte written to the TX FIFO, data bytes queued
+	EMU_RFTRACE_STATE,      // arg radio state entered
+	EMU_RFTRACE_AIR,        // value byte starting on air, data byte time in ns
+	EMU_RFTRACE_DELAY,      // data length of a __delay_cycles() busy-wait in ns
+};
+
+// A contiguous run of bytes shifted out by the transmitter
+struct emu_burst {
+	double start;           // Virtual time of the first chip in seconds
+	double chip_time;
+	unsigned int length;
+	unsigned int capacity;
+	unsigned char *bytes;
+};
+
+// A packet sent to the sprite by the ground, see emu_rf1a_inject(). It is
+// received if the radio is listening when its sync word starts, and the
+// carrier is on within the RX window.
+struct emu_rx_packet {
+	double start;           // First preamble bit on air
+	double preamble;        // Preamble length in seconds
+	unsigned int length;    // Bytes after the sync word, without the CRC
+	uint8_t bytes[64];      // Length byte first, in variable length mode
+	int crc_ok;
+	uint8_t rssi;           // RSSI status byte appended on reception
+
+	double received_at;     // End of packet signalled to the firmware, or -1
+};
+
+struct emu_rf1a {
+	// Interface registers as seen by the firmware
+	uint16_t ifctl1, in, instrw;
+	uint16_t ifg, ie, ies, iv;
+	uint8_t instrb, instr1b, dinb, statb, doutb, dout0b, dout1b;
+
+	int pending;            // Write-only interface register touched by the last access
+	int target;             // Destination of data bytes, see rf1a.c
+	int autoread;           // Source of the next auto-read byte
+
+	uint8_t regs[0x2F];
+	uint8_t patable[8];
+	uint8_t pa_index;
+
+	int state;
+	int next_state;         // State entered after CALIBRATE/SETTLING
+	double state_until;     // End of CALIBRATE/SETTLING
+	double ready_at;        // Crystal stable and chip ready
+	double next_byte;       // Start of the next byte on air
+
+	uint8_t txfifo[64];
+	unsigned int tx_head, tx_count;
+
+	// Packet handler in TX, unless PKTCTRL0.LENGTH_CONFIG is infinite
+	uint8_t pkt_head[32];   // Preamble and sync word
+	unsigned int pkt_head_len, pkt_head_pos;
+	int pkt_left;           // Payload bytes still to send, -1 before the length byte
+	unsigned int pkt_tail;  // CRC bytes still to send
+	uint16_t pkt_crc, pkt_pn9;
+	unsigned long tx_packets;
+	uint8_t rxfifo[64];
+	unsigned int rx_head, rx_count;
+
+	// Wake-on-radio and reception
+	int wor;                // WOR timer running
+	double wor_next;        // Next Event0
+	double rx_from;         // Start of the RX window
+	double rx_until;        // End of the RX window, INFINITY after SRX
+	struct emu_rx_packet *rx_packet;  // Packet whose sync word was found
+	struct emu_rx_packet *air;        // Packets sent, by start time
+	unsigned int nair, cap_air, air_first;  // air_first: first still on air
+	unsigned long wor_events;
+	unsigned long rx_packets, rx_filtered;
+
+	// Power states
+	double state_since;     // Start of the current state
+	double state_time[EMU_RF_NSTATES];
+	double state_charge[EMU_RF_NSTATES];  // Coulombs
+	unsigned int lost;      // Configured registers reset by SLEEP, not rewritten
+	unsigned long stale_config_tx;  // Transmissions started with such registers
+	unsigned long calibrations;
+	unsigned long uncalibrated_tx;  // Transmissions started without valid FSCAL results
+	double wake_at;         // Wake-up from SLEEP/XOFF awaiting its first TX, or -1
+	unsigned long wakes;
+	double wake_latency, max_wake_latency;
+
+	FILE *trace;            // RF1A access trace, or NULL
+
+	int burst_open;
+	struct emu_burst *bursts;
+	unsigned int nbursts, cap_bursts;
+};
+
+// Sensor samples replayed in a loop by a device model
+struct emu_trace {
+	double *time;
+	int16_t (*value)[3];
+	unsigned int count;
+	double length;          // Loop length in seconds
+};
+
+// A register-map device on the I2C bus, see itg3200.c and hmc5883l.c
+struct emu_i2c_dev {
+	uint8_t address;
+	uint8_t regs[64];
+	uint8_t pointer;        // Register pointer, auto-incremented on access
+	int drdy_pin;           // Energia pin wired to the data ready output, or -1
+
+	const struct emu_trace *trace;
+	double sample_at;       // Time the next output sample is latched
+	double period;          // Output data period, 0 when not sampling
+	unsigned long samples;  // Output samples latched so far
+	unsigned long read_sample;   // Sample returned by the last data read
+	unsigned long stale_reads;   // Data reads that returned that sample again
+	unsigned int data_read;      // Data registers read since the last sample
+	void (*drdy)(void);     // Interrupt handler attached by the firmware
+
+	double charge;          // Coulombs drawn up to charge_since
+	double charge_since;
+
+	void (*update)(struct emu_i2c_dev *d, double now);
+	void (*write)(struct emu_i2c_dev *d, uint8_t reg, uint8_t value, double now);
+	void (*read)(struct emu_i2c_dev *d, uint8_t reg);
+	uint8_t (*next)(const struct emu_i2c_dev *d, uint8_t reg);
+	double (*current)(const struct emu_i2c_dev *d);   // Supply current now
+};
+
+struct emu_i2c_stats {
+	unsigned long transactions;
+	unsigned long bytes;    // Including address bytes
+	unsigned long nacks;
+	double bus_time;        // SCL running
+	double busy_time;       // CPU waiting in the driver
+};
+
+struct emu_i2c {
+	double bus_hz;          // Overrides SMCLK / prescaler when non-zero
+	double rate;            // Bus clock of the current transfer
+	uint8_t address;        // Slave selected by the last *init() call
+	struct emu_i2c_dev *devices[EMU_I2C_MAX_DEVICES];
+	unsigned int ndevices;
+	struct emu_i2c_stats stats;
+};
+
+struct emu_sprite {
+	double now;             // Virtual time in seconds
+	double f_cpu;
+	double f_vlo;           // VLO of this sprite, EMU_VLO_FREQ unless set
+
+	uint16_t wdtctl, wdtctl_seen;
+	uint16_t sfrie1, sfrifg1;
+	double wdt_next;
+
+	// Clock system and power management registers. MCLK and SMCLK stay at
+	// f_cpu whatever the firmware sets up; ACLK follows UCSCTL4.SELA.
+	uint16_t ucsctl[9];
+	uint8_t pmmctl0_h, pmmctl0_l;
+	uint16_t svsmhctl, svsmlctl, pmmifg;
+
+	uint16_t ta0ctl, ta0cctl0, ta0ccr0;
+	double ta0_start;       // Virtual time of the last TACLR or TA0CCR0 interrupt
+
+	uint16_t ta1ctl, ta1r;
+	double ta1_start;       // Virtual time of the last TACLR
+
+	int gie;
+	int in_isr;
+	int wake;
+	int stay_asleep;        // Energia sleep() until wakeup()
+	double asleep;          // Virtual time spent in low power modes
+	double lpm_time[5];     // ... in each of LPM0 to LPM4
+	unsigned long wakeups;  // Returns from low power modes to the firmware
+
+	// One pending device event, e.g. a data ready edge, run at event_at
+	void (*event)(void *arg);
+	void *event_arg;
+	double event_at;
+
+	struct emu_rf1a rf;
+	struct emu_i2c i2c;
+};
+
+// Energy drawn by a sprite so far, in joules, see energy.c
+struct emu_energy {
+	double voltage;
+	double duration;
+	double cpu_active;
+	double cpu_lpm[5];
+	double radio[EMU_RF_NSTATES];
+	double sensor[EMU_I2C_MAX_DEVICES];
+	double i2c_pullups;
+	double total;
+};
+
+extern __thread struct emu_sprite *emu_cur;
+
+// Sprite lifecycle; emu_cur must point at the sprite while its firmware runs
+void emu_sprite_init(struct emu_sprite *s, double f_cpu);
+void emu_sprite_free(struct emu_sprite *s);
+
+// MCU
+void emu_advance(double cycles);
+void emu_delay_cycles(unsigned long cycles);
+void emu_bis_sr(unsigned int bits);
+void emu_bic_sr(unsigned int bits);
+void emu_bic_sr_on_exit(unsigned int bits);
+void emu_nop(void);
+void emu_irq(void (*isr)(void));
+void emu_sleep(uint32_t milliseconds);
+void emu_wakeup(void);
+void emu_schedule(double at, void (*event)(void *arg), void *arg);
+volatile uint16_t *emu_ta0ctl(void);
+volatile uint16_t *emu_ta1ctl(void);
+volatile uint16_t *emu_ta1r(void);
+volatile uint16_t *emu_sfrifg1(void);
+
+// Radio core
+void emu_rf1a_init(struct emu_rf1a *rf);
+void emu_rf1a_free(struct emu_rf1a *rf);
+volatile void *emu_rf1a_reg(int reg);
+void emu_rf1a_update(struct emu_rf1a *rf, double now);
+double emu_rf1a_chip_rate(const struct emu_rf1a *rf);
+void emu_rf1a_inject(struct emu_rf1a *rf, const struct emu_rx_packet *p);
+double emu_rf1a_next_event(struct emu_rf1a *rf);
+void emu_rf1a_account(struct emu_rf1a *rf, double now);
+double emu_rf1a_current(int state);
+int emu_rf1a_pa_dbm(uint8_t patable);
+double emu_rf1a_tx_current(uint8_t patable);
+int emu_rf1a_trace_open(struct emu_rf1a *rf, const char *path);
+void emu_rf1a_trace(struct emu_rf1a *rf, double t, int type, unsigned int arg,
+                    unsigned int value, uint32_t data);
+
+// I2C bus and sensor models
+void emu_i2c_attach(struct emu_i2c *bus, struct emu_i2c_dev *d);
+void emu_i2c_attach_interrupt(int pin, void (*isr)(void));
+void emu_i2c_account(struct emu_i2c_dev *d, double t);
+void emu_itg3200_init(struct emu_i2c_dev *d, uint8_t address, const struct emu_trace *trace);
+void emu_hmc5883l_init(struct emu_i2c_dev *d, const struct emu_trace *trace);
+int emu_trace_load(struct emu_trace *trace, const char *path);
+void emu_trace_free(struct emu_trace *trace);
+void emu_trace_value(const struct emu_trace *trace, double t, int16_t value[3]);
+
+// Energy
+void emu_energy(struct emu_sprite *s, double voltage, struct emu_energy *e);
+void emu_energy_print(const struct emu_energy *e, const struct emu_sprite *s,
+                      unsigned long bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EMU_H
@@ -0,0 +1,106 @@
+/*
+  energy.c - Energy drawn by an emulated sprite.
+
+  Integrates the supply current of the CPU in active mode and in each low
+  power mode, of the radio core in each state (TX at the selected PATABLE
+  setting), of the sensor models and of the I2C pull-ups over virtual time.
+  Currents are typical data sheet values at 3 V.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "emu.h"
+
+// CC430F5137 data sheet: active mode executing from flash, about 2.6 mA at
+// 8 MHz, and the low power modes with the DCO, REFO or VLO left running
+#define CPU_ACTIVE_CURRENT_PER_HZ 330e-12
+
+static const double LPM_CURRENT[5] = {
+	90e-6,  // LPM0, DCO and FLL on at 8 MHz
+	80e-6,  // LPM1
+	6.5e-6, // LPM2
+	2.0e-6, // LPM3, watchdog on ACLK
+	1.1e-6, // LPM4
+};
+
+#define I2C_PULLUP_OHMS 4700.0
+
+static const char *STATE_NAME[EMU_RF_NSTATES] = {
+	[EMU_RF_SLEEP] = "SLEEP",
+	[EMU_RF_XOFF] = "XOFF",
+	[EMU_RF_IDLE] = "IDLE",
+	[EMU_RF_CALIBRATE] = "CALIBRATE",
+	[EMU_RF_SETTLING] = "SETTLING",
+	[EMU_RF_FSTXON] = "FSTXON",
+	[EMU_RF_TX] = "TX",
+	[EMU_RF_TXFIFO_UNDERFLOW] = "TX_UNDERFLOW",
+	[EMU_RF_RX] = "RX",
+	[EMU_RF_RXFIFO_OVERFLOW] = "RX_OVERFLOW",
+};
+
+void emu_energy(struct emu_sprite *s, double voltage, struct emu_energy *e)
+{
+	unsigned int i;
+
+	memset(e, 0, sizeof(*e));
+	e->voltage = voltage;
+	e->duration = s->now;
+
+	e->cpu_active = (s->now - s->asleep) * CPU_ACTIVE_CURRENT_PER_HZ * s->f_cpu * voltage;
+	for (i = 0; i < 5; i++)
+		e->cpu_lpm[i] = s->lpm_time[i] * LPM_CURRENT[i] * voltage;
+
+	emu_rf1a_account(&s->rf, s->now);
+	for (i = 0; i < EMU_RF_NSTATES; i++)
+		e->radio[i] = s->rf.state_charge[i] * voltage;
+
+	for (i = 0; i < s->i2c.ndevices; i++) {
+		emu_i2c_account(s->i2c.devices[i], s->now);
+		e->sensor[i] = s->i2c.devices[i]->charge * voltage;
+	}
+	// SDA and SCL are each pulled low for about half of the bus time
+	e->i2c_pullups = s->i2c.stats.bus_time * voltage * voltage / I2C_PULLUP_OHMS;
+
+	e->total = e->cpu_active + e->i2c_pullups;
+	for (i = 0; i < 5; i++)
+		e->total += e->cpu_lpm[i];
+	for (i = 0; i < EMU_RF_NSTATES; i++)
+		e->total += e->radio[i];
+	for (i = 0; i < EMU_I2C_MAX_DEVICES; i++)
+		e->total += e->sensor[i];
+}
+
+static void print_line(const char *name, double joules, double total)
+{
+	if (joules > 0.0)
+		printf("  %-18s %12.1f %6.2f%%\n", name, joules * 1e6, 100.0 * joules / total);
+}
+
+void emu_energy_print(const struct emu_energy *e, const struct emu_sprite *s,
+                      unsigned long bytes)
+{
+	char name[32];
+	unsigned int i;
+
+	printf("energy at %.1f V        uJ      share\n", e->voltage);
+	print_line("CPU active", e->cpu_active, e->total);
+	for (i = 0; i < 5; i++) {
+		snprintf(name, sizeof(name), "CPU LPM%u", i);
+		print_line(name, e->cpu_lpm[i], e->total);
+	}
+	for (i = 0; i < EMU_RF_NSTATES; i++) {
+		snprintf(name, sizeof(name), "radio %s", STATE_NAME[i]);
+		print_line(name, e->radio[i], e->total);
+	}
+	for (i = 0; i < s->i2c.ndevices; i++) {
+		snprintf(name, sizeof(name), "sensor 0x%02X", s->i2c.devices[i]->address);
+		print_line(name, e->sensor[i], e->total);
+	}
+	print_line("I2C pull-ups", e->i2c_pullups, e->total);
+	printf("total %.1f uJ in %.3f s (%.1f uW)", e->total * 1e6, e->duration,
+	       e->duration > 0.0 ? e->total / e->duration * 1e6 : 0.0);
+	if (bytes)
+		printf(", %.1f uJ per byte", e->total / bytes * 1e6);
+	printf("\n");
+}
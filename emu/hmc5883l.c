@@ -0,0 +1,188 @@
+/*
+  hmc5883l.c - Behavioural model of the HMC5883L magnetometer on the emulated
+  I2C bus.
+
+  A single measurement takes 6 ms, after which the data registers are latched,
+  RDY is set, DRDY falls and the device returns to idle. In continuous mode
+  samples are latched at the configured output rate. The data registers stay
+  locked while a read of them is in progress, and RDY clears once all six have
+  been read.
+*/
+
+#include <string.h>
+#include <math.h>
+
+#include "emu.h"
+
+#define CONFIG_A    0x00
+#define CONFIG_B    0x01
+#define MODE        0x02
+#define DATA_X_H    0x03
+#define DATA_Y_L    0x08
+#define STATUS      0x09
+#define ID_A        0x0A
+#define ID_C        0x0C
+
+#define MODE_CONTINUOUS 0x00
+#define MODE_SINGLE     0x01
+#define MODE_IDLE       0x02
+
+#define STATUS_RDY  0x01
+#define STATUS_LOCK 0x02
+
+#define ADDRESS     0x1E
+#define MEASUREMENT_TIME 6e-3
+
+#define MEASUREMENT_CURRENT 100e-6  // Data sheet, averaged over a measurement
+#define IDLE_CURRENT        2e-6
+
+static const double OUTPUT_RATE[8] = { 0.75, 1.5, 3.0, 7.5, 15.0, 30.0, 75.0, 75.0 };
+
+static void put16(uint8_t *reg, int16_t value)
+{
+	reg[0] = (uint16_t)value >> 8;
+	reg[1] = value & 0xFF;
+}
+
+static void latch(struct emu_i2c_dev *d, double t)
+{
+	int16_t b[3];
+
+	if (d->regs[STATUS] & STATUS_LOCK)
+		return;
+
+	if (d->trace) {
+		emu_trace_value(d->trace, t, b);
+	} else {
+		// Field of about 30 uT at 0.73 mG/LSb, rotating with the sprite
+		b[0] = 400 * cos(0.5 * t);
+		b[1] = 400 * sin(0.5 * t);
+		b[2] = -150;
+	}
+	// Registers are ordered X, Z, Y
+	put16(&d->regs[DATA_X_H], b[0]);
+	put16(&d->regs[DATA_X_H + 2], b[2]);
+	put16(&d->regs[DATA_X_H + 4], b[1]);
+	d->regs[STATUS] |= STATUS_RDY;
+	d->samples++;
+	d->data_read = 0;
+}
+
+static void sample(struct emu_i2c_dev *d, double t)
+{
+	latch(d, t);
+	if ((d->regs[MODE] & 0x03) == MODE_SINGLE) {
+		emu_i2c_account(d, t);
+		d->regs[MODE] = (d->regs[MODE] & ~0x03) | MODE_IDLE;
+		d->period = 0.0;
+	} else {
+		d->sample_at = t + d->period;
+	}
+}
+
+static void update(struct emu_i2c_dev *d, double now)
+{
+	while (d->period > 0.0 && d->sample_at <= now)
+		sample(d, d->sample_at);
+}
+
+// DRDY falls when a sample is latched
+static void drdy_event(void *arg)
+{
+	struct emu_i2c_dev *d = arg;
+
+	unsigned long samples = d->samples;
+
+	update(d, emu_cur->now);
+	if (d->drdy && d->samples != samples)
+		emu_irq(d->drdy);
+	if (d->period > 0.0)
+		emu_schedule(d->sample_at, drdy_event, d);
+}
+
+static void write(struct emu_i2c_dev *d, uint8_t reg, uint8_t value, double now)
+{
+	if (reg > MODE)
+		return;     // Read-only
+	emu_i2c_account(d, now);
+	d->regs[reg] = value;
+	// The gain and output rate apply from the next measurement on
+	if (reg != MODE)
+		return;
+
+	switch (d->regs[MODE] & 0x03) {
+	case MODE_SINGLE:
+		d->period = MEASUREMENT_TIME;
+		d->sample_at = now + MEASUREMENT_TIME;
+		break;
+	case MODE_CONTINUOUS:
+		d->period = 1.0 / OUTPUT_RATE[(d->regs[CONFIG_A] >> 2) & 0x07];
+		d->sample_at = now + d->period;
+		break;
+	default:
+		d->period = 0.0;
+		return;
+	}
+	d->regs[STATUS] &= ~(STATUS_RDY | STATUS_LOCK);
+	if (d->drdy)
+		emu_schedule(d->sample_at, drdy_event, d);
+}
+
+static void read(struct emu_i2c_dev *d, uint8_t reg)
+{
+	if (reg < DATA_X_H || reg > DATA_Y_L)
+		return;
+
+	if (reg == DATA_X_H) {
+		if (d->samples == d->read_sample)
+			d->stale_reads++;
+		d->read_sample = d->samples;
+	}
+	d->data_read |= 1u << (reg - DATA_X_H);
+	if (d->data_read == 0x3F) {
+		d->regs[STATUS] &= ~(STATUS_RDY | STATUS_LOCK);
+		d->data_read = 0;
+	} else {
+		d->regs[STATUS] |= STATUS_LOCK;
+	}
+}
+
+static double current(const struct emu_i2c_dev *d)
+{
+	return d->period > 0.0 ? MEASUREMENT_CURRENT : IDLE_CURRENT;
+}
+
+// The pointer wraps from the last data register back to the first, so that
+// repeated burst reads return the data registers
+static uint8_t next(const struct emu_i2c_dev *d, uint8_t reg)
+{
+	if (reg == DATA_Y_L)
+		return DATA_X_H;
+	if (reg >= ID_C)
+		return 0;
+	return reg + 1;
+}
+
+void emu_hmc5883l_init(struct emu_i2c_dev *d, const struct emu_trace *trace)
+{
+	memset(d, 0, sizeof(*d));
+	d->address = ADDRESS;
+	d->drdy_pin = -1;
+	d->trace = trace;
+	d->regs[CONFIG_A] = 0x10;
+	d->regs[CONFIG_B] = 0x20;
+	d->regs[MODE] = MODE_SINGLE;
+	d->regs[ID_A] = 'H';
+	d->regs[ID_A + 1] = '4';
+	d->regs[ID_A + 2] = '3';
+
+	d->update = update;
+	d->write = write;
+	d->read = read;
+	d->next = next;
+	d->current = current;
+
+	// Powers up in single measurement mode with one conversion pending
+	d->period = MEASUREMENT_TIME;
+	d->sample_at = MEASUREMENT_TIME;
+}
@@ -0,0 +1,207 @@
+/*
+  i2c.c - USCI_B0 I2C master of an emulated CC430 and the sensors on its bus.
+
+  Implements the TI_USCI_I2C_* driver API used by src/gyro.c and src/mag.c on
+  top of register-map device models. A transfer runs START, the address byte,
+  the data bytes and STOP at the bus clock, each byte taking 9 SCL periods;
+  the CPU waits for the transfer to finish, as the firmware would by polling
+  TI_USCI_I2C_notready().
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "emu.h"
+#include "TI_USCI_I2C_master.h"
+
+void emu_i2c_attach(struct emu_i2c *bus, struct emu_i2c_dev *d)
+{
+	if (bus->ndevices < EMU_I2C_MAX_DEVICES)
+		bus->devices[bus->ndevices++] = d;
+}
+
+void emu_i2c_attach_interrupt(int pin, void (*isr)(void))
+{
+	struct emu_i2c *bus = &emu_cur->i2c;
+	unsigned int i;
+
+	for (i = 0; i < bus->ndevices; i++) {
+		if (bus->devices[i]->drdy_pin == pin)
+			bus->devices[i]->drdy = isr;
+	}
+}
+
+// Charge the device's current up to time t; models call this before any
+// change of their power state
+void emu_i2c_account(struct emu_i2c_dev *d, double t)
+{
+	if (t > d->charge_since) {
+		d->charge += (t - d->charge_since) * d->current(d);
+		d->charge_since = t;
+	}
+}
+
+static struct emu_i2c_dev *find(struct emu_i2c *bus, uint8_t address)
+{
+	unsigned int i;
+
+	for (i = 0; i < bus->ndevices; i++) {
+		if (bus->devices[i]->address == address)
+			return bus->devices[i];
+	}
+	return NULL;
+}
+
+static void init(uint8_t address, uint8_t prescale)
+{
+	struct emu_sprite *s = emu_cur;
+
+	s->i2c.address = address;
+	s->i2c.rate = s->i2c.bus_hz ? s->i2c.bus_hz : s->f_cpu / (prescale ? prescale : 1);
+	s->i2c.stats.busy_time += EMU_I2C_INIT_CYCLES / s->f_cpu;
+	emu_advance(EMU_I2C_INIT_CYCLES);
+}
+
+// Run the bus for a transfer of length data bytes, returning the device
+static struct emu_i2c_dev *transfer(unsigned int length)
+{
+	struct emu_sprite *s = emu_cur;
+	struct emu_i2c *bus = &s->i2c;
+	struct emu_i2c_dev *d = find(bus, bus->address);
+	double t;
+
+	// A missing device NACKs its address and the master stops
+	if (!d) {
+		bus->stats.nacks++;
+		length = 0;
+	}
+	t = (2 + 9 * (1 + length)) / bus->rate;
+
+	bus->stats.transactions++;
+	bus->stats.bytes += 1 + length;
+	bus->stats.bus_time += t;
+	bus->stats.busy_time += t;
+	emu_advance(t * s->f_cpu);
+
+	if (d)
+		d->update(d, s->now);
+	return d;
+}
+
+void TI_USCI_I2C_transmitinit(unsigned char slave_address, unsigned char prescale)
+{
+	init(slave_address, prescale);
+}
+
+void TI_USCI_I2C_receiveinit(unsigned char slave_address, unsigned char prescale)
+{
+	init(slave_address, prescale);
+}
+
+// The first byte written sets the register pointer, the others are stored
+void TI_USCI_I2C_transmit(unsigned char *field, unsigned char byteCount)
+{
+	struct emu_i2c_dev *d = transfer(byteCount);
+	unsigned int i;
+
+	if (!d || byteCount == 0)
+		return;
+	d->pointer = field[0];
+	for (i = 1; i < byteCount; i++) {
+		d->write(d, d->pointer, field[i], emu_cur->now);
+		d->pointer = d->next(d, d->pointer);
+	}
+}
+
+void TI_USCI_I2C_receive(unsigned char *field, unsigned char byteCount)
+{
+	struct emu_i2c_dev *d = transfer(byteCount);
+	unsigned int i;
+
+	for (i = 0; i < byteCount; i++) {
+		if (!d) {
+			field[i] = 0xFF;
+			continue;
+		}
+		field[i] = d->regs[d->pointer & 0x3F];
+		d->read(d, d->pointer);
+		d->pointer = d->next(d, d->pointer);
+	}
+}
+
+unsigned char TI_USCI_I2C_slave_present(unsigned char slave_address)
+{
+	return find(&emu_cur->i2c, slave_address) != NULL;
+}
+
+unsigned char TI_USCI_I2C_notready(void)
+{
+	return 0;
+}
+
+// Trace files hold one sample per line: time in seconds, then three raw
+// register values. Lines starting with '#' are ignored.
+int emu_trace_load(struct emu_trace *trace, const char *path)
+{
+	FILE *f = fopen(path, "r");
+	unsigned int capacity = 0;
+	char line[256];
+
+	memset(trace, 0, sizeof(*trace));
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		double t;
+		int x, y, z;
+
+		if (line[0] == '#' || sscanf(line, "%lf,%d,%d,%d", &t, &x, &y, &z) != 4)
+			continue;
+		if (trace->count == capacity) {
+			capacity = capacity ? 2 * capacity : 256;
+			trace->time = realloc(trace->time, capacity * sizeof(*trace->time));
+			trace->value = realloc(trace->value, capacity * sizeof(*trace->value));
+		}
+		trace->time[trace->count] = t;
+		trace->value[trace->count][0] = x;
+		trace->value[trace->count][1] = y;
+		trace->value[trace->count][2] = z;
+		trace->count++;
+	}
+	fclose(f);
+
+	if (trace->count == 0)
+		return -1;
+	// Loop one sample period after the last sample
+	trace->length = trace->time[trace->count - 1] - trace->time[0];
+	if (trace->count > 1)
+		trace->length += trace->length / (trace->count - 1);
+	return 0;
+}
+
+void emu_trace_free(struct emu_trace *trace)
+{
+	free(trace->time);
+	free(trace->value);
+	memset(trace, 0, sizeof(*trace));
+}
+
+// Latest recorded sample at time t
+void emu_trace_value(const struct emu_trace *trace, double t, int16_t value[3])
+{
+	unsigned int lo = 0, hi = trace->count;
+
+	if (trace->length > 0.0)
+		t = trace->time[0] + fmod(t, trace->length);
+	while (hi - lo > 1) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (trace->time[mid] <= t)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	memcpy(value, trace->value[lo], sizeof(trace->value[lo]));
+}
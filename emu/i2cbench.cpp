@@ -0,0 +1,183 @@
+/*
+  i2cbench.cpp - Run the gyro and magnetometer drivers against the emulated
+  I2C bus and report what each read() costs.
+
+  For every read the bench records the bus transactions and bytes, the time
+  SCL was running, the time the CPU spent waiting in the I2C driver, the time
+  it slept (e.g. through a magnetometer conversion) and the total latency. The
+  values returned by the drivers are checked against the device registers.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "emu.h"
+#include "gyro.h"
+#include "mag.h"
+#include "ITG3200.h"
+#include "HMC5883L.h"
+#include "Energia.h"
+
+extern "C" {
+void SpriteRadio_SpriteRadio();
+void delay(uint32_t milliseconds);
+}
+
+struct snapshot {
+	struct emu_i2c_stats i2c;
+	double now, asleep;
+};
+
+struct read_cost {
+	unsigned long reads, mismatches, timeouts;
+	unsigned long transactions, bytes;
+	double bus_time, busy_time, asleep, latency, max_latency;
+};
+
+static void take(snapshot *p)
+{
+	p->i2c = emu_cur->i2c.stats;
+	p->now = emu_cur->now;
+	p->asleep = emu_cur->asleep;
+}
+
+static void account(read_cost *c, const snapshot *before)
+{
+	snapshot after;
+	double latency;
+
+	take(&after);
+	latency = after.now - before->now;
+	c->reads++;
+	c->transactions += after.i2c.transactions - before->i2c.transactions;
+	c->bytes += after.i2c.bytes - before->i2c.bytes;
+	c->bus_time += after.i2c.bus_time - before->i2c.bus_time;
+	c->busy_time += after.i2c.busy_time - before->i2c.busy_time;
+	c->asleep += after.asleep - before->asleep;
+	c->latency += latency;
+	if (latency > c->max_latency)
+		c->max_latency = latency;
+}
+
+static int16_t reg16(const emu_i2c_dev *d, uint8_t reg)
+{
+	return (int16_t)((d->regs[reg] << 8) | d->regs[reg + 1]);
+}
+
+static void report(const char *name, const read_cost *c, const emu_i2c_dev *d)
+{
+	double n = c->reads ? c->reads : 1;
+
+	printf("%-4s %lu reads: %.1f transactions, %.1f bytes per read\n"
+	       "     bus %.1f us, CPU busy %.1f us, asleep %.1f us, latency %.1f us (max %.1f us)\n"
+	       "     %lu samples latched, %lu stale reads, %lu mismatches, %lu timeouts\n",
+	       name, c->reads, c->transactions / n, c->bytes / n,
+	       c->bus_time / n * 1e6, c->busy_time / n * 1e6, c->asleep / n * 1e6,
+	       c->latency / n * 1e6, c->max_latency * 1e6,
+	       d->samples, d->stale_reads, c->mismatches, c->timeouts);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -n N       reads of each sensor (default 1000)\n"
+		"  -r HZ      read rate (default 50)\n"
+		"  -b HZ      I2C bus speed (default: SMCLK / I2C_PRESCALE)\n"
+		"  -G FILE    gyro trace to replay (t,x,y,z raw LSb per line)\n"
+		"  -M FILE    magnetometer trace to replay\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	emu_trace gyro_trace = emu_trace(), mag_trace = emu_trace();
+	emu_i2c_dev gyro_dev, mag_dev;
+	read_cost gyro_cost = read_cost(), mag_cost = read_cost();
+	unsigned long reads = 1000, i;
+	double rate = 50.0, bus_hz = 0.0;
+	emu_sprite s;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:b:G:M:h")) != -1) {
+		switch (opt) {
+		case 'n': reads = strtoul(optarg, NULL, 0); break;
+		case 'r': rate = strtod(optarg, NULL); break;
+		case 'b': bus_hz = strtod(optarg, NULL); break;
+		case 'G':
+			if (emu_trace_load(&gyro_trace, optarg)) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		case 'M':
+			if (emu_trace_load(&mag_trace, optarg)) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (rate <= 0.0 || rate > 1000.0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	emu_sprite_init(&s, F_CPU);
+	emu_cur = &s;
+	s.gie = 1;
+	s.i2c.bus_hz = bus_hz;
+
+	emu_itg3200_init(&gyro_dev, GYRO_ADDRESS, gyro_trace.count ? &gyro_trace : NULL);
+	emu_hmc5883l_init(&mag_dev, mag_trace.count ? &mag_trace : NULL);
+#ifdef MAG_DRDY_PIN
+	mag_dev.drdy_pin = MAG_DRDY_PIN;
+#endif
+	emu_i2c_attach(&s.i2c, &gyro_dev);
+	emu_i2c_attach(&s.i2c, &mag_dev);
+
+	// Starts the watchdog timekeeping behind delay()
+	SpriteRadio_SpriteRadio();
+
+	SpriteGyro gyro;
+	SpriteMag mag;
+	gyro.init();
+	mag.init();
+
+	for (i = 0; i < reads; i++) {
+		snapshot before;
+
+		take(&before);
+		AngularVelocity w = gyro.read();
+		account(&gyro_cost, &before);
+		if (w.x != reg16(&gyro_dev, 0x1D) || w.y != reg16(&gyro_dev, 0x1F) ||
+		    w.z != reg16(&gyro_dev, 0x21))
+			gyro_cost.mismatches++;
+
+		take(&before);
+		MagneticField b = mag.read();
+		account(&mag_cost, &before);
+		if (isnan(b.x))
+			mag_cost.timeouts++;
+		else if (fabs(b.x + .073 * reg16(&mag_dev, 0x03)) > 1e-3 ||
+		    fabs(b.z - .073 * reg16(&mag_dev, 0x05)) > 1e-3 ||
+		    fabs(b.y + .073 * reg16(&mag_dev, 0x07)) > 1e-3)
+			mag_cost.mismatches++;
+
+		delay((uint32_t)(1000.0 / rate));
+	}
+
+	report("gyro", &gyro_cost, &gyro_dev);
+	report("mag", &mag_cost, &mag_dev);
+	printf("bus at %.0f kHz: %lu transactions, %lu bytes, %lu NACKs in %.1f s\n",
+	       s.i2c.rate / 1e3, s.i2c.stats.transactions, s.i2c.stats.bytes,
+	       s.i2c.stats.nacks, s.now);
+
+	emu_sprite_free(&s);
+	emu_trace_free(&gyro_trace);
+	emu_trace_free(&mag_trace);
+	return 0;
+}
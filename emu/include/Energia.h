@@ -0,0 +1,41 @@
+/*
+  Energia.h - The few Energia core functions used by the sensor drivers,
+  mapped onto the emulator.
+*/
+
+#ifndef ENERGIA_H
+#define ENERGIA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cc430f5137.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void delay(uint32_t milliseconds);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define RISING  0
+#define FALLING 1
+
+#define P2_0 19
+
+// As in the Energia core, wakeup() from an interrupt handler ends sleep()
+// early and suspend()
+#define sleep(ms)                       emu_sleep(ms)
+#define suspend()                       emu_bis_sr(LPM4_bits | GIE)
+#define wakeup()                        emu_wakeup()
+#define pinMode(pin, mode)              ((void)(pin), (void)(mode))
+#define attachInterrupt(pin, isr, mode) emu_i2c_attach_interrupt(pin, isr)
+
+#endif // ENERGIA_H
@@ -0,0 +1,31 @@
+/*
+  TI_USCI_I2C_master.h - Host stand-in for the USCI_B0 I2C master driver,
+  backed by the bus and sensor models of the emulator (see i2c.c).
+*/
+
+#ifndef TI_USCI_I2C_MASTER_H
+#define TI_USCI_I2C_MASTER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SMCLK divider for the bus clock: 400 kHz at 8 MHz
+#ifndef I2C_PRESCALE
+#define I2C_PRESCALE 20
+#endif
+
+void TI_USCI_I2C_receiveinit(unsigned char slave_address, unsigned char prescale);
+void TI_USCI_I2C_transmitinit(unsigned char slave_address, unsigned char prescale);
+
+void TI_USCI_I2C_receive(unsigned char *field, unsigned char byteCount);
+void TI_USCI_I2C_transmit(unsigned char *field, unsigned char byteCount);
+
+unsigned char TI_USCI_I2C_slave_present(unsigned char slave_address);
+unsigned char TI_USCI_I2C_notready(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TI_USCI_I2C_MASTER_H
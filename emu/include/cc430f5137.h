@@ -0,0 +1,296 @@
+/*
+  cc430f5137.h - Host stand-in for the TI device header, used by the emulator.
+
+  Only the registers, bits and intrinsics used by libsprite are provided.
+  Peripheral registers are fields of the current emulated sprite, and RF1A
+  interface registers go through emu_rf1a_reg() so that the radio core model
+  sees every access.
+*/
+
+#ifndef EMU_CC430F5137_H
+#define EMU_CC430F5137_H
+
+#include <stdint.h>
+
+#include "emu.h"
+
+#define __MSP430_HAS_SFR__
+
+/* Bits */
+#define BIT0 (0x0001)
+#define BIT1 (0x0002)
+#define BIT2 (0x0004)
+#define BIT3 (0x0008)
+#define BIT4 (0x0010)
+#define BIT5 (0x0020)
+#define BIT6 (0x0040)
+#define BIT7 (0x0080)
+#define BIT8 (0x0100)
+#define BIT9 (0x0200)
+#define BITA (0x0400)
+#define BITB (0x0800)
+#define BITC (0x1000)
+#define BITD (0x2000)
+#define BITE (0x4000)
+#define BITF (0x8000)
+
+/* Status register */
+#define GIE     (0x0008)
+#define CPUOFF  (0x0010)
+#define OSCOFF  (0x0020)
+#define SCG0    (0x0040)
+#define SCG1    (0x0080)
+
+#define LPM0_bits (CPUOFF)
+#define LPM1_bits (SCG0+CPUOFF)
+#define LPM2_bits (SCG1+CPUOFF)
+#define LPM3_bits (SCG1+SCG0+CPUOFF)
+#define LPM4_bits (SCG1+SCG0+OSCOFF+CPUOFF)
+
+/* Intrinsics */
+#define __delay_cycles(n)             emu_delay_cycles(n)
+#define __bis_SR_register(x)          emu_bis_sr(x)
+#define __bic_SR_register(x)          emu_bic_sr(x)
+#define __bic_SR_register_on_exit(x)  emu_bic_sr_on_exit(x)
+#define _get_interrupt_state()        (emu_cur->gie ? GIE : 0)
+#define __dint()                      (emu_cur->gie = 0)
+#define __eint()                      (emu_cur->gie = 1)
+#define __nop()                       emu_nop()
+
+/* Interrupt handlers are plain functions called by the emulator */
+#define interrupt(vector)             used
+
+#define TIMER0_A0_VECTOR (59)
+#define WDT_VECTOR      (57)
+#define CC1101_VECTOR   (54)
+
+/* Special function registers */
+#define SFRIE1          (emu_cur->sfrie1)
+#define SFRIFG1         (*emu_sfrifg1())
+#define WDTIE           (0x0001)
+#define WDTIFG          (0x0001)
+
+/* Unified clock system */
+#define UCSCTL0         (emu_cur->ucsctl[0])
+#define UCSCTL1         (emu_cur->ucsctl[1])
+#define UCSCTL2         (emu_cur->ucsctl[2])
+#define UCSCTL3         (emu_cur->ucsctl[3])
+#define UCSCTL4         (emu_cur->ucsctl[4])
+#define UCSCTL5         (emu_cur->ucsctl[5])
+#define UCSCTL6         (emu_cur->ucsctl[6])
+#define UCSCTL7         (emu_cur->ucsctl[7])
+#define UCSCTL8         (emu_cur->ucsctl[8])
+
+#define DCORSEL_0       (0x0000)
+#define DCORSEL_1       (0x0010)
+#define DCORSEL_2       (0x0020)
+#define DCORSEL_3       (0x0030)
+#define DCORSEL_4       (0x0040)
+#define DCORSEL_5       (0x0050)
+#define DCORSEL_6       (0x0060)
+#define DCORSEL_7       (0x0070)
+#define FLLD_1          (0x1000)
+#define SELREF__REFOCLK (0x0020)
+#define SELA_7          (0x0700)
+#define SELA__VLOCLK    (0x0100)
+#define SELA__REFOCLK   (0x0200)
+#define SELA__DCOCLK    (0x0300)
+#define SELA__DCOCLKDIV (0x0400)
+#define SELM_7          (0x0007)
+#define SELS_7          (0x0070)
+#define SELM__DCOCLKDIV (0x0004)
+#define SELS__DCOCLKDIV (0x0040)
+#define DCOFFG          (0x0001)
+
+/* Power management module */
+#define PMMCTL0_H       (emu_cur->pmmctl0_h)
+#define PMMCTL0_L       (emu_cur->pmmctl0_l)
+#define SVSMHCTL        (emu_cur->svsmhctl)
+#define SVSMLCTL        (emu_cur->svsmlctl)
+#define PMMIFG          (emu_cur->pmmifg)
+
+#define PMMPW_H         (0xA5)
+#define PMMCOREV0       (0x0001)
+#define PMMCOREV_3      (0x0003)
+#define SVSMHRRL0       (0x0001)
+#define SVSHRVL0        (0x0100)
+#define SVSHE           (0x0400)
+#define SVMHE           (0x4000)
+#define SVSMLRRL0       (0x0001)
+#define SVSLRVL0        (0x0100)
+#define SVSLE           (0x0400)
+#define SVMLE           (0x4000)
+#define SVSMLDLYIFG     (0x0001)
+#define SVMLIFG         (0x0002)
+#define SVMLVLRIFG      (0x0004)
+
+/* Timer_A0 and Timer_A1 */
+#define TA0CTL          (*emu_ta0ctl())
+#define TA0CCTL0        (emu_cur->ta0cctl0)
+#define TA0CCR0         (emu_cur->ta0ccr0)
+#define TA1CTL          (*emu_ta1ctl())
+#define TA1R            (*emu_ta1r())
+#define TASSEL_1        (0x0100)
+#define TASSEL_2        (0x0200)
+#define ID_0            (0x0000)
+#define ID_1            (0x0040)
+#define ID_2            (0x0080)
+#define ID_3            (0x00C0)
+#define MC_0            (0x0000)
+#define MC_1            (0x0010)
+#define MC_2            (0x0020)
+#define TACLR           (0x0004)
+#define CCIE            (0x0010)
+#define CCIFG           (0x0001)
+
+/* Watchdog timer */
+#define WDTCTL          (emu_cur->wdtctl)
+#define WDTPW           (0x5A00)
+#define WDTHOLD         (0x0080)
+#define WDTSSEL1        (0x0040)
+#define WDTSSEL0        (0x0020)
+#define WDTTMSEL        (0x0010)
+#define WDTCNTCL        (0x0008)
+#define WDTIS2          (0x0004)
+#define WDTIS1          (0x0002)
+#define WDTIS0          (0x0001)
+
+#define WDTSSEL__SMCLK  (0x0000)
+#define WDTSSEL__ACLK   (0x0020)
+#define WDTSSEL__VLO    (0x0040)
+
+#define WDT_MDLY_32     (WDTPW+WDTTMSEL+WDTCNTCL+WDTIS2)
+#define WDT_MDLY_8      (WDTPW+WDTTMSEL+WDTCNTCL+WDTIS2+WDTIS0)
+#define WDT_MDLY_0_5    (WDTPW+WDTTMSEL+WDTCNTCL+WDTIS2+WDTIS1)
+#define WDT_MDLY_0_064  (WDTPW+WDTTMSEL+WDTCNTCL+WDTIS2+WDTIS1+WDTIS0)
+#define WDT_ADLY_1000   (WDTPW+WDTTMSEL+WDTCNTCL+WDTIS2+WDTSSEL0)
+#define WDT_ADLY_250    (WDTPW+WDTTMSEL+WDTCNTCL+WDTIS2+WDTIS0+WDTSSEL0)
+#define WDT_ADLY_16     (WDTPW+WDTTMSEL+WDTCNTCL+WDTIS2+WDTIS1+WDTSSEL0)
+#define WDT_ADLY_1_9    (WDTPW+WDTTMSEL+WDTCNTCL+WDTIS2+WDTIS1+WDTIS0+WDTSSEL0)
+
+/* RF1A interface */
+#define RF1AIFCTL1      (*(volatile uint16_t *)emu_rf1a_reg(EMU_RF1AIFCTL1))
+#define RF1AIN          (*(volatile uint16_t *)emu_rf1a_reg(EMU_RF1AIN))
+#define RF1AINSTRW      (*(volatile uint16_t *)emu_rf1a_reg(EMU_RF1AINSTRW))
+#define RF1AINSTRB      (*(volatile uint8_t *)emu_rf1a_reg(EMU_RF1AINSTRB))
+#define RF1AINSTR1B     (*(volatile uint8_t *)emu_rf1a_reg(EMU_RF1AINSTR1B))
+#define RF1ADINB        (*(volatile uint8_t *)emu_rf1a_reg(EMU_RF1ADINB))
+#define RF1ASTATB       (*(volatile uint8_t *)emu_rf1a_reg(EMU_RF1ASTATB))
+#define RF1ADOUTB       (*(volatile uint8_t *)emu_rf1a_reg(EMU_RF1ADOUTB))
+#define RF1ADOUT0B      (*(volatile uint8_t *)emu_rf1a_reg(EMU_RF1ADOUT0B))
+#define RF1ADOUT1B      (*(volatile uint8_t *)emu_rf1a_reg(EMU_RF1ADOUT1B))
+#define RF1AIFG         (*(volatile uint16_t *)emu_rf1a_reg(EMU_RF1AIFG))
+#define RF1AIE          (*(volatile uint16_t *)emu_rf1a_reg(EMU_RF1AIE))
+#define RF1AIES         (*(volatile uint16_t *)emu_rf1a_reg(EMU_RF1AIES))
+#define RF1AIV          (*(volatile uint16_t *)emu_rf1a_reg(EMU_RF1AIV))
+
+/* RF1AIV Definitions */
+#define RF1AIV_NONE     (0x0000)
+#define RF1AIV_RFIFG9   (0x0014)
+
+/* RF1AIFCTL1 Control Bits */
+#define RFRXIFG         (0x0001)
+#define RFTXIFG         (0x0002)
+#define RFERRIFG        (0x0004)
+#define RFINSTRIFG      (0x0010)
+#define RFDINIFG        (0x0020)
+#define RFSTATIFG       (0x0040)
+#define RFDOUTIFG       (0x0080)
+
+/* Radio core registers */
+#define IOCFG2          0x00
+#define IOCFG1          0x01
+#define IOCFG0          0x02
+#define FIFOTHR         0x03
+#define SYNC1           0x04
+#define SYNC0           0x05
+#define PKTLEN          0x06
+#define PKTCTRL1        0x07
+#define PKTCTRL0        0x08
+#define ADDR            0x09
+#define CHANNR          0x0A
+#define FSCTRL1         0x0B
+#define FSCTRL0         0x0C
+#define FREQ2           0x0D
+#define FREQ1           0x0E
+#define FREQ0           0x0F
+#define MDMCFG4         0x10
+#define MDMCFG3         0x11
+#define MDMCFG2         0x12
+#define MDMCFG1         0x13
+#define MDMCFG0         0x14
+#define DEVIATN         0x15
+#define MCSM2           0x16
+#define MCSM1           0x17
+#define MCSM0           0x18
+#define FOCCFG          0x19
+#define BSCFG           0x1A
+#define AGCCTRL2        0x1B
+#define AGCCTRL1        0x1C
+#define AGCCTRL0        0x1D
+#define WOREVT1         0x1E
+#define WOREVT0         0x1F
+#define WORCTRL         0x20
+#define FREND1          0x21
+#define FREND0          0x22
+#define FSCAL3          0x23
+#define FSCAL2          0x24
+#define FSCAL1          0x25
+#define FSCAL0          0x26
+#define RCCTRL1         0x27
+#define RCCTRL0         0x28
+#define FSTEST          0x29
+#define PTEST           0x2A
+#define AGCTEST         0x2B
+#define TEST2           0x2C
+#define TEST1           0x2D
+#define TEST0           0x2E
+
+#define PARTNUM         0x30
+#define VERSION         0x31
+#define FREQEST         0x32
+#define LQI             0x33
+#define RSSI            0x34
+#define MARCSTATE       0x35
+#define WORTIME1        0x36
+#define WORTIME0        0x37
+#define PKTSTATUS       0x38
+#define VCO_VC_DAC      0x39
+#define TXBYTES         0x3A
+#define RXBYTES         0x3B
+
+#define PATABLE         0x3E
+#define TXFIFO          0x3F
+#define RXFIFO          0x3F
+
+/* Radio core instructions */
+#define RF_SNGLREGRD    0x80
+#define RF_SNGLREGWR    0x00
+#define RF_REGRD        0xC0
+#define RF_REGWR        0x40
+#define RF_STATREGRD    0xC0
+#define RF_SNGLPATABRD  (RF_SNGLREGRD+PATABLE)
+#define RF_SNGLPATABWR  (RF_SNGLREGWR+PATABLE)
+#define RF_PATABRD      (RF_REGRD+PATABLE)
+#define RF_PATABWR      (RF_REGWR+PATABLE)
+#define RF_SNGLRXRD     (RF_SNGLREGRD+RXFIFO)
+#define RF_SNGLTXWR     (RF_SNGLREGWR+TXFIFO)
+#define RF_RXFIFORD     (RF_SNGLREGRD+RXFIFO)
+#define RF_TXFIFOWR     (RF_SNGLREGWR+TXFIFO)
+
+/* Command strobes */
+#define RF_SRES         0x30
+#define RF_SFSTXON      0x31
+#define RF_SXOFF        0x32
+#define RF_SCAL         0x33
+#define RF_SRX          0x34
+#define RF_STX          0x35
+#define RF_SIDLE        0x36
+#define RF_SWOR         0x38
+#define RF_SPWD         0x39
+#define RF_SFRX         0x3A
+#define RF_SFTX         0x3B
+#define RF_SWORRST      0x3C
+#define RF_SNOP         0x3D
+
+#endif // EMU_CC430F5137_H
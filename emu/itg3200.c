@@ -0,0 +1,140 @@
+/*
+  itg3200.c - Behavioural model of the ITG3200 gyro on the emulated I2C bus.
+
+  Output registers are latched from the trace (or a slow synthetic rotation)
+  at the sample rate set by SMPLRT_DIV and the DLPF configuration, and the
+  RAW_DATA_RDY status bit is set on every new sample.
+*/
+
+#include <string.h>
+#include <math.h>
+
+#include "emu.h"
+
+#define WHO_AM_I    0x00
+#define SMPLRT_DIV  0x15
+#define DLPF_FS     0x16
+#define INT_CFG     0x17
+#define INT_STATUS  0x1A
+#define TEMP_OUT_H  0x1B
+#define GYRO_XOUT_H 0x1D
+#define GYRO_ZOUT_L 0x22
+#define PWR_MGM     0x3E
+
+#define INT_ANYRD_2CLEAR 0x10
+#define RAW_DATA_RDY     0x01
+#define PWR_SLEEP        0x40
+
+#define TEMP_35C    (-13000)
+
+#define OPERATING_CURRENT 6.5e-3    // Data sheet
+#define SLEEP_CURRENT     5e-6
+
+static double sample_period(const struct emu_i2c_dev *d)
+{
+	double internal = (d->regs[DLPF_FS] & 0x07) == 0 ? 8000.0 : 1000.0;
+
+	return (d->regs[SMPLRT_DIV] + 1) / internal;
+}
+
+static void put16(uint8_t *reg, int16_t value)
+{
+	reg[0] = (uint16_t)value >> 8;
+	reg[1] = value & 0xFF;
+}
+
+static void latch(struct emu_i2c_dev *d, double t)
+{
+	int16_t w[3];
+	unsigned int i;
+
+	if (d->trace) {
+		emu_trace_value(d->trace, t, w);
+	} else {
+		// Slow tumble, in LSb of 1/14.375 deg/s
+		w[0] = 144 * sin(0.5 * t);
+		w[1] = 72 * cos(0.3 * t);
+		w[2] = 30;
+	}
+	for (i = 0; i < 3; i++)
+		put16(&d->regs[GYRO_XOUT_H + 2 * i], w[i]);
+	d->regs[INT_STATUS] |= RAW_DATA_RDY;
+	d->samples++;
+	d->data_read = 0;
+}
+
+static void update(struct emu_i2c_dev *d, double now)
+{
+	if (d->regs[PWR_MGM] & PWR_SLEEP)
+		return;
+
+	// Only the most recent sample is visible to the host
+	if (d->sample_at <= now) {
+		double skipped = floor((now - d->sample_at) / d->period);
+
+		d->samples += (unsigned long)skipped;
+		d->sample_at += skipped * d->period;
+		latch(d, d->sample_at);
+		d->sample_at += d->period;
+	}
+}
+
+static void write(struct emu_i2c_dev *d, uint8_t reg, uint8_t value, double now)
+{
+	if (reg == PWR_MGM)
+		emu_i2c_account(d, now);
+	switch (reg) {
+	case SMPLRT_DIV:
+	case DLPF_FS:
+	case INT_CFG:
+	case PWR_MGM:
+		d->regs[reg] = value;
+		break;
+	default:
+		return;     // Read-only
+	}
+	if (reg == SMPLRT_DIV || reg == DLPF_FS || reg == PWR_MGM) {
+		d->period = sample_period(d);
+		d->sample_at = now + d->period;
+	}
+}
+
+static void read(struct emu_i2c_dev *d, uint8_t reg)
+{
+	if (reg == GYRO_XOUT_H) {
+		if (d->samples == d->read_sample)
+			d->stale_reads++;
+		d->read_sample = d->samples;
+	}
+	if (reg == INT_STATUS || (d->regs[INT_CFG] & INT_ANYRD_2CLEAR))
+		d->regs[INT_STATUS] &= ~RAW_DATA_RDY;
+}
+
+static uint8_t next(const struct emu_i2c_dev *d, uint8_t reg)
+{
+	return (reg + 1) & 0x3F;
+}
+
+static double current(const struct emu_i2c_dev *d)
+{
+	return (d->regs[PWR_MGM] & PWR_SLEEP) ? SLEEP_CURRENT : OPERATING_CURRENT;
+}
+
+void emu_itg3200_init(struct emu_i2c_dev *d, uint8_t address, const struct emu_trace *trace)
+{
+	memset(d, 0, sizeof(*d));
+	d->address = address;
+	d->drdy_pin = -1;
+	d->trace = trace;
+	d->regs[WHO_AM_I] = address & 0x7E;
+	put16(&d->regs[TEMP_OUT_H], TEMP_35C);
+
+	d->update = update;
+	d->write = write;
+	d->read = read;
+	d->next = next;
+	d->current = current;
+
+	d->period = sample_period(d);
+	d->sample_at = d->period;
+}
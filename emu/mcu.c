@@ -0,0 +1,371 @@
+/*
+  mcu.c - Virtual time, status register, watchdog timer and Timer_A of an
+  emulated CC430.
+
+  Time only advances when the firmware spends cycles: RF1A register accesses,
+  __delay_cycles() and low power sleeps, which jump straight to the next
+  interrupt. Interrupt handlers are called synchronously from the emulator.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cc430f5137.h"
+#include "emu.h"
+
+__thread struct emu_sprite *emu_cur;
+
+// Interrupt handlers of the firmware
+void watchdog_isr(void);
+void cc1101_isr(void);
+void timer0_a0_isr(void);
+
+// Watchdog interval divider selected by WDTIS
+static const double WDT_DIVIDER[8] = {
+	2147483648.0, 134217728.0, 8388608.0, 524288.0, 32768.0, 8192.0, 512.0, 64.0
+};
+
+void emu_sprite_init(struct emu_sprite *s, double f_cpu)
+{
+	memset(s, 0, sizeof(*s));
+	s->f_cpu = f_cpu;
+	s->f_vlo = EMU_VLO_FREQ;
+	s->wdtctl = s->wdtctl_seen = WDTPW | WDTHOLD;
+	s->pmmifg = SVSMLDLYIFG;    // Supervisor delays have always elapsed
+	emu_rf1a_init(&s->rf);
+}
+
+void emu_sprite_free(struct emu_sprite *s)
+{
+	emu_rf1a_free(&s->rf);
+}
+
+// ACLK selected by UCSCTL4. There is no XT1 or XT2 crystal, the clock
+// system falls back to REFO.
+static double aclk(const struct emu_sprite *s)
+{
+	switch (s->ucsctl[4] & SELA_7) {
+	case SELA__VLOCLK:
+		return s->f_vlo;
+	case SELA__DCOCLK:
+		return 2.0 * s->f_cpu;
+	case SELA__DCOCLKDIV:
+		return s->f_cpu;
+	default:
+		return EMU_REFO_FREQ;
+	}
+}
+
+static double wdt_clock(const struct emu_sprite *s)
+{
+	switch (s->wdtctl & (WDTSSEL1 | WDTSSEL0)) {
+	case WDTSSEL__SMCLK:
+		return s->f_cpu;
+	case WDTSSEL__ACLK:
+		return aclk(s);
+	default:
+		return s->f_vlo;
+	}
+}
+
+static int wdt_running(const struct emu_sprite *s)
+{
+	return !(s->wdtctl & WDTHOLD) && (s->wdtctl & WDTTMSEL);
+}
+
+// The watchdog requests its clock in every low power mode
+static int wdt_needs_smclk(const struct emu_sprite *s)
+{
+	return wdt_running(s) && (s->wdtctl & (WDTSSEL1 | WDTSSEL0)) == WDTSSEL__SMCLK;
+}
+
+// A write to WDTCTL clears the counter and restarts the interval
+static void wdt_sync(struct emu_sprite *s)
+{
+	if (s->wdtctl != s->wdtctl_seen) {
+		s->wdtctl_seen = s->wdtctl;
+		s->wdt_next = s->now + WDT_DIVIDER[s->wdtctl & 0x07] / wdt_clock(s);
+	}
+}
+
+// Timer_A0 in up mode, raising TA0CCR0's interrupt every TA0CCR0 + 1 ticks.
+// As with Timer_A1, a write to TA0CTL takes effect on the next access.
+static void ta0_sync(struct emu_sprite *s)
+{
+	if (s->ta0ctl & TACLR) {
+		s->ta0ctl &= ~TACLR;
+		s->ta0_start = s->now;
+	}
+}
+
+static double ta0_period(const struct emu_sprite *s)
+{
+	double clock = (s->ta0ctl & 0x0300) == TASSEL_2 ? s->f_cpu : aclk(s);
+
+	return (s->ta0ccr0 + 1.0) * (1 << ((s->ta0ctl >> 6) & 3)) / clock;
+}
+
+// Next enabled TA0CCR0 interrupt
+static double ta0_next(struct emu_sprite *s)
+{
+	ta0_sync(s);
+	// Up mode with TA0CCR0 = 0 halts the timer
+	if ((s->ta0ctl & 0x0030) != MC_1 || !(s->ta0cctl0 & CCIE) || s->ta0ccr0 == 0)
+		return INFINITY;
+	return s->ta0_start + ta0_period(s);
+}
+
+volatile uint16_t *emu_ta0ctl(void)
+{
+	ta0_sync(emu_cur);
+	return &emu_cur->ta0ctl;
+}
+
+static void run_isr(struct emu_sprite *s, void (*isr)(void))
+{
+	int gie = s->gie;
+
+	s->in_isr = 1;
+	s->gie = 0;
+	isr();
+	s->gie = gie;
+	s->in_isr = 0;
+	s->now += EMU_ISR_CYCLES / s->f_cpu;
+}
+
+static int rf_irq_pending(const struct emu_sprite *s)
+{
+	return s->gie && !s->in_isr && (s->rf.ifg & s->rf.ie);
+}
+
+// Next radio event that may raise an enabled RF1A interrupt
+static double rf_next(struct emu_sprite *s)
+{
+	return s->rf.ie ? emu_rf1a_next_event(&s->rf) : INFINITY;
+}
+
+// Next WDT or timer interrupt, radio or device event, whichever comes first
+static double next_interrupt(struct emu_sprite *s)
+{
+	double next = s->event ? s->event_at : INFINITY, rf = rf_next(s), ta0 = ta0_next(s);
+
+	if (rf_irq_pending(s))
+		return s->now;
+	wdt_sync(s);
+	if (wdt_running(s) && s->wdt_next < next)
+		next = s->wdt_next;
+	if (rf < next)
+		next = rf;
+	if (ta0 < next)
+		next = ta0;
+	return next;
+}
+
+// Fire the interrupts and device events that are due up to the given time
+static void run_until(struct emu_sprite *s, double end)
+{
+	for (;;) {
+		double rf = rf_next(s), ta0 = ta0_next(s);
+
+		wdt_sync(s);
+		if (rf_irq_pending(s)) {
+			run_isr(s, cc1101_isr);
+			continue;
+		}
+		if (rf <= end && (!s->event || rf <= s->event_at) && rf <= ta0 &&
+		    (!wdt_running(s) || rf <= s->wdt_next)) {
+			if (rf > s->now)
+				s->now = rf;
+			emu_rf1a_update(&s->rf, s->now);
+			continue;
+		}
+		if (s->event && s->event_at <= end && s->event_at <= ta0 &&
+		    (!wdt_running(s) || s->event_at <= s->wdt_next)) {
+			void (*event)(void *) = s->event;
+
+			s->event = NULL;
+			if (s->event_at > s->now)
+				s->now = s->event_at;
+			event(s->event_arg);
+			continue;
+		}
+		if (ta0 <= end && (!wdt_running(s) || ta0 <= s->wdt_next)) {
+			if (ta0 > s->now)
+				s->now = ta0;
+			s->ta0_start = ta0;
+			s->ta0cctl0 |= CCIFG;
+			// Servicing the interrupt clears the flag
+			if (s->gie && !s->in_isr) {
+				s->ta0cctl0 &= ~CCIFG;
+				run_isr(s, timer0_a0_isr);
+			}
+			continue;
+		}
+		if (!wdt_running(s) || s->wdt_next > end)
+			break;
+
+		s->now = s->wdt_next;
+		s->wdt_next += WDT_DIVIDER[s->wdtctl & 0x07] / wdt_clock(s);
+		s->sfrifg1 |= WDTIFG;
+		// Servicing the interrupt clears the flag
+		if (s->gie && !s->in_isr && (s->sfrie1 & WDTIE)) {
+			s->sfrifg1 &= ~WDTIFG;
+			run_isr(s, watchdog_isr);
+		}
+	}
+	if (end > s->now)
+		s->now = end;
+}
+
+void emu_advance(double cycles)
+{
+	struct emu_sprite *s = emu_cur;
+
+	run_until(s, s->now + cycles / s->f_cpu);
+}
+
+void emu_delay_cycles(unsigned long cycles)
+{
+	struct emu_sprite *s = emu_cur;
+
+	emu_rf1a_trace(&s->rf, s->now, EMU_RFTRACE_DELAY, 0, 0,
+	               (uint32_t)llround(cycles / s->f_cpu * 1e9));
+	emu_advance(cycles);
+}
+
+void emu_nop(void)
+{
+	// Let the radio core see the last register write
+	emu_rf1a_reg(EMU_RF1AIFCTL1);
+}
+
+// Low power mode selected by the status register bits
+static int lpm_mode(unsigned int bits)
+{
+	if (bits & OSCOFF)
+		return 4;
+	return ((bits & SCG1) ? 2 : 0) + ((bits & SCG0) ? 1 : 0);
+}
+
+// Enter a low power mode until an interrupt handler clears it on exit
+void emu_bis_sr(unsigned int bits)
+{
+	struct emu_sprite *s = emu_cur;
+	int mode = lpm_mode(bits);
+
+	if (bits & GIE)
+		s->gie = 1;
+	if (!(bits & CPUOFF))
+		return;
+
+	// A watchdog on SMCLK keeps the DCO running in LPM2 and below
+	wdt_sync(s);
+	if (mode >= 2 && mode < 4 && wdt_needs_smclk(s))
+		mode = 1;
+
+	s->wake = 0;
+	while (!s->wake) {
+		double start = s->now, next = next_interrupt(s);
+
+		if (!s->gie || next == INFINITY ||
+		    (!s->event && !(s->sfrie1 & WDTIE) && !s->rf.ie && !(s->ta0cctl0 & CCIE))) {
+			fprintf(stderr, "emu: CPU sleeps with no interrupt enabled\n");
+			abort();
+		}
+		run_until(s, next);
+		// The CPU is awake for the interrupt handlers only
+		if (next > start) {
+			s->asleep += next - start;
+			s->lpm_time[mode] += next - start;
+		}
+	}
+	s->wakeups++;
+}
+
+// Only GIE: the FLL is not modelled
+void emu_bic_sr(unsigned int bits)
+{
+	if (bits & GIE)
+		emu_cur->gie = 0;
+}
+
+void emu_bic_sr_on_exit(unsigned int bits)
+{
+	if (bits & CPUOFF)
+		emu_cur->wake = 1;
+}
+
+// Energia's sleep(): wake up at the watchdog interrupts until the time has
+// passed or an interrupt handler calls wakeup()
+void emu_sleep(uint32_t milliseconds)
+{
+	struct emu_sprite *s = emu_cur;
+	double end = s->now + milliseconds * 1e-3;
+
+	s->stay_asleep = 1;
+	while (s->stay_asleep && s->now < end)
+		emu_bis_sr(LPM3_bits | GIE);
+	s->stay_asleep = 0;
+}
+
+void emu_wakeup(void)
+{
+	emu_cur->stay_asleep = 0;
+	emu_bic_sr_on_exit(LPM4_bits);
+}
+
+// Run a device interrupt handler, if interrupts are enabled
+void emu_irq(void (*isr)(void))
+{
+	struct emu_sprite *s = emu_cur;
+
+	if (s->gie && !s->in_isr)
+		run_isr(s, isr);
+}
+
+// Timer_A1 in continuous mode. As with the RF1A registers, a write to TA1CTL
+// takes effect on the next access to the timer.
+static void ta1_sync(struct emu_sprite *s)
+{
+	if (s->ta1ctl & TACLR) {
+		s->ta1ctl &= ~TACLR;
+		s->ta1_start = s->now;
+	}
+}
+
+volatile uint16_t *emu_ta1ctl(void)
+{
+	ta1_sync(emu_cur);
+	return &emu_cur->ta1ctl;
+}
+
+volatile uint16_t *emu_ta1r(void)
+{
+	struct emu_sprite *s = emu_cur;
+	double clock;
+
+	ta1_sync(s);
+	if ((s->ta1ctl & 0x0030) != MC_2)
+		return &s->ta1r;
+	clock = (s->ta1ctl & 0x0300) == TASSEL_2 ? s->f_cpu : aclk(s);
+	s->ta1r = (uint16_t)(uint64_t)((s->now - s->ta1_start) * clock / (1 << ((s->ta1ctl >> 6) & 3)));
+	return &s->ta1r;
+}
+
+// Polled for the watchdog interval flag, so every read takes a few cycles
+volatile uint16_t *emu_sfrifg1(void)
+{
+	emu_advance(EMU_SFR_ACCESS_CYCLES);
+	return &emu_cur->sfrifg1;
+}
+
+void emu_schedule(double at, void (*event)(void *arg), void *arg)
+{
+	struct emu_sprite *s = emu_cur;
+
+	s->event = event;
+	s->event_arg = arg;
+	s->event_at = at;
+}
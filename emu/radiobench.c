@@ -0,0 +1,312 @@
+/*
+  radiobench.c - Transmit a message from one emulated sprite and report how
+  the radio core spent its time and charge, and the energy per byte.
+
+  The message is sent in one of the transmit modes below, with the radio
+  powered down between transmissions. Packets sent in packet mode are
+  decoded back from the air as a ground station would. The bench reports the
+  payload throughput on air and overall, the time and charge
+  of each radio state, the latency from wake-up to the first chip on air, and
+  the average current and charge per byte sent, next to what the same run
+  would have cost with the radio left in IDLE between transmissions. The
+  energy of the whole sprite (CPU, radio and, with -s, the sensors) is then
+  broken down and divided by the bytes sent, so that modes and settings can
+  be compared. With -t it also writes a trace of every RF1A access for
+  sprite-timeline.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "emu.h"
+#include "SpriteRadio.h"
+#include "instrument.h"
+
+static const char *STATE_NAME[EMU_RF_NSTATES] = {
+	[EMU_RF_SLEEP] = "SLEEP",
+	[EMU_RF_XOFF] = "XOFF",
+	[EMU_RF_IDLE] = "IDLE",
+	[EMU_RF_CALIBRATE] = "CALIBRATE",
+	[EMU_RF_SETTLING] = "SETTLING",
+	[EMU_RF_FSTXON] = "FSTXON",
+	[EMU_RF_TX] = "TX",
+	[EMU_RF_TXFIFO_UNDERFLOW] = "TX_UNDERFLOW",
+	[EMU_RF_RX] = "RX",
+	[EMU_RF_RXFIFO_OVERFLOW] = "RX_OVERFLOW",
+};
+
+#define PACKET_SYNC1 0xD3
+#define PACKET_SYNC0 0x91
+
+// Dewhiten a byte with the PN9 sequence of the CC1101 (TI DN509)
+static uint8_t dewhiten(uint16_t *pn9, uint8_t byte)
+{
+	int i;
+
+	byte ^= *pn9 & 0xFF;
+	for (i = 0; i < 8; i++)
+		*pn9 = (*pn9 >> 1) | (((*pn9 ^ (*pn9 >> 5)) & 1) << 8);
+	return byte;
+}
+
+// CRC-16 of the CC1101 packet handler (TI DN502)
+static uint16_t crc16(uint16_t crc, uint8_t byte)
+{
+	int i;
+
+	for (i = 0; i < 8; i++, byte <<= 1)
+		crc = (((crc >> 8) ^ byte) & 0x80) ? (crc << 1) ^ 0x8005 : crc << 1;
+	return crc;
+}
+
+// Decode every packet on air into payload, the first of every repeat copies
+// once, returning the number of packets with a valid CRC. fixed is the packet
+// length, 0 for variable length.
+static unsigned int decode_packets(const struct emu_rf1a *rf, unsigned int fixed,
+                                   unsigned int repeat, char *payload, unsigned int *length,
+                                   unsigned int *bad)
+{
+	unsigned int i, j, n, good = 0;
+
+	*length = 0;
+	*bad = 0;
+	for (i = 0; i < rf->nbursts; i++) {
+		const struct emu_burst *b = &rf->bursts[i];
+		const uint8_t *p = NULL;
+		uint16_t pn9 = 0x1FF, crc = 0xFFFF, sent;
+
+		for (j = 0; j + 1 < b->length; j++) {
+			if (b->bytes[j] == PACKET_SYNC1 && b->bytes[j + 1] == PACKET_SYNC0) {
+				p = b->bytes + j + 2;
+				break;
+			}
+		}
+		if (!p) {
+			(*bad)++;
+			continue;
+		}
+		n = fixed;
+		if (!fixed) {
+			n = dewhiten(&pn9, *p++);
+			crc = crc16(crc, n);
+		}
+		if (p + n + 2 > b->bytes + b->length || *length + n > 256) {
+			(*bad)++;
+			continue;
+		}
+		// The payload of the first copy of each packet
+		for (j = 0; j < n; j++) {
+			uint8_t byte = dewhiten(&pn9, *p++);
+
+			crc = crc16(crc, byte);
+			if (i % repeat == 0)
+				payload[(*length)++] = byte;
+		}
+		sent = dewhiten(&pn9, p[0]) << 8;
+		sent |= dewhiten(&pn9, p[1]);
+		if (sent == crc)
+			good++;
+		else
+			(*bad)++;
+	}
+	return good;
+}
+
+#if CONFIG_INSTRUMENT
+static const char *PROBE_NAME[INSTRUMENT_PROBES] = {
+	[PROBE_RF_STROBE] = "strobe",
+	[PROBE_RF_READ] = "readRegister",
+	[PROBE_RF_WRITE] = "writeRegister",
+	[PROBE_RF_TXFIFO] = "writeTXBuffer",
+	[PROBE_TX_IDLE_WAIT] = "TX idle wait",
+	[PROBE_TX_END_WAIT] = "TX end wait",
+	[PROBE_FSCAL_WAIT] = "FSCAL wait",
+	[PROBE_DELAY] = "delay",
+};
+
+static unsigned long get(const uint8_t *p, int bytes)
+{
+	unsigned long value = 0;
+
+	while (bytes--)
+		value = value << 8 | p[bytes];
+	return value;
+}
+
+// Decode the telemetry record as the ground would
+static void print_instrumentation(void)
+{
+	uint8_t record[INSTRUMENT_RECORD_SIZE];
+	unsigned int length = instrument_dump(record, sizeof(record)), i;
+	const uint8_t *p = record + 4;
+
+	printf("\n%u-byte instrumentation record, %u cycles per tick\n", length, 1u << record[2]);
+	printf("%-14s %8s %10s %9s %10s %10s %10s\n",
+	       "probe", "calls", "spins", "max spins", "min cyc", "max cyc", "avg cyc");
+	for (i = 0; i < record[1]; i++, p += INSTRUMENT_PROBE_SIZE) {
+		unsigned long count = get(p, 4), ticks = get(p + 14, 4);
+
+		printf("%-14s %8lu %10lu %9lu %10lu %10lu %10.0f\n", PROBE_NAME[i], count,
+		       get(p + 4, 4), get(p + 8, 2), get(p + 10, 2) << record[2],
+		       get(p + 12, 2) << record[2],
+		       count ? (double)(ticks << record[2]) / count : 0.0);
+	}
+}
+#endif
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -m TEXT    message to transmit (default \"KickSat\")\n"
+		"  -M MODE    transmit mode (default transmit):\n"
+		"               transmit  SpriteRadio_transmit(), random gaps between bytes\n"
+		"               burst     SpriteRadio_transmitByte() back to back\n"
+		"               packet    SpriteRadio_transmit() in packet mode\n"
+		"               csk       SpriteRadio_transmit() in CSK mode\n"
+		"  -L LENGTH  fixed packet length in packet mode (default: variable)\n"
+		"  -p DBM     transmit power (default 10)\n"
+		"  -K N       send every frame or packet N times (SpriteRadio_setRepeat())\n"
+		"  -v N       pass the message to radio_transmitv() in N segments\n"
+		"  -s         attach the gyro and magnetometer models, as powered up\n"
+		"  -V VOLTS   supply voltage (default 3.0)\n"
+		"  -A HZ      frequency of the VLO, the ACLK source (default 9400)\n"
+		"  -t FILE    write an RF1A access trace\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	const char *text = "KickSat", *trace = NULL, *mode = "transmit";
+	char message[256];
+	char decoded[256];
+	unsigned int length, i, fixed = 0, repeat = 1, packets, bad, decoded_length, nsegments = 0;
+	radio_segment_t segments[sizeof(message)];
+	int power = 10, sensors = 0, opt;
+	double charge = 0.0, powered_down = 0.0, idle_charge, voltage = EMU_SUPPLY_VOLTAGE;
+	double vlo = EMU_VLO_FREQ, started;
+	struct emu_sprite s;
+	struct emu_rf1a *rf = &s.rf;
+	struct emu_i2c_dev gyro, mag;
+	struct emu_energy energy;
+
+	while ((opt = getopt(argc, argv, "m:M:L:p:K:v:st:V:A:h")) != -1) {
+		switch (opt) {
+		case 'm': text = optarg; break;
+		case 'L': fixed = strtoul(optarg, NULL, 0); break;
+		case 'M': mode = optarg; break;
+		case 'p': power = strtol(optarg, NULL, 0); break;
+		case 'K': repeat = strtoul(optarg, NULL, 0); break;
+		case 'v': nsegments = strtoul(optarg, NULL, 0); break;
+		case 's': sensors = 1; break;
+		case 't': trace = optarg; break;
+		case 'V': voltage = strtod(optarg, NULL); break;
+		case 'A': vlo = strtod(optarg, NULL); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	length = strlen(text);
+	if (length == 0 || length > sizeof(message) || fixed > SR_PACKET_MAX + 1 ||
+	    repeat == 0 || repeat > SR_REPEAT_MAX || nsegments > length || vlo < 1000.0 || vlo > 100000.0 ||
+	    (strcmp(mode, "transmit") && strcmp(mode, "burst") && strcmp(mode, "packet") &&
+	     strcmp(mode, "csk"))) {
+		usage(argv[0]);
+		return 1;
+	}
+	memcpy(message, text, length);
+
+	emu_sprite_init(&s, F_CPU);
+	emu_cur = &s;
+	s.gie = 1;
+	s.f_vlo = vlo;
+	if (trace && emu_rf1a_trace_open(rf, trace)) {
+		perror(trace);
+		return 1;
+	}
+	if (sensors) {
+		emu_itg3200_init(&gyro, 0x68, NULL);
+		emu_hmc5883l_init(&mag, NULL);
+		emu_i2c_attach(&s.i2c, &gyro);
+		emu_i2c_attach(&s.i2c, &mag);
+	}
+
+	SpriteRadio_SpriteRadio();
+	started = s.now;
+	SpriteRadio_setPower(power);
+	SpriteRadio_setRepeat(repeat);
+	if (!strcmp(mode, "packet"))
+		SpriteRadio_setMode(SR_MODE_PACKET, fixed);
+	else if (!strcmp(mode, "csk"))
+		SpriteRadio_setMode(SR_MODE_CSK, 0);
+	SpriteRadio_txInit();
+	if (nsegments && strcmp(mode, "burst")) {
+		// Cut at every length / N bytes, the last segment taking the rest
+		for (i = 0; i < nsegments; i++) {
+			segments[i].bytes = message + i * (length / nsegments);
+			segments[i].length = i + 1 < nsegments ? length / nsegments :
+			                     length - i * (length / nsegments);
+		}
+		radio_transmitv(segments, nsegments);
+	} else if (strcmp(mode, "burst")) {
+		SpriteRadio_transmit(message, length);
+	} else {
+		for (i = 0; i < length; i++)
+			SpriteRadio_transmitByte(message[i]);
+	}
+	SpriteRadio_sleep();
+	emu_rf1a_account(rf, s.now);
+
+	printf("%s mode at %d dBm (PATABLE 0x%02X, TX %.1f mA)\n\n", mode,
+	       emu_rf1a_pa_dbm(rf->patable[0]), rf->patable[0],
+	       emu_rf1a_tx_current(rf->patable[0]) * 1e3);
+	printf("%-13s %12s %12s\n", "state", "time (s)", "charge (uC)");
+	for (i = 0; i < EMU_RF_NSTATES; i++) {
+		double q = rf->state_charge[i];
+
+		if (rf->state_time[i] == 0.0)
+			continue;
+		printf("%-13s %12.6f %12.3f\n", STATE_NAME[i], rf->state_time[i], q * 1e6);
+		charge += q;
+	}
+	powered_down = rf->state_time[EMU_RF_SLEEP] + rf->state_time[EMU_RF_XOFF];
+	idle_charge = charge - rf->state_charge[EMU_RF_SLEEP] - rf->state_charge[EMU_RF_XOFF]
+	            + powered_down * emu_rf1a_current(EMU_RF_IDLE);
+
+	printf("\n%u bytes in %.3f s, %lu wake-ups, wake to TX %.1f us (max %.1f us)\n",
+	       length, s.now, rf->wakes,
+	       rf->wakes ? rf->wake_latency / rf->wakes * 1e6 : 0.0, rf->max_wake_latency * 1e6);
+	printf("%lu calibrations\n", rf->calibrations);
+	printf("micros() %+.3f ms from virtual time, %.1f s slept in LPM3\n",
+	       micros() * 1e-3 - (s.now - started) * 1e3, s.lpm_time[3]);
+	if (rf->uncalibrated_tx)
+		printf("WARNING: %lu transmissions started without calibration\n",
+		       rf->uncalibrated_tx);
+	if (rf->stale_config_tx)
+		printf("WARNING: %lu transmissions started with registers lost in SLEEP\n",
+		       rf->stale_config_tx);
+	printf("payload %.1f B/s while on air, %.1f B/s overall\n",
+	       length / rf->state_time[EMU_RF_TX], length / s.now);
+	if (!strcmp(mode, "packet")) {
+		packets = decode_packets(rf, fixed, repeat, decoded, &decoded_length, &bad);
+		printf("%lu packets sent, %u decoded, %u bad, payload %s\n", rf->tx_packets,
+		       packets, bad, decoded_length >= length && !memcmp(decoded, message, length) ?
+		       "matches" : "DIFFERS");
+	}
+	printf("radio average %.1f uA, %.1f uC per byte\n"
+	       "left in IDLE:  %.1f uA, %.1f uC per byte\n",
+	       charge / s.now * 1e6, charge / length * 1e6,
+	       idle_charge / s.now * 1e6, idle_charge / length * 1e6);
+
+	printf("\n");
+	emu_energy(&s, voltage, &energy);
+	emu_energy_print(&energy, &s, length);
+
+#if CONFIG_INSTRUMENT
+	print_instrumentation();
+#endif
+
+	emu_sprite_free(&s);
+	return 0;
+}
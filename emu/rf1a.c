@@ -0,0 +1,1092 @@
+/*
+  rf1a.c - Model of the CC1101 radio core behind the CC430 RF1A interface.
+
+  Register accesses are decoded lazily: a write to an instruction or data
+  register is latched and takes effect on the next interface access, which is
+  when the firmware could first observe its result. Radio state (calibration,
+  settling, bytes shifted out of the TX FIFO, wake-on-radio and packets
+  received) advances with virtual time.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cc430f5137.h"
+#include "emu.h"
+
+#define XOSC_STARTUP_TIME   150e-6   // SLEEP/XOFF to chip ready
+#define CALIBRATE_TIME      721e-6   // Frequency synthesizer calibration
+#define SETTLING_TIME       88.4e-6  // IDLE to TX without calibration
+#define RC_PERIOD           (750.0 / EMU_XOSC_FREQ)  // WOR timer tick
+#define SYNC_BITS           32       // 30/32 and 32/32 sync word modes
+#define CRC_BITS            16
+#define CARRIER_SENSE_BITS  8        // RSSI valid after RX starts
+
+#define TARGET_BURST        0x40
+#define TARGET_NONE         (-1)
+
+// rf_tx_byte() results other than a byte
+#define TX_UNDERFLOW        (-1)
+#define TX_END              (-2)
+
+// Reset values of the configuration registers, from the CC1101 data sheet
+static const uint8_t RESET_REGS[0x2F] = {
+	0x29, 0x2E, 0x3F, 0x07, 0xD3, 0x91, 0xFF, 0x04,
+	0x45, 0x00, 0x00, 0x0F, 0x00, 0x1E, 0xC4, 0xEC,
+	0x8C, 0x22, 0x02, 0x22, 0xF8, 0x47, 0x07, 0x30,
+	0x04, 0x36, 0x6C, 0x03, 0x40, 0x91, 0x87, 0x6B,
+	0xF8, 0x56, 0x10, 0xA9, 0x0A, 0x20, 0x0D, 0x41,
+	0x00, 0x59, 0x7F, 0x3F, 0x88, 0x31, 0x0B
+};
+
+// Registers not retained in SLEEP: FSTEST, PTEST, AGCTEST, TEST2, TEST1, TEST0
+#define FIRST_LOST_REG      FSTEST
+#define LAST_LOST_REG       TEST0
+
+// Typical supply current of each state in amperes, CC1101 data sheet at 433 MHz
+static const double STATE_CURRENT[EMU_RF_NSTATES] = {
+	[EMU_RF_SLEEP] = 0.2e-6,
+	[EMU_RF_XOFF] = 165e-6,
+	[EMU_RF_IDLE] = 1.7e-3,
+	[EMU_RF_CALIBRATE] = 8.4e-3,
+	[EMU_RF_SETTLING] = 8.4e-3,
+	[EMU_RF_FSTXON] = 8.4e-3,
+	[EMU_RF_TX] = 29.2e-3,          // +10 dBm, see rf_current()
+	[EMU_RF_TXFIFO_UNDERFLOW] = 1.7e-3,
+	[EMU_RF_RX] = 16.0e-3,
+	[EMU_RF_RXFIFO_OVERFLOW] = 1.7e-3,
+};
+
+// Output power of PATABLE settings, TI DN013 at 434 MHz
+static const struct {
+	uint8_t value;
+	int8_t dbm;
+} PA_SETTING[] = {
+	{ 0x03, -30 }, { 0x12, -30 }, { 0x07, -26 }, { 0x0A, -23 }, { 0x0E, -20 },
+	{ 0x1A, -18 }, { 0x1D, -15 }, { 0x26, -12 }, { 0x25, -11 }, { 0x34, -10 },
+	{ 0x6E, -9 }, { 0x6D, -8 }, { 0x6C, -7 }, { 0x6A, -6 }, { 0x69, -5 },
+	{ 0x57, -4 }, { 0x65, -3 }, { 0x63, -2 }, { 0x52, -1 }, { 0x60, 0 },
+	{ 0x50, 1 }, { 0x8C, 2 }, { 0x8A, 3 }, { 0x87, 4 }, { 0x84, 5 },
+	{ 0x82, 6 }, { 0xC9, 7 }, { 0xC8, 7 }, { 0xC6, 8 }, { 0xC3, 9 },
+	{ 0xC0, 10 },
+};
+
+// TX current against output power, CC1101 data sheet at 433 MHz
+static const struct {
+	double dbm;
+	double current;
+} TX_CURRENT[] = {
+	{ -30, 11.9e-3 }, { -20, 12.4e-3 }, { -15, 13.1e-3 }, { -10, 14.4e-3 },
+	{ 0, 15.9e-3 }, { 5, 20.0e-3 }, { 7, 25.8e-3 }, { 10, 29.2e-3 },
+};
+#define NUM_PA_SETTINGS (sizeof(PA_SETTING) / sizeof(PA_SETTING[0]))
+#define NUM_TX_CURRENTS (sizeof(TX_CURRENT) / sizeof(TX_CURRENT[0]))
+
+// Value of the 3-bit STATE field in the chip status byte
+static const uint8_t STATUS_STATE[EMU_RF_NSTATES] = {
+	[EMU_RF_SLEEP] = 0,
+	[EMU_RF_XOFF] = 0,
+	[EMU_RF_IDLE] = 0,
+	[EMU_RF_CALIBRATE] = 4,
+	[EMU_RF_SETTLING] = 5,
+	[EMU_RF_FSTXON] = 3,
+	[EMU_RF_TX] = 2,
+	[EMU_RF_TXFIFO_UNDERFLOW] = 7,
+	[EMU_RF_RX] = 1,
+	[EMU_RF_RXFIFO_OVERFLOW] = 6,
+};
+
+// MARCSTATE register values
+static const uint8_t MARCSTATE_VALUE[EMU_RF_NSTATES] = {
+	[EMU_RF_SLEEP] = 0x00,
+	[EMU_RF_XOFF] = 0x02,
+	[EMU_RF_IDLE] = 0x01,
+	[EMU_RF_CALIBRATE] = 0x08,
+	[EMU_RF_SETTLING] = 0x10,
+	[EMU_RF_FSTXON] = 0x12,
+	[EMU_RF_TX] = 0x13,
+	[EMU_RF_TXFIFO_UNDERFLOW] = 0x16,
+	[EMU_RF_RX] = 0x0D,
+	[EMU_RF_RXFIFO_OVERFLOW] = 0x11,
+};
+
+// Output power of a PATABLE value; settings not in DN013 count as +10 dBm
+int emu_rf1a_pa_dbm(uint8_t patable)
+{
+	unsigned int i;
+
+	for (i = 0; i < NUM_PA_SETTINGS; i++) {
+		if (PA_SETTING[i].value == patable)
+			return PA_SETTING[i].dbm;
+	}
+	return 10;
+}
+
+// TX current at the output power of a PATABLE value
+double emu_rf1a_tx_current(uint8_t patable)
+{
+	double dbm = emu_rf1a_pa_dbm(patable);
+	unsigned int i;
+
+	for (i = 1; i < NUM_TX_CURRENTS - 1 && dbm > TX_CURRENT[i].dbm; i++)
+		;
+	return TX_CURRENT[i - 1].current + (dbm - TX_CURRENT[i - 1].dbm) *
+	       (TX_CURRENT[i].current - TX_CURRENT[i - 1].current) /
+	       (TX_CURRENT[i].dbm - TX_CURRENT[i - 1].dbm);
+}
+
+// Current drawn in the current state, with the PATABLE entry selected by
+// FREND0.PA_POWER in TX
+static double rf_current(const struct emu_rf1a *rf)
+{
+	if (rf->state == EMU_RF_TX)
+		return emu_rf1a_tx_current(rf->patable[rf->regs[FREND0] & 0x07]);
+	return STATE_CURRENT[rf->state];
+}
+
+// Charge the time spent in the current state and enter a new one at time t
+static void rf_set_state(struct emu_rf1a *rf, int state, double t)
+{
+	if (t > rf->state_since) {
+		rf->state_time[rf->state] += t - rf->state_since;
+		rf->state_charge[rf->state] += (t - rf->state_since) * rf_current(rf);
+		rf->state_since = t;
+	}
+	if (state != rf->state) {
+		rf->state = state;
+		emu_rf1a_trace(rf, rf->state_since, EMU_RFTRACE_STATE, state, 0, 0);
+	}
+}
+
+void emu_rf1a_account(struct emu_rf1a *rf, double now)
+{
+	rf_set_state(rf, rf->state, now);
+}
+
+double emu_rf1a_current(int state)
+{
+	return STATE_CURRENT[state];
+}
+
+static void rf_reset(struct emu_rf1a *rf)
+{
+	memcpy(rf->regs, RESET_REGS, sizeof(rf->regs));
+	memset(rf->patable, 0, sizeof(rf->patable));
+	rf->patable[0] = 0xC6;
+	rf->pa_index = 0;
+	rf->lost = 0;
+	rf->tx_head = 0;
+	rf->tx_count = 0;
+	rf->rx_head = 0;
+	rf->rx_count = 0;
+	rf->wor = 0;
+	rf->rx_packet = NULL;
+	rf->target = TARGET_NONE;
+	rf->autoread = TARGET_NONE;
+	rf->burst_open = 0;
+}
+
+void emu_rf1a_init(struct emu_rf1a *rf)
+{
+	memset(rf, 0, sizeof(*rf));
+	rf_reset(rf);
+	rf->state = EMU_RF_IDLE;
+	rf->wake_at = -1.0;
+	rf->pending = -1;
+	rf->ifctl1 = RFINSTRIFG;
+}
+
+int emu_rf1a_trace_open(struct emu_rf1a *rf, const char *path)
+{
+	rf->trace = fopen(path, "wb");
+	if (!rf->trace)
+		return -1;
+	fwrite(EMU_RFTRACE_MAGIC, 1, 8, rf->trace);
+	return 0;
+}
+
+void emu_rf1a_trace(struct emu_rf1a *rf, double t, int type, unsigned int arg,
+                    unsigned int value, uint32_t data)
+{
+	unsigned char record[EMU_RFTRACE_RECORD];
+	uint64_t ns;
+	int i;
+
+	if (!rf->trace)
+		return;
+	ns = (uint64_t)llround(t * 1e9);
+	for (i = 0; i < 8; i++)
+		record[i] = ns >> (8 * i);
+	record[8] = type;
+	record[9] = arg;
+	record[10] = value;
+	record[11] = rf->state;
+	for (i = 0; i < 4; i++)
+		record[12 + i] = data >> (8 * i);
+	fwrite(record, sizeof(record), 1, rf->trace);
+}
+
+void emu_rf1a_free(struct emu_rf1a *rf)
+{
+	unsigned int i;
+
+	if (rf->trace) {
+		fclose(rf->trace);
+		rf->trace = NULL;
+	}
+
+	for (i = 0; i < rf->nbursts; i++)
+		free(rf->bursts[i].bytes);
+	free(rf->bursts);
+	rf->bursts = NULL;
+	rf->nbursts = rf->cap_bursts = 0;
+
+	free(rf->air);
+	rf->air = NULL;
+	rf->nair = rf->cap_air = rf->air_first = 0;
+}
+
+// Queue a packet sent by the ground. Packets must be injected in the order
+// of their start times.
+void emu_rf1a_inject(struct emu_rf1a *rf, const struct emu_rx_packet *p)
+{
+	if (rf->nair == rf->cap_air) {
+		rf->cap_air = rf->cap_air ? 2 * rf->cap_air : 16;
+		rf->air = realloc(rf->air, rf->cap_air * sizeof(*rf->air));
+	}
+	rf->air[rf->nair] = *p;
+	rf->air[rf->nair].received_at = -1.0;
+	rf->nair++;
+}
+
+// Chip rate programmed in MDMCFG4/MDMCFG3
+double emu_rf1a_chip_rate(const struct emu_rf1a *rf)
+{
+	unsigned int e = rf->regs[MDMCFG4] & 0x0F;
+	unsigned int m = rf->regs[MDMCFG3];
+
+	return (256.0 + m) * ldexp(EMU_XOSC_FREQ, e - 28);
+}
+
+static int rf_asleep(const struct emu_rf1a *rf)
+{
+	return rf->state == EMU_RF_SLEEP || rf->state == EMU_RF_XOFF;
+}
+
+static int rf_ready(const struct emu_rf1a *rf, double now)
+{
+	return !rf_asleep(rf) && now >= rf->ready_at;
+}
+
+static uint8_t rf_status(const struct emu_rf1a *rf, double now, int rx)
+{
+	unsigned int fifo = rx ? rf->rx_count : 64 - rf->tx_count;
+	uint8_t status = STATUS_STATE[rf->state] << 4;
+
+	if (!rf_ready(rf, now))
+		status |= 0x80;
+	status |= fifo > 15 ? 15 : fifo;
+	return status;
+}
+
+static void rf_emit(struct emu_rf1a *rf, double t, uint8_t byte)
+{
+	struct emu_burst *b;
+
+	if (!rf->burst_open) {
+		if (rf->nbursts == rf->cap_bursts) {
+			rf->cap_bursts = rf->cap_bursts ? 2 * rf->cap_bursts : 16;
+			rf->bursts = realloc(rf->bursts, rf->cap_bursts * sizeof(*rf->bursts));
+		}
+		b = &rf->bursts[rf->nbursts++];
+		memset(b, 0, sizeof(*b));
+		b->start = t;
+		b->chip_time = 1.0 / emu_rf1a_chip_rate(rf);
+		rf->burst_open = 1;
+	}
+
+	b = &rf->bursts[rf->nbursts - 1];
+	if (b->length == b->capacity) {
+		b->capacity = b->capacity ? 2 * b->capacity : 256;
+		b->bytes = realloc(b->bytes, b->capacity);
+	}
+	b->bytes[b->length++] = byte;
+	emu_rf1a_trace(rf, t, EMU_RFTRACE_AIR, 0, byte, (uint32_t)llround(8e9 * b->chip_time));
+}
+
+// Results of a frequency synthesizer calibration at the programmed frequency.
+// Only their dependence on the frequency matters to the model.
+static void rf_calibration(const struct emu_rf1a *rf, uint8_t fscal[3])
+{
+	unsigned int f = rf->regs[FREQ2] << 16 | rf->regs[FREQ1] << 8 | rf->regs[FREQ0];
+	unsigned int h = (f + rf->regs[CHANNR] * 7919u) * 2654435761u;
+
+	fscal[0] = (rf->regs[FSCAL3] & 0xF0) | ((h >> 8) & 0x0F);
+	fscal[1] = 0x20 | ((h >> 16) & 0x1F);
+	fscal[2] = (h >> 24) & 0x3F;
+}
+
+static void rf_calibrated(struct emu_rf1a *rf)
+{
+	uint8_t fscal[3];
+
+	rf_calibration(rf, fscal);
+	memcpy(&rf->regs[FSCAL3], fscal, sizeof(fscal));
+	rf->calibrations++;
+}
+
+static int rf_packet_mode(const struct emu_rf1a *rf)
+{
+	return (rf->regs[PKTCTRL0] & 0x03) != 2;
+}
+
+// Packet handler: queue the preamble and sync word of a new packet
+static void rf_packet_start(struct emu_rf1a *rf)
+{
+	static const unsigned char PREAMBLE[8] = { 2, 3, 4, 6, 8, 12, 16, 24 };
+	unsigned int i, sync = rf->regs[MDMCFG2] & 0x03;
+
+	rf->pkt_head_len = 0;
+	rf->pkt_head_pos = 0;
+	for (i = 0; i < PREAMBLE[(rf->regs[MDMCFG1] >> 4) & 0x07]; i++)
+		rf->pkt_head[rf->pkt_head_len++] = 0xAA;
+	for (i = 0; sync && i < (sync == 3 ? 2u : 1u); i++) {
+		rf->pkt_head[rf->pkt_head_len++] = rf->regs[SYNC1];
+		rf->pkt_head[rf->pkt_head_len++] = rf->regs[SYNC0];
+	}
+	rf->pkt_left = (rf->regs[PKTCTRL0] & 0x03) == 1 ? -1 : rf->regs[PKTLEN];
+	rf->pkt_tail = 0;
+	rf->pkt_crc = 0xFFFF;
+	rf->pkt_pn9 = 0x1FF;
+}
+
+// CRC-16 of the packet handler (polynomial 0x8005, TI DN502)
+static void rf_crc(struct emu_rf1a *rf, uint8_t byte)
+{
+	int i;
+
+	for (i = 0; i < 8; i++, byte <<= 1) {
+		if (((rf->pkt_crc >> 8) ^ byte) & 0x80)
+			rf->pkt_crc = (rf->pkt_crc << 1) ^ 0x8005;
+		else
+			rf->pkt_crc <<= 1;
+	}
+}
+
+// PN9 data whitening (x^9 + x^5 + 1, seeded with all ones, TI DN509)
+static uint8_t rf_whiten(struct emu_rf1a *rf, uint8_t byte)
+{
+	int i;
+
+	if (!(rf->regs[PKTCTRL0] & 0x40))
+		return byte;
+	byte ^= rf->pkt_pn9 & 0xFF;
+	for (i = 0; i < 8; i++)
+		rf->pkt_pn9 = (rf->pkt_pn9 >> 1) | (((rf->pkt_pn9 ^ (rf->pkt_pn9 >> 5)) & 1) << 8);
+	return byte;
+}
+
+static int rf_fifo_pop(struct emu_rf1a *rf)
+{
+	uint8_t byte;
+
+	if (rf->tx_count == 0)
+		return TX_UNDERFLOW;
+	byte = rf->txfifo[rf->tx_head];
+	rf->tx_head = (rf->tx_head + 1) % sizeof(rf->txfifo);
+	rf->tx_count--;
+	return byte;
+}
+
+// Next byte to shift out: straight from the FIFO in infinite length mode,
+// else framed by the packet handler
+static int rf_tx_byte(struct emu_rf1a *rf)
+{
+	int byte;
+
+	if (!rf_packet_mode(rf))
+		return rf_fifo_pop(rf);
+
+	if (rf->pkt_head_pos < rf->pkt_head_len)
+		return rf->pkt_head[rf->pkt_head_pos++];
+	if (rf->pkt_left != 0) {
+		byte = rf_fifo_pop(rf);
+		if (byte < 0)
+			return byte;
+		if (rf->pkt_left < 0)
+			rf->pkt_left = byte + 1;
+		rf->pkt_left--;
+		rf_crc(rf, byte);
+		if (rf->pkt_left == 0 && (rf->regs[PKTCTRL0] & 0x04))
+			rf->pkt_tail = 2;
+		return rf_whiten(rf, byte);
+	}
+	if (rf->pkt_tail) {
+		byte = rf->pkt_crc >> (8 * --rf->pkt_tail);
+		return rf_whiten(rf, byte & 0xFF);
+	}
+	return TX_END;
+}
+
+static void rf_tx_started(struct emu_rf1a *rf, double t)
+{
+	uint8_t fscal[3];
+
+	if (rf_packet_mode(rf))
+		rf_packet_start(rf);
+
+	rf_calibration(rf, fscal);
+	if (memcmp(&rf->regs[FSCAL3], fscal, sizeof(fscal)))
+		rf->uncalibrated_tx++;
+	if (rf->lost)
+		rf->stale_config_tx++;
+	if (rf->wake_at >= 0.0) {
+		double latency = t - rf->wake_at;
+
+		rf->wakes++;
+		rf->wake_latency += latency;
+		if (latency > rf->max_wake_latency)
+			rf->max_wake_latency = latency;
+		rf->wake_at = -1.0;
+	}
+}
+
+// SLEEP resets the registers it does not retain and all PATABLE entries but
+// the first, and flushes the FIFO
+static void rf_power_down(struct emu_rf1a *rf, double now)
+{
+	int reg;
+
+	for (reg = FIRST_LOST_REG; reg <= LAST_LOST_REG; reg++) {
+		if (rf->regs[reg] != RESET_REGS[reg]) {
+			rf->regs[reg] = RESET_REGS[reg];
+			rf->lost |= 1u << (reg - FIRST_LOST_REG);
+		}
+	}
+	memset(rf->patable + 1, 0, sizeof(rf->patable) - 1);
+	rf->tx_head = 0;
+	rf->tx_count = 0;
+	rf->rx_head = 0;
+	rf->rx_count = 0;
+	rf_set_state(rf, EMU_RF_SLEEP, now);
+}
+
+// Any access but a power-down strobe wakes the core, and stops WOR
+static void rf_wake(struct emu_rf1a *rf, double now)
+{
+	rf_set_state(rf, EMU_RF_IDLE, now);
+	rf->ready_at = now + XOSC_STARTUP_TIME;
+	rf->wake_at = now;
+	rf->wor = 0;
+}
+
+// Event0 period programmed in WOREVT1/WOREVT0 and WORCTRL.WOR_RES
+static double rf_event0(const struct emu_rf1a *rf)
+{
+	unsigned int event0 = rf->regs[WOREVT1] << 8 | rf->regs[WOREVT0];
+
+	return RC_PERIOD * event0 * (1u << (5 * (rf->regs[WORCTRL] & 0x03)));
+}
+
+// RX timeout of MCSM2.RX_TIME, a fraction of the Event0 period. The CC1101
+// data sheet gives it for WOR_RES = 0; it is used for every resolution.
+static double rf_rx_timeout(const struct emu_rf1a *rf)
+{
+	unsigned int rx_time = rf->regs[MCSM2] & 0x07;
+
+	if (rx_time == 7)
+		return INFINITY;
+	return rf_event0(rf) / 8.0 / (1u << rx_time);
+}
+
+static void rf_raise(struct emu_rf1a *rf, uint16_t flag)
+{
+	rf->ifg |= flag;
+}
+
+// Event0: the crystal starts during Event1, then the synthesizer calibrates
+// if MCSM0.FS_AUTOCAL asks for it and settles into RX
+static void rf_wor_event(struct emu_rf1a *rf)
+{
+	static const unsigned char EVENT1[8] = { 4, 6, 8, 12, 16, 24, 32, 48 };
+	int autocal = (rf->regs[MCSM0] >> 4) & 0x03;
+	double t = rf->wor_next;
+
+	rf_set_state(rf, EMU_RF_IDLE, t);
+	t += EVENT1[(rf->regs[WORCTRL] >> 4) & 0x07] * RC_PERIOD;
+	rf->ready_at = t;
+	rf->wor_next += rf_event0(rf);
+	rf->wor_events++;
+
+	rf->next_state = EMU_RF_RX;
+	rf->state_until = t;
+	if (autocal == 1 || (autocal == 3 && rf->wor_events % 4 == 1)) {
+		rf_set_state(rf, EMU_RF_CALIBRATE, t);
+		rf->state_until += CALIBRATE_TIME;
+	} else {
+		rf_set_state(rf, EMU_RF_SETTLING, t);
+		rf->state_until += SETTLING_TIME;
+	}
+}
+
+static void rf_rx_started(struct emu_rf1a *rf, double t)
+{
+	rf->rx_from = t;
+	rf->rx_until = rf->wor ? t + rf_rx_timeout(rf) : INFINITY;
+	rf->rx_packet = NULL;
+}
+
+static double rx_sync(const struct emu_rx_packet *p)
+{
+	return p->start + p->preamble;
+}
+
+static double rx_end(const struct emu_rx_packet *p, double bit)
+{
+	return rx_sync(p) + (SYNC_BITS + 8 * p->length + CRC_BITS) * bit;
+}
+
+// Close the RX window at time t: back to sleep under WOR, else stay in RX
+static void rf_rx_close(struct emu_rf1a *rf, double t)
+{
+	if (rf->wor) {
+		// The Event0s that came while a preamble held the window open
+		// are lost, not replayed
+		while (rf->wor_next <= t)
+			rf->wor_next += rf_event0(rf);
+		rf_power_down(rf, t);
+	} else {
+		rf_rx_started(rf, t);
+	}
+}
+
+// The packet whose sync word the receiver will find in the current RX window,
+// if any, and when the window closes otherwise. With MCSM2.RX_TIME_RSSI the
+// window closes as soon as RSSI is valid if there is no carrier; with
+// RX_TIME_QUAL it stays open past the timeout while a preamble is on air.
+static struct emu_rx_packet *rf_rx_search(struct emu_rf1a *rf, double *close)
+{
+	double bit = 1.0 / emu_rf1a_chip_rate(rf);
+	double until = rf->rx_until, sense = rf->rx_from + CARRIER_SENSE_BITS * bit;
+	int carrier = 0;
+	unsigned int i;
+
+	while (rf->air_first < rf->nair && rx_end(&rf->air[rf->air_first], bit) < rf->rx_from)
+		rf->air_first++;
+
+	if (rf->wor && (rf->regs[MCSM2] & 0x10) && sense < until) {
+		for (i = rf->air_first; i < rf->nair && rf->air[i].start <= sense; i++) {
+			if (rx_end(&rf->air[i], bit) >= sense)
+				carrier = 1;
+		}
+		if (!carrier)
+			until = sense;
+	}
+	*close = until;
+
+	for (i = rf->air_first; i < rf->nair && rf->air[i].start <= until; i++) {
+		struct emu_rx_packet *p = &rf->air[i];
+
+		if (rx_sync(p) >= rf->rx_from &&
+		    ((rf->regs[MCSM2] & 0x08) || rx_sync(p) + SYNC_BITS * bit <= until))
+			return p;
+	}
+	return NULL;
+}
+
+// Hardware address filtering of PKTCTRL1.ADR_CHK
+static int rf_address_match(const struct emu_rf1a *rf, const struct emu_rx_packet *p)
+{
+	int check = rf->regs[PKTCTRL1] & 0x03;
+	uint8_t address = p->bytes[(rf->regs[PKTCTRL0] & 0x03) == 1 ? 1 : 0];
+
+	return check == 0 || address == rf->regs[ADDR] ||
+	       (check >= 2 && address == 0x00) || (check == 3 && address == 0xFF);
+}
+
+// End of packet: the bytes and appended status go to the RX FIFO, and the
+// core leaves RX as MCSM1.RXOFF_MODE says
+static void rf_rx_done(struct emu_rf1a *rf, struct emu_rx_packet *p, double t)
+{
+	unsigned int i;
+
+	for (i = 0; i < p->length + ((rf->regs[PKTCTRL1] & 0x04) ? 2 : 0); i++) {
+		uint8_t byte = i < p->length ? p->bytes[i] :
+		               i == p->length ? p->rssi : (p->crc_ok ? 0x80 : 0x00) | 0x2F;
+
+		if (rf->rx_count < sizeof(rf->rxfifo)) {
+			rf->rxfifo[(rf->rx_head + rf->rx_count) % sizeof(rf->rxfifo)] = byte;
+			rf->rx_count++;
+		}
+	}
+	p->received_at = t;
+	rf->rx_packets++;
+	rf->rx_packet = NULL;
+	if (rf->ies & BIT9)
+		rf_raise(rf, BIT9);
+
+	if (((rf->regs[MCSM1] >> 2) & 0x03) == 3)
+		rf_rx_started(rf, t);
+	else
+		rf_set_state(rf, EMU_RF_IDLE, t);
+}
+
+// Time of the next change in RX, see emu_rf1a_next_event()
+static double rf_rx_next(struct emu_rf1a *rf, struct emu_rx_packet **caught)
+{
+	double bit = 1.0 / emu_rf1a_chip_rate(rf), close;
+
+	if (rf->rx_packet) {
+		*caught = rf->rx_packet;
+		return rx_end(rf->rx_packet, bit);
+	}
+	*caught = rf_rx_search(rf, &close);
+	if (*caught)
+		return rx_sync(*caught) + SYNC_BITS * bit;
+	return close;
+}
+
+// Advance reception up to the given time; returns 0 once caught up
+static int rf_receive(struct emu_rf1a *rf, double now)
+{
+	struct emu_rx_packet *p;
+	double t = rf_rx_next(rf, &p);
+
+	if (t > now)
+		return 0;
+	if (rf->rx_packet) {
+		rf_rx_done(rf, p, t);
+	} else if (!p) {
+		rf_rx_close(rf, t);
+	} else if (!rf_address_match(rf, p)) {
+		rf->rx_filtered++;
+		rf_rx_close(rf, t);
+	} else {
+		rf->rx_packet = p;
+		if (!(rf->ies & BIT9))
+			rf_raise(rf, BIT9);
+	}
+	return 1;
+}
+
+// End of a packet: leave TX as MCSM1.TXOFF_MODE says
+static void rf_tx_off(struct emu_rf1a *rf, double t)
+{
+	switch (rf->regs[MCSM1] & 0x03) {
+	case 1:
+		rf_set_state(rf, EMU_RF_FSTXON, t);
+		break;
+	case 2:
+		rf_packet_start(rf);
+		break;
+	case 3:
+		rf_set_state(rf, EMU_RF_RX, t);
+		rf_rx_started(rf, t);
+		break;
+	default:
+		rf_set_state(rf, EMU_RF_IDLE, t);
+		break;
+	}
+}
+
+double emu_rf1a_next_event(struct emu_rf1a *rf)
+{
+	struct emu_rx_packet *p;
+
+	switch (rf->state) {
+	case EMU_RF_SLEEP:
+		return rf->wor ? rf->wor_next : INFINITY;
+	case EMU_RF_CALIBRATE:
+	case EMU_RF_SETTLING:
+		return rf->next_state == EMU_RF_RX ? rf->state_until : INFINITY;
+	case EMU_RF_RX:
+		return rf_rx_next(rf, &p);
+	default:
+		return INFINITY;
+	}
+}
+
+// Advance calibration, settling, transmission, wake-on-radio and reception
+// up to the given time
+void emu_rf1a_update(struct emu_rf1a *rf, double now)
+{
+	for (;;) {
+		switch (rf->state) {
+		case EMU_RF_SLEEP:
+			if (!rf->wor || now < rf->wor_next)
+				return;
+			rf_wor_event(rf);
+			break;
+
+		case EMU_RF_CALIBRATE:
+			if (now < rf->state_until)
+				return;
+			rf_calibrated(rf);
+			if (rf->next_state == EMU_RF_IDLE) {
+				rf_set_state(rf, EMU_RF_IDLE, rf->state_until);
+			} else {
+				rf_set_state(rf, EMU_RF_SETTLING, rf->state_until);
+				rf->state_until += SETTLING_TIME;
+			}
+			break;
+
+		case EMU_RF_SETTLING:
+			if (now < rf->state_until)
+				return;
+			rf_set_state(rf, rf->next_state, rf->state_until);
+			rf->next_byte = rf->state_until;
+			if (rf->state == EMU_RF_TX)
+				rf_tx_started(rf, rf->state_until);
+			else if (rf->state == EMU_RF_RX)
+				rf_rx_started(rf, rf->state_until);
+			break;
+
+		case EMU_RF_RX:
+			if (!rf_receive(rf, now))
+				return;
+			break;
+
+		case EMU_RF_TX: {
+			double byte_time = 8.0 / emu_rf1a_chip_rate(rf);
+			int byte;
+
+			while (rf->next_byte <= now) {
+				byte = rf_tx_byte(rf);
+				if (byte == TX_UNDERFLOW) {
+					rf_set_state(rf, EMU_RF_TXFIFO_UNDERFLOW, rf->next_byte);
+					rf->burst_open = 0;
+					return;
+				}
+				if (byte == TX_END) {
+					rf->burst_open = 0;
+					rf->tx_packets++;
+					rf_tx_off(rf, rf->next_byte);
+					break;
+				}
+				rf_emit(rf, rf->next_byte, byte);
+				rf->next_byte += byte_time;
+			}
+			if (rf->state == EMU_RF_TX && rf->next_byte > now)
+				return;
+			break;
+		}
+
+		default:
+			return;
+		}
+	}
+}
+
+// Enter TX, RX or FSTXON, calibrating first when MCSM0.FS_AUTOCAL asks for it
+static void rf_start_fs(struct emu_rf1a *rf, double now, int target)
+{
+	int autocal = (rf->regs[MCSM0] >> 4) & 0x03;
+
+	rf->next_state = target;
+	rf->state_until = now;
+	if (rf->state == EMU_RF_IDLE && autocal == 1) {
+		rf_set_state(rf, EMU_RF_CALIBRATE, now);
+		rf->state_until += CALIBRATE_TIME;
+	} else {
+		rf_set_state(rf, EMU_RF_SETTLING, now);
+		rf->state_until += SETTLING_TIME;
+	}
+}
+
+static void rf_strobe(struct emu_rf1a *rf, uint8_t command, double now)
+{
+	int rx = command & 0x80;
+
+	command &= 0x3F;
+	if (command != RF_SNOP)
+		rf->pa_index = 0;
+
+	if (rf_asleep(rf) && command != RF_SPWD && command != RF_SXOFF && command != RF_SWOR)
+		rf_wake(rf, now);
+
+	switch (command) {
+	case RF_SRES:
+		rf_reset(rf);
+		rf_set_state(rf, EMU_RF_IDLE, now);
+		rf->ready_at = now + XOSC_STARTUP_TIME;
+		break;
+	case RF_SFSTXON:
+		if (rf->state == EMU_RF_IDLE)
+			rf_start_fs(rf, now, EMU_RF_FSTXON);
+		break;
+	case RF_SXOFF:
+		if (rf->state == EMU_RF_IDLE)
+			rf_set_state(rf, EMU_RF_XOFF, now);
+		break;
+	case RF_SCAL:
+		if (rf->state == EMU_RF_IDLE) {
+			rf_set_state(rf, EMU_RF_CALIBRATE, now);
+			rf->next_state = EMU_RF_IDLE;
+			rf->state_until = now + CALIBRATE_TIME;
+		}
+		break;
+	case RF_SRX:
+		if (rf->state == EMU_RF_IDLE || rf->state == EMU_RF_FSTXON)
+			rf_start_fs(rf, now, EMU_RF_RX);
+		break;
+	case RF_STX:
+		if (rf->state == EMU_RF_IDLE || rf->state == EMU_RF_FSTXON)
+			rf_start_fs(rf, now, EMU_RF_TX);
+		break;
+	case RF_SIDLE:
+		rf_set_state(rf, EMU_RF_IDLE, now);
+		rf->burst_open = 0;
+		rf->rx_packet = NULL;
+		rf->wor = 0;
+		break;
+	case RF_SWOR:
+		if (rf->state == EMU_RF_IDLE) {
+			rf_power_down(rf, now);
+			rf->wor = 1;
+			rf->wor_next = now + rf_event0(rf);
+		}
+		break;
+	case RF_SWORRST:
+		if (rf->wor)
+			rf->wor_next = now + rf_event0(rf);
+		break;
+	case RF_SPWD:
+		if (rf->state == EMU_RF_IDLE)
+			rf_power_down(rf, now);
+		break;
+	case RF_SFRX:
+		if (rf->state == EMU_RF_IDLE || rf->state == EMU_RF_RXFIFO_OVERFLOW) {
+			rf->rx_head = 0;
+			rf->rx_count = 0;
+		}
+		break;
+	case RF_SFTX:
+		if (rf->state == EMU_RF_IDLE || rf->state == EMU_RF_TXFIFO_UNDERFLOW) {
+			rf->tx_head = 0;
+			rf->tx_count = 0;
+		}
+		break;
+	default:
+		break;
+	}
+
+	rf->statb = rf_status(rf, now, rx);
+	rf->ifctl1 |= RFSTATIFG | RFINSTRIFG;
+	emu_rf1a_trace(rf, now, EMU_RFTRACE_STROBE, command, rf->statb, 0);
+}
+
+static void rf_data(struct emu_rf1a *rf, uint8_t value, double now)
+{
+	int addr = rf->target & 0x3F;
+
+	if (rf->target != TARGET_NONE) {
+		if (addr == TXFIFO) {
+			if (rf->tx_count < sizeof(rf->txfifo)) {
+				rf->txfifo[(rf->tx_head + rf->tx_count) % sizeof(rf->txfifo)] = value;
+				rf->tx_count++;
+			}
+			emu_rf1a_trace(rf, now, EMU_RFTRACE_FIFO, addr, value, rf->tx_count);
+		} else if (addr == PATABLE) {
+			emu_rf1a_trace(rf, now, EMU_RFTRACE_WRITE, addr, value, rf->pa_index);
+			rf->patable[rf->pa_index] = value;
+			rf->pa_index = (rf->pa_index + 1) & 0x07;
+		} else if (addr < (int)sizeof(rf->regs)) {
+			rf->regs[addr] = value;
+			emu_rf1a_trace(rf, now, EMU_RFTRACE_WRITE, addr, value, 0);
+			if (addr >= FIRST_LOST_REG && addr <= LAST_LOST_REG)
+				rf->lost &= ~(1u << (addr - FIRST_LOST_REG));
+			if (rf->target & TARGET_BURST)
+				rf->target++;
+		}
+		if (!(rf->target & TARGET_BURST))
+			rf->target = TARGET_NONE;
+	}
+
+	rf->doutb = rf->dout0b = rf->dout1b = rf_status(rf, now, 0);
+	rf->ifctl1 |= RFDINIFG | RFDOUTIFG | RFINSTRIFG;
+}
+
+static uint8_t rf_read(struct emu_rf1a *rf, int addr, double now)
+{
+	switch (addr) {
+	case PATABLE: {
+		uint8_t value = rf->patable[rf->pa_index];
+		rf->pa_index = (rf->pa_index + 1) & 0x07;
+		return value;
+	}
+	case PARTNUM:
+		return 0x00;
+	case VERSION:
+		return 0x06;
+	case MARCSTATE:
+		return MARCSTATE_VALUE[rf->state];
+	case TXBYTES:
+		return rf->tx_count | (rf->state == EMU_RF_TXFIFO_UNDERFLOW ? 0x80 : 0);
+	case RXBYTES:
+		return rf->rx_count | (rf->state == EMU_RF_RXFIFO_OVERFLOW ? 0x80 : 0);
+	case RXFIFO: {
+		uint8_t value = rf->rxfifo[rf->rx_head];
+
+		if (rf->rx_count) {
+			rf->rx_head = (rf->rx_head + 1) % sizeof(rf->rxfifo);
+			rf->rx_count--;
+		}
+		return value;
+	}
+	default:
+		if (addr < (int)sizeof(rf->regs))
+			return rf->regs[addr];
+		(void)now;
+		return 0;
+	}
+}
+
+static void rf_autoread(struct emu_rf1a *rf, double now)
+{
+	uint8_t value;
+
+	if (rf->autoread == TARGET_NONE)
+		return;
+	value = rf_read(rf, rf->autoread & 0x3F, now);
+	emu_rf1a_trace(rf, now, EMU_RFTRACE_READ, rf->autoread & 0x3F, value, 0);
+	if ((rf->autoread & 0x3F) < PATABLE)
+		rf->autoread++;
+	rf->doutb = rf->dout0b = rf->dout1b = value;
+	rf->ifctl1 |= RFDOUTIFG;
+}
+
+static void rf_instruction(struct emu_rf1a *rf, uint8_t instr, double now)
+{
+	int addr = instr & 0x3F;
+
+	if (addr >= RF_SRES && addr <= RF_SNOP && !(instr & RF_REGWR)) {
+		rf_strobe(rf, instr, now);
+		return;
+	}
+
+	if (rf_asleep(rf))
+		rf_wake(rf, now);
+
+	if (instr & RF_SNGLREGRD) {
+		// Read instruction with auto-read of the first byte
+		rf->autoread = addr | (instr & TARGET_BURST);
+		rf_autoread(rf, now);
+		if (!(instr & TARGET_BURST))
+			rf->autoread = TARGET_NONE;
+	} else {
+		rf->target = addr | (instr & TARGET_BURST);
+	}
+	rf->ifctl1 |= RFINSTRIFG;
+}
+
+static void rf_commit(struct emu_rf1a *rf, double now)
+{
+	int reg = rf->pending;
+
+	rf->pending = -1;
+	switch (reg) {
+	case EMU_RF1AINSTRB:
+	case EMU_RF1AINSTR1B:
+		rf_instruction(rf, reg == EMU_RF1AINSTRB ? rf->instrb : rf->instr1b, now);
+		break;
+	case EMU_RF1AINSTRW:
+		rf_instruction(rf, rf->instrw >> 8, now);
+		rf_data(rf, rf->instrw & 0xFF, now);
+		break;
+	case EMU_RF1ADINB:
+		rf_data(rf, rf->dinb, now);
+		break;
+	case EMU_RF1ADOUT1B:
+		rf_autoread(rf, now);
+		break;
+	default:
+		break;
+	}
+}
+
+// Level of a GDO signal selected by an IOCFGx register
+static int rf_gdo(const struct emu_rf1a *rf, uint8_t cfg, double now)
+{
+	int level;
+
+	switch (cfg & 0x3F) {
+	case 0x29: // CHIP_RDYn
+		level = !rf_ready(rf, now);
+		break;
+	default:
+		level = 0;
+		break;
+	}
+	return (cfg & 0x40) ? !level : level;
+}
+
+volatile void *emu_rf1a_reg(int reg)
+{
+	struct emu_sprite *s = emu_cur;
+	struct emu_rf1a *rf = &s->rf;
+
+	emu_advance(EMU_RF1A_ACCESS_CYCLES);
+	emu_rf1a_update(rf, s->now);
+	if (rf->pending >= 0)
+		rf_commit(rf, s->now);
+
+	switch (reg) {
+	case EMU_RF1AIFCTL1:
+		return &rf->ifctl1;
+	case EMU_RF1AIN:
+		rf->in = rf_gdo(rf, rf->regs[IOCFG0], s->now)
+		       | rf_gdo(rf, rf->regs[IOCFG1], s->now) << 1
+		       | rf_gdo(rf, rf->regs[IOCFG2], s->now) << 2;
+		return &rf->in;
+	case EMU_RF1ASTATB:
+		return &rf->statb;
+	case EMU_RF1ADOUTB:
+		rf->ifctl1 &= ~RFDOUTIFG;
+		rf->autoread = TARGET_NONE;
+		return &rf->doutb;
+	case EMU_RF1ADOUT0B:
+		rf->ifctl1 &= ~RFDOUTIFG;
+		rf->autoread = TARGET_NONE;
+		return &rf->dout0b;
+	case EMU_RF1ADOUT1B:
+		rf->ifctl1 &= ~RFDOUTIFG;
+		rf->pending = reg;
+		return &rf->dout1b;
+	case EMU_RF1AINSTRW:
+		rf->pending = reg;
+		return &rf->instrw;
+	case EMU_RF1AINSTRB:
+		rf->pending = reg;
+		return &rf->instrb;
+	case EMU_RF1AINSTR1B:
+		rf->pending = reg;
+		return &rf->instr1b;
+	case EMU_RF1ADINB:
+		rf->pending = reg;
+		return &rf->dinb;
+	case EMU_RF1AIFG:
+		return &rf->ifg;
+	case EMU_RF1AIE:
+		return &rf->ie;
+	case EMU_RF1AIES:
+		return &rf->ies;
+	case EMU_RF1AIV: {
+		// Highest priority pending interrupt, whose flag the read clears
+		uint16_t pending = rf->ifg & rf->ie;
+		int bit;
+
+		rf->iv = RF1AIV_NONE;
+		for (bit = 0; bit < 16; bit++) {
+			if (pending & (1u << bit)) {
+				rf->iv = 2 * (bit + 1);
+				rf->ifg &= ~(1u << bit);
+				break;
+			}
+		}
+		return &rf->iv;
+	}
+	default:
+		abort();
+	}
+}
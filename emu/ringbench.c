@@ -0,0 +1,190 @@
+/*
+  ringbench.c - Stress the ringbuf queue with a producer and a consumer
+  thread.
+
+  The producer pushes records of varying length through a small queue, so
+  that most of them wrap around its end and many fill it: each holds its
+  sequence number, bytes derived from it and a checksum. Every other record
+  reserves more room than it commits. The consumer checks that records come
+  out in order, each with the length and bytes it was given, and that none
+  is lost. Build sprite-ring-tsan to run it under ThreadSanitizer, which
+  checks that the acquire and release of the indexes order the records.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ringbuf.h"
+
+// Sequence number and checksum
+#define RECORD_OVERHEAD 5
+
+struct bench {
+	ringbuf_t rb;
+	unsigned long records;
+	unsigned int max_length;
+
+	// Producer
+	unsigned long wraps, full;
+
+	// Consumer
+	unsigned long received, bytes, empty, errors;
+};
+
+static double wall_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t mix(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7FEB352Du;
+	x ^= x >> 15;
+	x *= 0x846CA68Bu;
+	return x ^ (x >> 16);
+}
+
+static unsigned int record_length(const struct bench *b, uint32_t seq)
+{
+	return RECORD_OVERHEAD + mix(seq) % (b->max_length - RECORD_OVERHEAD + 1);
+}
+
+// Sequence number, bytes of it and a checksum of all of them
+static void fill(uint8_t *p, uint32_t seq, unsigned int length)
+{
+	uint8_t sum = 0;
+	unsigned int i;
+
+	memcpy(p, &seq, sizeof(seq));
+	for (i = sizeof(seq); i < length - 1; i++)
+		p[i] = (uint8_t)(mix(seq + i) >> 8);
+	for (i = 0; i < length - 1; i++)
+		sum += p[i];
+	p[length - 1] = ~sum;
+}
+
+static void *produce(void *arg)
+{
+	struct bench *b = arg;
+	unsigned long seq;
+	unsigned int length, reserve;
+	uint8_t *p;
+
+	for (seq = 0; seq < b->records; seq++) {
+		length = record_length(b, seq);
+		reserve = seq & 1 ? b->max_length : length;
+		while (!(p = ringbuf_reserve(&b->rb, reserve))) {
+			b->full++;
+			sched_yield();
+		}
+		b->wraps += b->rb.pad != 0;
+		fill(p, seq, length);
+		ringbuf_commit(&b->rb, length);
+	}
+	return NULL;
+}
+
+static void *consume(void *arg)
+{
+	struct bench *b = arg;
+	uint8_t expected[32768];
+	const uint8_t *p;
+	uint16_t length;
+	uint32_t seq;
+	int ok;
+
+	while (b->received < b->records) {
+		p = ringbuf_peek(&b->rb, &length);
+		if (!p) {
+			b->empty++;
+			sched_yield();
+			continue;
+		}
+		seq = b->received;
+		ok = length == record_length(b, seq);
+		if (ok) {
+			fill(expected, seq, length);
+			ok = !memcmp(p, expected, length);
+		}
+		if (!ok && b->errors++ < 10) {
+			if (length >= sizeof(seq))
+				memcpy(&seq, p, sizeof(seq));
+			fprintf(stderr, "record %lu: %u bytes, sequence number %lu, bad\n",
+			        b->received, length, (unsigned long)seq);
+		}
+		b->bytes += length;
+		b->received++;
+		ringbuf_release(&b->rb);
+	}
+	return NULL;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -n N       records to push (default 10000000)\n"
+		"  -s BYTES   queue size, a power of two from 16 to 32768 (default 64)\n"
+		"  -l BYTES   longest record, from 5 to half the queue less 2 (default: a\n"
+		"             third of the queue)\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t storage[32768] __attribute__((aligned(2)));
+	static struct bench b;
+	unsigned long size = 64;
+	pthread_t producer, consumer;
+	double t0, t;
+	uint16_t length;
+	int opt;
+
+	b.records = 10000000;
+	while ((opt = getopt(argc, argv, "n:s:l:h")) != -1) {
+		switch (opt) {
+		case 'n': b.records = strtoul(optarg, NULL, 0); break;
+		case 's': size = strtoul(optarg, NULL, 0); break;
+		case 'l': b.max_length = strtoul(optarg, NULL, 0); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (!b.max_length)
+		b.max_length = size / 3;
+	if (size < 16 || size > sizeof(storage) || (size & (size - 1)) ||
+	    b.max_length < RECORD_OVERHEAD || b.max_length > RINGBUF_MAX_LENGTH(size)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	ringbuf_init(&b.rb, storage, size);
+	t0 = wall_clock();
+	if (pthread_create(&consumer, NULL, consume, &b) ||
+	    pthread_create(&producer, NULL, produce, &b)) {
+		perror("pthread_create");
+		return 1;
+	}
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	t = wall_clock() - t0;
+	if (ringbuf_peek(&b.rb, &length)) {
+		fprintf(stderr, "records left in the queue\n");
+		b.errors++;
+	}
+
+	printf("%lu records of 5 to %u bytes through a %lu-byte queue in %.3f s"
+	       " (%.1f M records/s, %.1f MB/s)\n",
+	       b.received, b.max_length, size, t, b.received / t * 1e-6, b.bytes / t * 1e-6);
+	printf("%lu wraps, %lu full and %lu empty polls, %lu bad records\n",
+	       b.wraps, b.full, b.empty, b.errors);
+	return b.errors != 0;
+}
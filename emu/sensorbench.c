@@ -0,0 +1,185 @@
+/*
+  sensorbench.c - Run the sensor sampling scheduler against emulated sensors
+  and measure its timing.
+
+  A gyro and a magnetometer are modelled as read callbacks that hold the CPU
+  for the duration of their I2C transfer at the given bus speed. The scheduler
+  runs unchanged in virtual time; the bench compares each sample with its ideal
+  time on the sensor's grid and reports the jitter, the samples drained from
+  the per-sensor queues, and the fraction of time the CPU was awake.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "emu.h"
+#include "SpriteRadio.h"
+#include "sensors.h"
+
+#define QUEUE_SIZE 256
+
+// I2C framing: address + register pointer, repeated start + address, data
+// bytes; 9 bits per byte plus start, repeated start and stop conditions
+#define I2C_READ_BITS(n) (9 * (3 + (n)) + 3)
+
+struct emulated_sensor {
+	const char *name;
+	double rate_hz;
+	unsigned int sample_size;
+	double t0;              // Time of the first sample, anchoring the grid
+
+	unsigned long reads;
+	double jitter_sum, jitter_sq, jitter_max;
+	unsigned long drained;
+	uint32_t last_timestamp;
+	unsigned long out_of_order;
+};
+
+static double bus_hz = 400000.0;
+static unsigned long bus_sessions;
+static double session_start, bus_time;
+
+static void emulated_read(void *context, uint8_t *sample)
+{
+	struct emulated_sensor *es = context;
+	double period = 1.0 / es->rate_hz;
+	double now = emu_cur->now, jitter;
+	unsigned int i;
+
+	if (es->reads == 0)
+		es->t0 = now;
+	jitter = now - (es->t0 + es->reads * period);
+	es->reads++;
+	es->jitter_sum += jitter;
+	es->jitter_sq += jitter * jitter;
+	if (fabs(jitter) > es->jitter_max)
+		es->jitter_max = fabs(jitter);
+
+	for (i = 0; i < es->sample_size; i++)
+		sample[i] = (uint8_t)(es->reads + i);
+
+	// The driver busy-waits on the USCI while the transfer runs
+	emu_advance(I2C_READ_BITS(es->sample_size) / bus_hz * emu_cur->f_cpu);
+}
+
+static void bus_begin(void)
+{
+	bus_sessions++;
+	session_start = emu_cur->now;
+}
+
+static void bus_end(void)
+{
+	bus_time += emu_cur->now - session_start;
+}
+
+static void drain(struct emulated_sensor *es, ringbuf_t *queue)
+{
+	const uint8_t *record;
+	uint16_t length;
+	uint32_t timestamp;
+
+	while ((record = ringbuf_peek(queue, &length))) {
+		memcpy(&timestamp, record, SENSOR_TIMESTAMP_SIZE);
+		if (es->drained && (int32_t)(timestamp - es->last_timestamp) < 0)
+			es->out_of_order++;
+		es->last_timestamp = timestamp;
+		es->drained++;
+		ringbuf_release(queue);
+	}
+}
+
+static void report(const struct emulated_sensor *es, const sensor_t *sensor)
+{
+	double n = es->reads ? es->reads : 1;
+	double mean = es->jitter_sum / n;
+	double sd = sqrt(fmax(es->jitter_sq / n - mean * mean, 0.0));
+
+	printf("%-5s %6.1f Hz: %lu samples, %lu drained, %lu dropped, %lu missed, %lu out of order\n"
+	       "      jitter vs. ideal grid: mean %.1f us, sd %.1f us, max %.1f us"
+	       " (scheduler saw %ld..%ld us)\n",
+	       es->name, es->rate_hz, es->reads, es->drained,
+	       (unsigned long)sensor->dropped, (unsigned long)sensor->missed,
+	       es->out_of_order, mean * 1e6, sd * 1e6, es->jitter_max * 1e6,
+	       (long)sensor->jitter_min_us, (long)sensor->jitter_max_us);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -g HZ      gyro sample rate (default 100)\n"
+		"  -m HZ      magnetometer sample rate (default 15)\n"
+		"  -w US      batching window (default 2000)\n"
+		"  -b HZ      I2C bus speed (default 400000)\n"
+		"  -t SEC     virtual time to run for (default 60)\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	struct emulated_sensor gyro = { "gyro", 100.0, 6 };
+	struct emulated_sensor mag = { "mag", 15.0, 6 };
+	static uint8_t gyro_storage[QUEUE_SIZE], mag_storage[QUEUE_SIZE];
+	ringbuf_t gyro_queue, mag_queue;
+	sensor_t gyro_sensor, mag_sensor;
+	sensor_sched_t sched;
+	struct emu_sprite s;
+	double duration = 60.0, start, asleep;
+	unsigned long wakeups;
+	unsigned long window = 2000;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "g:m:w:b:t:h")) != -1) {
+		switch (opt) {
+		case 'g': gyro.rate_hz = strtod(optarg, NULL); break;
+		case 'm': mag.rate_hz = strtod(optarg, NULL); break;
+		case 'w': window = strtoul(optarg, NULL, 0); break;
+		case 'b': bus_hz = strtod(optarg, NULL); break;
+		case 't': duration = strtod(optarg, NULL); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (gyro.rate_hz <= 0.0 || mag.rate_hz <= 0.0 || bus_hz <= 0.0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	emu_sprite_init(&s, F_CPU);
+	emu_cur = &s;
+	s.gie = 1;
+
+	// Starts the watchdog timekeeping
+	SpriteRadio_SpriteRadio();
+
+	ringbuf_init(&gyro_queue, gyro_storage, sizeof(gyro_storage));
+	ringbuf_init(&mag_queue, mag_storage, sizeof(mag_storage));
+	sensors_init(&sched, window, bus_begin, bus_end);
+	sensors_add(&sched, &gyro_sensor, (uint32_t)(1e6 / gyro.rate_hz + 0.5),
+	            emulated_read, &gyro, gyro.sample_size, &gyro_queue);
+	sensors_add(&sched, &mag_sensor, (uint32_t)(1e6 / mag.rate_hz + 0.5),
+	            emulated_read, &mag, mag.sample_size, &mag_queue);
+
+	start = s.now;
+	asleep = s.asleep;
+	wakeups = s.wakeups;
+	while (s.now - start < duration) {
+		sensors_run(&sched);
+		drain(&gyro, &gyro_queue);
+		drain(&mag, &mag_queue);
+	}
+
+	report(&gyro, &gyro_sensor);
+	report(&mag, &mag_sensor);
+	printf("%lu bus sessions for %lu samples (window %lu us, bus %.0f kHz)\n"
+	       "CPU awake %.3f%% of %.1f s, %.1f%% of it in bus sessions, %lu wake-ups\n",
+	       bus_sessions, gyro.reads + mag.reads, window, bus_hz / 1e3,
+	       100.0 * (1.0 - (s.asleep - asleep) / (s.now - start)), s.now - start,
+	       100.0 * bus_time / (s.now - start - (s.asleep - asleep)), s.wakeups - wakeups);
+
+	emu_sprite_free(&s);
+	return 0;
+}
@@ -0,0 +1,392 @@
+/*
+  swarm.c - Run many emulated sprites and mix their transmissions into one
+  baseband recording.
+
+  Every sprite executes the real SpriteRadio firmware in virtual time with its
+  own PRN pair and RNG seed, on a pool of worker threads, in spread or CSK
+  mode, with the sprites in CSK mode spread over disjoint code sets. The chips shifted out
+  by each radio are then mixed into a shared channel with a per-sprite delay,
+  power, carrier phase and crystal error, and written as interleaved float32
+  I/Q samples.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "emu.h"
+#include "SpriteRadio.h"
+#include "random.h"
+#include "csk.h"
+
+#define MIX_BLOCK_SAMPLES 65536
+#define TWO_PI (2.0 * 3.14159265358979323846)
+
+// Firmware state, one copy per thread
+extern __thread const unsigned char *m_prn0;
+extern __thread const unsigned char *m_prn1;
+extern __thread unsigned int m_csk_first;
+
+// Gold code pairs available from src/prn.c
+extern const unsigned char PRN_2[], PRN_3[];
+extern const unsigned char PRN_266[], PRN_267[];
+extern const unsigned char PRN_268[], PRN_269[];
+
+static const struct {
+	int index[2];
+	const unsigned char *prn[2];
+} PRN_PAIRS[] = {
+	{ { 2, 3 }, { PRN_2, PRN_3 } },
+	{ { 266, 267 }, { PRN_266, PRN_267 } },
+	{ { 268, 269 }, { PRN_268, PRN_269 } },
+};
+#define NUM_PRN_PAIRS (sizeof(PRN_PAIRS) / sizeof(PRN_PAIRS[0]))
+
+struct sprite {
+	unsigned int pair;
+	unsigned int csk_first;     // Gold code index of its CSK symbol 0
+	unsigned long seed;
+	double delay;           // Start of the sprite's clock on the shared channel
+	double power_db;
+	double phase;
+	double clock;           // Crystal error, fast if positive
+	double duration;        // Virtual time the firmware ran for
+
+	struct emu_burst *bursts;
+	unsigned int nbursts;
+};
+
+struct swarm {
+	struct sprite *sprites;
+	unsigned int nsprites;
+	const char *message;
+	int csk;
+	unsigned int csk_sets;
+	unsigned int repeat;
+
+	double fs;
+	unsigned int osr;
+	unsigned long nsamples;
+	float *samples;
+
+	atomic_uint next;
+};
+
+static double wall_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run_sprite(struct swarm *w, struct sprite *sp)
+{
+	struct emu_sprite s;
+	char message[256];
+	unsigned int length = strlen(w->message);
+
+	emu_sprite_init(&s, F_CPU);
+	emu_cur = &s;
+	s.gie = 1;
+
+	SpriteRadio_SpriteRadio();
+	m_prn0 = PRN_PAIRS[sp->pair].prn[0];
+	m_prn1 = PRN_PAIRS[sp->pair].prn[1];
+	m_csk_first = sp->csk_first;
+	srandom(sp->seed);
+
+	memcpy(message, w->message, length);
+	if (w->csk)
+		SpriteRadio_setMode(SR_MODE_CSK, 0);
+	SpriteRadio_setRepeat(w->repeat);
+	SpriteRadio_txInit();
+	SpriteRadio_transmit(message, length);
+	SpriteRadio_sleep();
+
+	// Hand the recorded bursts over to the mixer
+	sp->duration = s.now;
+	sp->bursts = s.rf.bursts;
+	sp->nbursts = s.rf.nbursts;
+	s.rf.bursts = NULL;
+	s.rf.nbursts = 0;
+	emu_sprite_free(&s);
+	emu_cur = NULL;
+}
+
+struct sprite_run {
+	struct swarm *w;
+	struct sprite *sp;
+};
+
+static void *sprite_main(void *arg)
+{
+	struct sprite_run *r = arg;
+
+	run_sprite(r->w, r->sp);
+	return NULL;
+}
+
+static void *emulate_worker(void *arg)
+{
+	struct swarm *w = arg;
+	struct sprite_run r = { w, NULL };
+	pthread_t thread;
+	unsigned int i;
+
+	// Each sprite gets a thread of its own, so that the firmware's
+	// SPRITE_STATE starts from its initial values as after a reset rather
+	// than from where the previous sprite left it
+	while ((i = atomic_fetch_add(&w->next, 1)) < w->nsprites) {
+		r.sp = &w->sprites[i];
+		if (pthread_create(&thread, NULL, sprite_main, &r)) {
+			fprintf(stderr, "cannot start a thread for sprite %u\n", i);
+			exit(1);
+		}
+		pthread_join(thread, NULL);
+	}
+	return NULL;
+}
+
+// Add one sprite's chips that fall into samples [n0, n1)
+static void mix_sprite(const struct swarm *w, const struct sprite *sp,
+                       unsigned long n0, unsigned long n1)
+{
+	double amp = pow(10.0, sp->power_db / 20.0);
+	double scale = 1.0 - sp->clock;     // Of the sprite's time on the channel
+	float ci = amp * cos(sp->phase), cq = amp * sin(sp->phase);
+	unsigned int b;
+
+	for (b = 0; b < sp->nbursts; b++) {
+		const struct emu_burst *bu = &sp->bursts[b];
+		double start = bu->start * scale + sp->delay;
+		double chip_time = bu->chip_time * scale;
+		double nchips = 8.0 * bu->length;
+		long first = (long)ceil(start * w->fs);
+		long last = (long)ceil((start + nchips * chip_time) * w->fs);
+		long n;
+
+		if (first < (long)n0)
+			first = n0;
+		if (last > (long)n1)
+			last = n1;
+
+		for (n = first; n < last; n++) {
+			long k = (long)floor((n / w->fs - start) / chip_time);
+			int chip;
+
+			if (k < 0 || k >= (long)nchips)
+				continue;
+			chip = (bu->bytes[k >> 3] >> (7 - (k & 7))) & 1;
+			w->samples[2 * n] += chip ? ci : -ci;
+			w->samples[2 * n + 1] += chip ? cq : -cq;
+		}
+	}
+}
+
+static void *mix_worker(void *arg)
+{
+	struct swarm *w = arg;
+	unsigned long nblocks = (w->nsamples + MIX_BLOCK_SAMPLES - 1) / MIX_BLOCK_SAMPLES;
+	unsigned int blk, i;
+
+	while ((blk = atomic_fetch_add(&w->next, 1)) < nblocks) {
+		unsigned long n0 = (unsigned long)blk * MIX_BLOCK_SAMPLES;
+		unsigned long n1 = n0 + MIX_BLOCK_SAMPLES;
+
+		if (n1 > w->nsamples)
+			n1 = w->nsamples;
+		for (i = 0; i < w->nsprites; i++)
+			mix_sprite(w, &w->sprites[i], n0, n1);
+	}
+	return NULL;
+}
+
+// Runs fn on nthreads threads, the calling one included, and returns how
+// many actually ran: the workers take the work item by item, so the calling
+// thread does whatever the threads that could not be started would have done.
+static unsigned int run_pool(unsigned int nthreads, void *(*fn)(void *), struct swarm *w)
+{
+	pthread_t *threads = nthreads > 1 ? calloc(nthreads - 1, sizeof(*threads)) : NULL;
+	unsigned int started, i;
+
+	if (!threads)
+		nthreads = 1;
+	atomic_store(&w->next, 0);
+	for (started = 0; started < nthreads - 1; started++)
+		if (pthread_create(&threads[started], NULL, fn, w))
+			break;
+	fn(w);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	return started + 1;
+}
+
+static double uniform(unsigned long *ctx)
+{
+	return (double)random_r(ctx) / 2147483647.0;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -n N       number of sprites (default 100)\n"
+		"  -j N       worker threads (default: all cores)\n"
+		"  -m TEXT    message every sprite transmits (default \"KickSat\")\n"
+		"  -k         transmit in CSK mode (SpriteRadio_setMode())\n"
+		"  -f N       CSK code sets the sprites are spread over, one after the\n"
+		"             other from Gold code 4 (default 1)\n"
+		"  -K N       send every frame N times (SpriteRadio_setRepeat())\n"
+		"  -d SEC     spread of sprite start delays (default 10)\n"
+		"  -p DB      spread of sprite receive power below 0 dB (default 20)\n"
+		"  -c PPM     spread of sprite crystal errors, +/- (default 0)\n"
+		"  -r N       samples per chip (default 2)\n"
+		"  -S SEED    swarm seed (default 1)\n"
+		"  -o FILE    output cf32 I/Q file (default swarm.cf32)\n"
+		"  -l FILE    write a CSV manifest of the sprites\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	struct swarm w = { 0 };
+	unsigned int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char *out = "swarm.cf32", *manifest = NULL;
+	double spread = 10.0, power_spread = 20.0, clock_spread = 0.0;
+	double end = 0.0, virtual_time = 0.0;
+	double t0, t1, t2;
+	unsigned long seed = 1, rng;
+	unsigned int i;
+	FILE *f;
+	int opt;
+
+	w.nsprites = 100;
+	w.message = "KickSat";
+	w.osr = 2;
+	w.repeat = 1;
+	w.csk_sets = 1;
+
+	while ((opt = getopt(argc, argv, "n:j:m:kf:K:d:p:c:r:S:o:l:h")) != -1) {
+		switch (opt) {
+		case 'n': w.nsprites = strtoul(optarg, NULL, 0); break;
+		case 'j': nthreads = strtoul(optarg, NULL, 0); break;
+		case 'm': w.message = optarg; break;
+		case 'k': w.csk = 1; break;
+		case 'f': w.csk_sets = strtoul(optarg, NULL, 0); break;
+		case 'K': w.repeat = strtoul(optarg, NULL, 0); break;
+		case 'd': spread = strtod(optarg, NULL); break;
+		case 'p': power_spread = strtod(optarg, NULL); break;
+		case 'c': clock_spread = strtod(optarg, NULL); break;
+		case 'r': w.osr = strtoul(optarg, NULL, 0); break;
+		case 'S': seed = strtoul(optarg, NULL, 0); break;
+		case 'o': out = optarg; break;
+		case 'l': manifest = optarg; break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (w.nsprites == 0 || nthreads == 0 || w.osr == 0 || w.repeat == 0 ||
+	    w.repeat > SR_REPEAT_MAX || strlen(w.message) > 255 || w.csk_sets == 0 ||
+	    CONFIG_CSK_FIRST_CODE + w.csk_sets * CONFIG_CSK_CODES > 266) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	w.sprites = calloc(w.nsprites, sizeof(*w.sprites));
+	if (!w.sprites) {
+		fprintf(stderr, "cannot allocate %u sprites\n", w.nsprites);
+		return 1;
+	}
+	rng = seed;
+	for (i = 0; i < w.nsprites; i++) {
+		struct sprite *sp = &w.sprites[i];
+
+		sp->pair = i % NUM_PRN_PAIRS;
+		sp->csk_first = CONFIG_CSK_FIRST_CODE + i % w.csk_sets * CONFIG_CSK_CODES;
+		sp->seed = seed * 1000003UL + i;
+		sp->delay = spread * uniform(&rng);
+		sp->power_db = -power_spread * uniform(&rng);
+		sp->phase = TWO_PI * uniform(&rng);
+		// Drawn last and only if asked for, to keep the swarm of a seed
+		if (clock_spread > 0.0)
+			sp->clock = clock_spread * 1e-6 * (2.0 * uniform(&rng) - 1.0);
+	}
+
+	t0 = wall_clock();
+	nthreads = run_pool(nthreads, emulate_worker, &w);
+	t1 = wall_clock();
+
+	for (i = 0; i < w.nsprites; i++) {
+		struct sprite *sp = &w.sprites[i];
+
+		virtual_time += sp->duration;
+		if (sp->delay + sp->duration * (1.0 - sp->clock) > end)
+			end = sp->delay + sp->duration * (1.0 - sp->clock);
+		if (sp->nbursts && w.fs == 0.0)
+			w.fs = w.osr / sp->bursts[0].chip_time;
+	}
+	if (w.fs == 0.0) {
+		fprintf(stderr, "no sprite transmitted anything\n");
+		return 1;
+	}
+
+	w.nsamples = (unsigned long)ceil(end * w.fs);
+	w.samples = calloc(2 * w.nsamples, sizeof(float));
+	if (!w.samples) {
+		fprintf(stderr, "cannot allocate %lu samples\n", w.nsamples);
+		return 1;
+	}
+	nthreads = run_pool(nthreads, mix_worker, &w);
+	t2 = wall_clock();
+
+	f = fopen(out, "wb");
+	if (!f || fwrite(w.samples, 2 * sizeof(float), w.nsamples, f) != w.nsamples) {
+		perror(out);
+		return 1;
+	}
+	fclose(f);
+
+	if (manifest) {
+		f = fopen(manifest, "w");
+		if (!f) {
+			perror(manifest);
+			return 1;
+		}
+		// The first and last code of a CSK sprite, as sprite-decode prints them
+		fprintf(f, "sprite,prn0,prn1,seed,delay_s,power_db,phase_rad,clock_ppm,bursts\n");
+		for (i = 0; i < w.nsprites; i++) {
+			const struct sprite *sp = &w.sprites[i];
+
+			fprintf(f, "%u,%u,%u,%lu,%.9f,%.2f,%.4f,%.2f,%u\n", i,
+				w.csk ? sp->csk_first : PRN_PAIRS[sp->pair].index[0],
+				w.csk ? sp->csk_first + CONFIG_CSK_CODES - 1 :
+				        PRN_PAIRS[sp->pair].index[1],
+				sp->seed, sp->delay, sp->power_db, sp->phase, sp->clock * 1e6,
+				sp->nbursts);
+		}
+		fclose(f);
+	}
+
+	fprintf(stderr,
+		"%u sprites on %u threads: %.1f s of sprite time emulated in %.3f s (%.0fx real time)\n"
+		"mixed %.3f s of channel at %.0f S/s in %.3f s, wrote %s\n",
+		w.nsprites, nthreads, virtual_time, t1 - t0, virtual_time / (t1 - t0),
+		end, w.fs, t2 - t1, out);
+
+	for (i = 0; i < w.nsprites; i++) {
+		unsigned int b;
+
+		for (b = 0; b < w.sprites[i].nbursts; b++)
+			free(w.sprites[i].bursts[b].bytes);
+		free(w.sprites[i].bursts);
+	}
+	free(w.sprites);
+	free(w.samples);
+	return 0;
+}
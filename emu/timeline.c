@@ -0,0 +1,424 @@
+/*
+  timeline.c - Reconstruct the transmit timeline from an RF1A access trace.
+
+  Reads a trace written by an emulator tool (e.g. sprite-radio -t) and writes
+  it as Chrome trace event JSON, which chrome://tracing and Perfetto display
+  as three tracks: the driver's accesses to the radio core, the radio state
+  and the bytes on air. It also reports what costs transmit time:
+
+  - TX FIFO underruns: the firmware writes to the FIFO after the transmitter
+    ran dry, so the rest of the frame is lost
+  - idle gaps between symbols: the channel goes quiet within a frame
+  - spinning: runs of SNOP strobes polling the radio state, and
+    __delay_cycles() busy-waits
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "cc430f5137.h"
+#include "emu.h"
+
+#define GAP_TOLERANCE_NS 2   // Rounding of the recorded times
+
+static const char *STATE_NAME[EMU_RF_NSTATES] = {
+	[EMU_RF_SLEEP] = "SLEEP",
+	[EMU_RF_XOFF] = "XOFF",
+	[EMU_RF_IDLE] = "IDLE",
+	[EMU_RF_CALIBRATE] = "CALIBRATE",
+	[EMU_RF_SETTLING] = "SETTLING",
+	[EMU_RF_FSTXON] = "FSTXON",
+	[EMU_RF_TX] = "TX",
+	[EMU_RF_TXFIFO_UNDERFLOW] = "TX_UNDERFLOW",
+	[EMU_RF_RX] = "RX",
+	[EMU_RF_RXFIFO_OVERFLOW] = "RX_OVERFLOW",
+};
+
+static const char *STROBE_NAME[] = {
+	"SRES", "SFSTXON", "SXOFF", "SCAL", "SRX", "STX", "SIDLE", "SAFC",
+	"SWOR", "SPWD", "SFRX", "SFTX", "SWORRST", "SNOP",
+};
+
+static const char *REGISTER_NAME[0x3F] = {
+	"IOCFG2", "IOCFG1", "IOCFG0", "FIFOTHR", "SYNC1", "SYNC0", "PKTLEN", "PKTCTRL1",
+	"PKTCTRL0", "ADDR", "CHANNR", "FSCTRL1", "FSCTRL0", "FREQ2", "FREQ1", "FREQ0",
+	"MDMCFG4", "MDMCFG3", "MDMCFG2", "MDMCFG1", "MDMCFG0", "DEVIATN", "MCSM2", "MCSM1",
+	"MCSM0", "FOCCFG", "BSCFG", "AGCCTRL2", "AGCCTRL1", "AGCCTRL0", "WOREVT1", "WOREVT0",
+	"WORCTRL", "FREND1", "FREND0", "FSCAL3", "FSCAL2", "FSCAL1", "FSCAL0", "RCCTRL1",
+	"RCCTRL0", "FSTEST", "PTEST", "AGCTEST", "TEST2", "TEST1", "TEST0", NULL,
+	NULL, "VERSION", "FREQEST", "LQI", "RSSI", "MARCSTATE", "WORTIME1", "WORTIME0",
+	"PKTSTATUS", "VCO_VC_DAC", "TXBYTES", "RXBYTES", NULL, NULL, "PATABLE",
+};
+
+enum { TRACK_DRIVER = 1, TRACK_STATE, TRACK_AIR };
+
+struct record {
+	uint64_t t;             // ns
+	int type, arg, value, state;
+	uint32_t data;
+};
+
+struct timeline {
+	FILE *json;
+	int first_event;
+	unsigned int symbol_bytes;
+
+	// Radio state
+	int state;
+	uint64_t state_since;
+	uint64_t state_time[EMU_RF_NSTATES];
+
+	// Bytes on air
+	int in_burst;
+	uint64_t burst_start, air_end;
+	unsigned long burst_bytes, frame_bytes;
+	int frame_started;      // STX since the last byte on air
+	unsigned long bursts, air_bytes;
+	uint64_t air_time;
+
+	// Driver
+	uint64_t spin_start, spin_last;
+	unsigned long spin_polls;
+	uint64_t fifo_start, fifo_last;
+	unsigned long fifo_bytes;
+	int underrun_flagged;
+
+	// Findings
+	unsigned long underruns, gaps, spins, spin_polls_total, delays;
+	uint64_t gap_time, max_gap, spin_time, delay_time;
+	uint64_t first, last;
+};
+
+static int read_record(FILE *f, struct record *r)
+{
+	unsigned char b[EMU_RFTRACE_RECORD];
+	int i;
+
+	if (fread(b, sizeof(b), 1, f) != 1)
+		return 0;
+	r->t = 0;
+	for (i = 7; i >= 0; i--)
+		r->t = r->t << 8 | b[i];
+	r->type = b[8];
+	r->arg = b[9];
+	r->value = b[10];
+	r->state = b[11];
+	r->data = (uint32_t)b[12] | (uint32_t)b[13] << 8 | (uint32_t)b[14] << 16 | (uint32_t)b[15] << 24;
+	return 1;
+}
+
+static void begin_event(struct timeline *tl)
+{
+	fputs(tl->first_event ? "\n" : ",\n", tl->json);
+	tl->first_event = 0;
+}
+
+// A span on a track, with optional JSON args
+static void span(struct timeline *tl, int track, const char *name, uint64_t start,
+                 uint64_t end, const char *args)
+{
+	begin_event(tl);
+	fprintf(tl->json, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+	        "\"ts\":%.3f,\"dur\":%.3f%s%s%s}",
+	        name, track, start / 1e3, (end - start) / 1e3,
+	        args ? ",\"args\":{" : "", args ? args : "", args ? "}" : "");
+}
+
+static void instant(struct timeline *tl, int track, const char *name, uint64_t t,
+                    const char *args)
+{
+	begin_event(tl);
+	fprintf(tl->json, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,"
+	        "\"ts\":%.3f%s%s%s}",
+	        name, track, t / 1e3,
+	        args ? ",\"args\":{" : "", args ? args : "", args ? "}" : "");
+}
+
+static void track_name(struct timeline *tl, int track, const char *name)
+{
+	begin_event(tl);
+	fprintf(tl->json, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+	        "\"args\":{\"name\":\"%s\"}}", track, name);
+}
+
+static void end_spin(struct timeline *tl)
+{
+	char args[64];
+
+	if (tl->spin_polls == 0)
+		return;
+	if (tl->spin_polls == 1) {
+		instant(tl, TRACK_DRIVER, "SNOP", tl->spin_start, NULL);
+	} else {
+		// Charge the last poll like the average one
+		uint64_t end = tl->spin_last + (tl->spin_last - tl->spin_start) / (tl->spin_polls - 1);
+
+		snprintf(args, sizeof(args), "\"polls\":%lu", tl->spin_polls);
+		span(tl, TRACK_DRIVER, "spin SNOP", tl->spin_start, end, args);
+		tl->spins++;
+		tl->spin_polls_total += tl->spin_polls;
+		tl->spin_time += end - tl->spin_start;
+	}
+	tl->spin_polls = 0;
+}
+
+static void end_fifo(struct timeline *tl)
+{
+	char args[64];
+
+	if (tl->fifo_bytes == 0)
+		return;
+	snprintf(args, sizeof(args), "\"bytes\":%lu", tl->fifo_bytes);
+	span(tl, TRACK_DRIVER, "FIFO write", tl->fifo_start, tl->fifo_last, args);
+	tl->fifo_bytes = 0;
+}
+
+static void end_burst(struct timeline *tl)
+{
+	char args[64];
+
+	if (!tl->in_burst)
+		return;
+	snprintf(args, sizeof(args), "\"bytes\":%lu", tl->burst_bytes);
+	span(tl, TRACK_AIR, "on air", tl->burst_start, tl->air_end, args);
+	tl->bursts++;
+	tl->air_time += tl->air_end - tl->burst_start;
+	tl->in_burst = 0;
+}
+
+// Any driver access but a SNOP ends a polling loop
+static void driver_access(struct timeline *tl, const struct record *r)
+{
+	if (!(r->type == EMU_RFTRACE_STROBE && r->arg == RF_SNOP))
+		end_spin(tl);
+	if (r->type != EMU_RFTRACE_FIFO)
+		end_fifo(tl);
+}
+
+static void on_strobe(struct timeline *tl, const struct record *r)
+{
+	int index = r->arg - RF_SRES;
+	char args[64];
+
+	if (r->arg == RF_SNOP) {
+		if (tl->spin_polls == 0)
+			tl->spin_start = r->t;
+		tl->spin_last = r->t;
+		tl->spin_polls++;
+		return;
+	}
+	if (r->arg == RF_STX)
+		tl->frame_started = 1;
+	if (r->arg == RF_SIDLE || r->arg == RF_SFTX)
+		tl->underrun_flagged = 0;
+
+	snprintf(args, sizeof(args), "\"status\":\"0x%02X\"", r->value);
+	instant(tl, TRACK_DRIVER, index >= 0 && index < 14 ? STROBE_NAME[index] : "strobe",
+	        r->t, args);
+}
+
+static void on_register(struct timeline *tl, const struct record *r)
+{
+	const char *name = r->arg < 0x3F ? REGISTER_NAME[r->arg] : NULL;
+	char event[32], args[64];
+
+	snprintf(event, sizeof(event), "%s %s", r->type == EMU_RFTRACE_WRITE ? "write" : "read",
+	         name ? name : "?");
+	snprintf(args, sizeof(args), "\"address\":\"0x%02X\",\"value\":\"0x%02X\"",
+	         r->arg, r->value);
+	instant(tl, TRACK_DRIVER, event, r->t, args);
+}
+
+static void on_fifo(struct timeline *tl, const struct record *r)
+{
+	char args[96];
+
+	if (tl->state == EMU_RF_TXFIFO_UNDERFLOW && !tl->underrun_flagged) {
+		snprintf(args, sizeof(args), "\"frame_bytes\":%lu,\"late_us\":%.3f",
+		         tl->frame_bytes, (r->t - tl->state_since) / 1e3);
+		instant(tl, TRACK_AIR, "TX FIFO underrun", r->t, args);
+		printf("underrun at %.6f s: %lu bytes into the frame, FIFO refilled %.1f us late\n",
+		       r->t / 1e9, tl->frame_bytes, (r->t - tl->state_since) / 1e3);
+		tl->underruns++;
+		tl->underrun_flagged = 1;
+	}
+	if (tl->fifo_bytes == 0)
+		tl->fifo_start = r->t;
+	tl->fifo_last = r->t;
+	tl->fifo_bytes++;
+}
+
+static void on_state(struct timeline *tl, const struct record *r)
+{
+	if (r->arg >= EMU_RF_NSTATES)
+		return;
+	if (r->t > tl->state_since) {
+		span(tl, TRACK_STATE, STATE_NAME[tl->state], tl->state_since, r->t, NULL);
+		tl->state_time[tl->state] += r->t - tl->state_since;
+	}
+	tl->state = r->arg;
+	tl->state_since = r->t;
+}
+
+static void on_air(struct timeline *tl, const struct record *r)
+{
+	if (tl->in_burst && r->t > tl->air_end + GAP_TOLERANCE_NS) {
+		end_burst(tl);
+		// A gap without a new STX is the channel going quiet within a frame
+		if (!tl->frame_started) {
+			uint64_t gap = r->t - tl->air_end;
+			char args[64];
+
+			snprintf(args, sizeof(args), "\"symbol\":%lu", tl->frame_bytes / tl->symbol_bytes);
+			span(tl, TRACK_AIR, "idle gap", tl->air_end, r->t, args);
+			tl->gaps++;
+			tl->gap_time += gap;
+			if (gap > tl->max_gap)
+				tl->max_gap = gap;
+		}
+	}
+	if (tl->frame_started) {
+		tl->frame_bytes = 0;
+		tl->frame_started = 0;
+	}
+	if (!tl->in_burst) {
+		tl->in_burst = 1;
+		tl->burst_start = r->t;
+		tl->burst_bytes = 0;
+	}
+	tl->air_end = r->t + r->data;
+	tl->burst_bytes++;
+	tl->frame_bytes++;
+	tl->air_bytes++;
+}
+
+static void on_delay(struct timeline *tl, const struct record *r)
+{
+	char args[64];
+
+	snprintf(args, sizeof(args), "\"us\":%.3f", r->data / 1e3);
+	span(tl, TRACK_DRIVER, "delay", r->t, r->t + r->data, args);
+	tl->delays++;
+	tl->delay_time += r->data;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options] TRACE\n"
+		"  -o FILE    Chrome trace JSON output (default timeline.json)\n"
+		"  -s BYTES   symbol length in bytes, for locating gaps (default 64)\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	const char *output = "timeline.json";
+	struct timeline tl;
+	struct record r;
+	unsigned long records = 0;
+	char magic[8];
+	FILE *in;
+	int opt, i;
+
+	memset(&tl, 0, sizeof(tl));
+	tl.first_event = 1;
+	tl.symbol_bytes = 64;
+	tl.state = EMU_RF_IDLE;
+
+	while ((opt = getopt(argc, argv, "o:s:h")) != -1) {
+		switch (opt) {
+		case 'o': output = optarg; break;
+		case 's': tl.symbol_bytes = strtoul(optarg, NULL, 0); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (optind != argc - 1 || tl.symbol_bytes == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	in = fopen(argv[optind], "rb");
+	if (!in) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (fread(magic, sizeof(magic), 1, in) != 1 || memcmp(magic, EMU_RFTRACE_MAGIC, 8)) {
+		fprintf(stderr, "%s: not an RF1A trace\n", argv[optind]);
+		return 1;
+	}
+	tl.json = fopen(output, "w");
+	if (!tl.json) {
+		perror(output);
+		return 1;
+	}
+
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", tl.json);
+	track_name(&tl, TRACK_DRIVER, "driver");
+	track_name(&tl, TRACK_STATE, "radio state");
+	track_name(&tl, TRACK_AIR, "on air");
+
+	while (read_record(in, &r)) {
+		if (records++ == 0)
+			tl.first = r.t;
+		if (r.t > tl.last)
+			tl.last = r.t;
+
+		switch (r.type) {
+		case EMU_RFTRACE_STROBE:
+			driver_access(&tl, &r);
+			on_strobe(&tl, &r);
+			break;
+		case EMU_RFTRACE_WRITE:
+		case EMU_RFTRACE_READ:
+			driver_access(&tl, &r);
+			on_register(&tl, &r);
+			break;
+		case EMU_RFTRACE_FIFO:
+			driver_access(&tl, &r);
+			on_fifo(&tl, &r);
+			break;
+		case EMU_RFTRACE_DELAY:
+			driver_access(&tl, &r);
+			on_delay(&tl, &r);
+			break;
+		case EMU_RFTRACE_STATE:
+			on_state(&tl, &r);
+			break;
+		case EMU_RFTRACE_AIR:
+			on_air(&tl, &r);
+			break;
+		default:
+			break;
+		}
+	}
+	fclose(in);
+
+	end_spin(&tl);
+	end_fifo(&tl);
+	end_burst(&tl);
+	if (tl.last > tl.state_since) {
+		span(&tl, TRACK_STATE, STATE_NAME[tl.state], tl.state_since, tl.last, NULL);
+		tl.state_time[tl.state] += tl.last - tl.state_since;
+	}
+	fputs("\n]}\n", tl.json);
+	fclose(tl.json);
+
+	printf("%lu records over %.6f s, timeline written to %s\n",
+	       records, (tl.last - tl.first) / 1e9, output);
+	for (i = 0; i < EMU_RF_NSTATES; i++) {
+		if (tl.state_time[i])
+			printf("  %-13s %12.6f s\n", STATE_NAME[i], tl.state_time[i] / 1e9);
+	}
+	printf("on air: %lu bytes in %lu bursts, %.6f s\n",
+	       tl.air_bytes, tl.bursts, tl.air_time / 1e9);
+	printf("TX FIFO underruns: %lu\n", tl.underruns);
+	printf("idle gaps between symbols: %lu, %.1f us total, %.1f us max\n",
+	       tl.gaps, tl.gap_time / 1e3, tl.max_gap / 1e3);
+	printf("spinning: %lu SNOP polls in %lu loops, %.1f us; %lu delays, %.1f us\n",
+	       tl.spin_polls_total, tl.spins, tl.spin_time / 1e3, tl.delays, tl.delay_time / 1e3);
+	return 0;
+}
@@ -0,0 +1,224 @@
+/*
+  uplinkbench.c - Send commands to one emulated sprite listening with
+  wake-on-radio and measure what listening costs.
+
+  The ground sends command packets at random times (exponential gaps), each
+  with a preamble long enough to span a WOR period, some of them corrupted,
+  addressed to another sprite or repeated. The firmware sleeps in LPM3 with
+  the uplink started and takes commands from the queue as they arrive. The
+  bench reports the packets the radio caught or missed, what the firmware
+  rejected, the wake latency from the first preamble bit to the command
+  reaching the main loop, the receive duty cycle of the radio and its average
+  current, and the energy of the whole sprite.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "cc430f5137.h"
+#include "emu.h"
+#include "SpriteRadio.h"
+#include "uplink.h"
+#include "random.h"
+
+#define OTHER_SPRITE  0x02
+#define RSSI_STATUS   0x40
+
+struct command {
+	double start;           // First preamble bit of the first copy
+	double delivered;       // uplink_receive() returned it, or -1
+	int for_us;
+};
+
+static double uniform(unsigned long *ctx)
+{
+	return (random_r(ctx) + 1.0) / 2147483648.0;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -n N       commands sent (default 50)\n"
+		"  -i SEC     mean time between commands (default 10)\n"
+		"  -P MS      WOR period (default 1000)\n"
+		"  -d SHIFT   RX window of 12.5%% >> SHIFT of the period, 0 to 6 (default 3)\n"
+		"  -l MS      preamble length (default: the WOR period plus 10%%)\n"
+		"  -R N       copies of each command, same sequence number (default 1)\n"
+		"  -e FRAC    fraction of packets with a CRC error (default 0)\n"
+		"  -a FRAC    fraction of commands for another sprite (default 0)\n"
+		"  -S SEED    seed (default 1)\n"
+		"  -V VOLTS   supply voltage (default 3.0)\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int ncommands = 50, copies = 1, duty = 3, period_ms = 1000, i, j;
+	double interval = 10.0, preamble = -1.0, crc_errors = 0.0, foreign = 0.0;
+	double voltage = EMU_SUPPLY_VOLTAGE, t, end, bit, radio_charge = 0.0, on;
+	unsigned long seed = 1, delivered = 0, accepted = 0, caught = 0, missed;
+	double *latency, processing = 0.0;
+	struct command *commands;
+	struct emu_sprite s;
+	struct emu_rf1a *rf = &s.rf;
+	struct emu_energy energy;
+	const uplink_stats_t *stats;
+	uplink_command_t cmd;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:i:P:d:l:R:e:a:S:V:h")) != -1) {
+		switch (opt) {
+		case 'n': ncommands = strtoul(optarg, NULL, 0); break;
+		case 'i': interval = strtod(optarg, NULL); break;
+		case 'P': period_ms = strtoul(optarg, NULL, 0); break;
+		case 'd': duty = strtoul(optarg, NULL, 0); break;
+		case 'l': preamble = strtod(optarg, NULL) / 1e3; break;
+		case 'R': copies = strtoul(optarg, NULL, 0); break;
+		case 'e': crc_errors = strtod(optarg, NULL); break;
+		case 'a': foreign = strtod(optarg, NULL); break;
+		case 'S': seed = strtoul(optarg, NULL, 0); break;
+		case 'V': voltage = strtod(optarg, NULL); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (ncommands == 0 || copies == 0 || interval <= 0.0 || duty > UPLINK_DUTY_MAX ||
+	    period_ms == 0 || period_ms > 1890) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (preamble < 0.0)
+		preamble = 1.1e-3 * period_ms;
+
+	emu_sprite_init(&s, F_CPU);
+	emu_cur = &s;
+	s.gie = 1;
+
+	SpriteRadio_SpriteRadio();
+	SpriteRadio_txInit();
+	uplink_start(period_ms, duty);
+	bit = 1.0 / emu_rf1a_chip_rate(rf);
+
+	// Each packet: length, address, sequence, opcode and the command index
+	commands = calloc(ncommands, sizeof(*commands));
+	t = s.now;
+	for (i = 0; i < ncommands; i++) {
+		struct command *c = &commands[i];
+
+		t += -interval * log(uniform(&seed));
+		c->start = t;
+		c->delivered = -1.0;
+		c->for_us = uniform(&seed) >= foreign;
+		for (j = 0; j < copies; j++) {
+			struct emu_rx_packet p;
+
+			memset(&p, 0, sizeof(p));
+			p.start = t;
+			p.preamble = preamble;
+			p.length = 1 + UPLINK_HEADER_SIZE + 2;
+			p.bytes[0] = p.length - 1;
+			p.bytes[1] = c->for_us ? 0x01 : OTHER_SPRITE;
+			p.bytes[2] = i & 0xFF;
+			p.bytes[3] = 0x10;
+			p.bytes[4] = i & 0xFF;
+			p.bytes[5] = i >> 8;
+			p.crc_ok = uniform(&seed) >= crc_errors;
+			p.rssi = RSSI_STATUS;
+			emu_rf1a_inject(rf, &p);
+
+			// The next copy follows after a gap for the sprite to reply
+			t += preamble + (32 + 8 * p.length + 16) * bit + 0.1;
+		}
+	}
+	end = t + 2e-3 * period_ms;
+
+	// The main loop of uplink_wait(), up to the end of the test
+	keepTimeOnACLK(1);
+	while (s.now < end) {
+		if (uplink_receive(&cmd)) {
+			unsigned int index = cmd.args[0] | cmd.args[1] << 8;
+
+			accepted++;
+			if (index < ncommands && commands[index].delivered < 0.0) {
+				commands[index].delivered = s.now;
+				delivered++;
+			}
+			// The copy just received, by its command index
+			for (i = rf->nair; i-- > 0; ) {
+				const struct emu_rx_packet *p = &rf->air[i];
+
+				if ((p->bytes[4] | p->bytes[5] << 8) == index && p->received_at >= 0.0 &&
+				    p->received_at <= s.now) {
+					processing += s.now - p->received_at;
+					break;
+				}
+			}
+			continue;
+		}
+		emu_bis_sr(LPM3_bits | GIE);
+	}
+	keepTimeOnACLK(0);
+	emu_rf1a_account(rf, s.now);
+	stats = uplink_stats();
+
+	latency = calloc(ncommands, sizeof(*latency));
+	for (i = j = 0; i < ncommands; i++) {
+		if (commands[i].delivered >= 0.0)
+			latency[j++] = commands[i].delivered - commands[i].start;
+	}
+	qsort(latency, j, sizeof(*latency), compare_double);
+	for (i = 0; i < rf->nair; i++) {
+		if (rf->air[i].received_at >= 0.0)
+			caught++;
+	}
+
+	// A packet is filtered at most once, but stay clear of a wrap
+	missed = caught + rf->rx_filtered < rf->nair ? rf->nair - caught - rf->rx_filtered : 0;
+	printf("WOR period %u ms, RX window %.2f ms (%.2f%%), preamble %.1f ms, %.0f baud\n",
+	       period_ms, period_ms / 8.0 / (1u << duty), 12.5 / (1u << duty),
+	       preamble * 1e3, 1.0 / bit);
+	printf("%u commands, %u packets: %lu received, %lu missed, %lu filtered by address\n",
+	       ncommands, rf->nair, caught, missed, rf->rx_filtered);
+	printf("firmware: %u packets, %u accepted, %u CRC errors, %u malformed, "
+	       "%u duplicates, %u dropped\n",
+	       stats->packets, stats->accepted, stats->crc_errors, stats->malformed,
+	       stats->duplicates, stats->dropped);
+	if (j) {
+		double sum = 0.0;
+
+		for (i = 0; i < j; i++)
+			sum += latency[i];
+		printf("%lu commands delivered, wake latency mean %.1f ms, median %.1f ms, max %.1f ms\n"
+		       "end of packet to main loop %.1f us on average\n",
+		       delivered, sum / j * 1e3, latency[j / 2] * 1e3, latency[j - 1] * 1e3,
+		       processing / accepted * 1e6);
+	} else {
+		printf("no commands delivered\n");
+	}
+
+	for (i = 0; i < EMU_RF_NSTATES; i++)
+		radio_charge += rf->state_charge[i];
+	on = s.now - rf->state_time[EMU_RF_SLEEP] - rf->state_time[EMU_RF_XOFF];
+	printf("%lu WOR wake-ups, %lu calibrations, receive duty cycle %.3f%% (radio on %.3f%%)\n",
+	       rf->wor_events, rf->calibrations, 100.0 * rf->state_time[EMU_RF_RX] / s.now,
+	       100.0 * on / s.now);
+	printf("radio average %.1f uA over %.1f s\n\n", radio_charge / s.now * 1e6, s.now);
+
+	emu_energy(&s, voltage, &energy);
+	emu_energy_print(&energy, &s, 0);
+
+	free(latency);
+	free(commands);
+	emu_sprite_free(&s);
+	return 0;
+}
@@ -0,0 +1,227 @@
+/*
+  batch.c - Decode recordings on a thread pool.
+
+  Recordings are mapped read-only and split into chunks. Each chunk is
+  decoded with every channel as a separate task, over the chunk and an
+  overlap of the longest frame of the channel after it, so that a frame
+  starting in a chunk is decoded whole by that chunk alone. A chunk reports
+  only the frames that start inside it. A decoder entering a chunk in the
+  middle of a frame may still find a false one there, so the merge also
+  drops any frame starting within the previous frame of the same channel,
+  as a single pass through the recording would.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ground.h"
+
+int recording_open(struct recording *r, const char *path)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	memset(r, 0, sizeof(*r));
+	r->path = path;
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st)) {
+		close(fd);
+		return -1;
+	}
+	r->size = st.st_size;
+	r->nsamples = r->size / (2 * sizeof(float));
+	if (r->nsamples == 0) {
+		close(fd);
+		return 0;
+	}
+	map = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+	posix_madvise(map, r->size, POSIX_MADV_SEQUENTIAL);
+	r->iq = map;
+	return 0;
+}
+
+void recording_close(struct recording *r)
+{
+	if (r->iq)
+		munmap((void *)r->iq, r->size);
+	r->iq = NULL;
+}
+
+struct chunk {
+	unsigned int recording;
+	unsigned long start, length;
+};
+
+struct result {
+	struct ground_frame *frames;
+	unsigned long n, cap;
+	int failed;
+};
+
+struct batch {
+	const struct recording *recordings;
+	const struct channel *channels;
+	unsigned int nchannels;
+	struct chunk *chunks;
+	struct result *results;
+};
+
+static void collect(const struct ground_frame *frame, void *ctx)
+{
+	struct result *r = ctx;
+
+	if (r->n == r->cap) {
+		unsigned long cap = r->cap ? 2 * r->cap : 16;
+		struct ground_frame *frames = realloc(r->frames, cap * sizeof(*frames));
+
+		if (!frames) {
+			r->failed = 1;
+			return;
+		}
+		r->frames = frames;
+		r->cap = cap;
+	}
+	r->frames[r->n++] = *frame;
+}
+
+static void run_task(unsigned long task, unsigned int thread, void *ctx)
+{
+	struct batch *b = ctx;
+	const struct chunk *c = &b->chunks[task / b->nchannels];
+	const struct channel *ch = &b->channels[task % b->nchannels];
+	const struct recording *rec = &b->recordings[c->recording];
+	struct result *r = &b->results[task];
+	unsigned long n = c->length + channel_span(ch), i;
+	long frames;
+
+	if (c->start + n > rec->nsamples)
+		n = rec->nsamples - c->start;
+	if (ch->mode == FRAME_CSK)
+		frames = csk_decode(&ch->u.csk, rec->iq + 2 * c->start, n, c->length, collect, r);
+	else
+		frames = spread_decode(&ch->u.spread, rec->iq + 2 * c->start, n, c->length, collect, r);
+	if (frames < 0)
+		r->failed = 1;
+	for (i = 0; i < r->n; i++) {
+		r->frames[i].sample += c->start;
+		r->frames[i].end += c->start;
+		r->frames[i].source = c->recording;
+		r->frames[i].channel = task % b->nchannels;
+	}
+}
+
+static int compare_frames(const void *pa, const void *pb)
+{
+	const struct ground_frame *a = pa, *b = pb;
+
+	if (a->source != b->source)
+		return a->source < b->source ? -1 : 1;
+	if (a->sample != b->sample)
+		return a->sample < b->sample ? -1 : 1;
+	return a->channel < b->channel ? -1 : a->channel > b->channel;
+}
+
+double wall_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+long batch_decode(const struct recording *recordings, unsigned int nrecordings,
+                  const struct channel *channels, unsigned int nchannels,
+                  unsigned int nthreads, unsigned long chunk,
+                  struct ground_frame **frames, struct batch_stats *stats)
+{
+	struct batch b;
+	unsigned long nchunks = 0, ntasks, total = 0, i, j, k;
+	unsigned long *last_end;
+	struct ground_frame *out;
+	double t0 = wall_clock();
+	int failed = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	*frames = NULL;
+	if (chunk == 0 || nchannels == 0)
+		return -1;
+	for (i = 0; i < nrecordings; i++) {
+		nchunks += (recordings[i].nsamples + chunk - 1) / chunk;
+		stats->samples += recordings[i].nsamples;
+	}
+
+	b.recordings = recordings;
+	b.channels = channels;
+	b.nchannels = nchannels;
+	b.chunks = calloc(nchunks ? nchunks : 1, sizeof(*b.chunks));
+	ntasks = nchunks * nchannels;
+	b.results = calloc(ntasks ? ntasks : 1, sizeof(*b.results));
+	last_end = calloc(nchannels, sizeof(*last_end));
+	if (!b.chunks || !b.results || !last_end) {
+		free(b.chunks);
+		free(b.results);
+		free(last_end);
+		return -1;
+	}
+	for (i = k = 0; i < nrecordings; i++) {
+		for (j = 0; j < recordings[i].nsamples; j += chunk, k++) {
+			b.chunks[k].recording = i;
+			b.chunks[k].start = j;
+			b.chunks[k].length = recordings[i].nsamples - j < chunk ?
+			                     recordings[i].nsamples - j : chunk;
+		}
+	}
+
+	stats->chunks = nchunks;
+	stats->tasks = ntasks;
+	stats->steals = pool_run(nthreads, ntasks, run_task, &b);
+
+	for (i = 0; i < ntasks; i++) {
+		total += b.results[i].n;
+		failed |= b.results[i].failed;
+	}
+	out = malloc((total ? total : 1) * sizeof(*out));
+	if (out && !failed) {
+		for (i = total = 0; i < ntasks; i++) {
+			memcpy(out + total, b.results[i].frames, b.results[i].n * sizeof(*out));
+			total += b.results[i].n;
+		}
+		qsort(out, total, sizeof(*out), compare_frames);
+
+		for (i = j = 0; i < total; i++) {
+			if (i == 0 || out[i].source != out[i - 1].source)
+				memset(last_end, 0, nchannels * sizeof(*last_end));
+			if (out[i].sample < last_end[out[i].channel]) {
+				stats->duplicates++;
+				continue;
+			}
+			last_end[out[i].channel] = out[i].end;
+			out[j++] = out[i];
+		}
+		total = j;
+	}
+
+	for (i = 0; i < ntasks; i++)
+		free(b.results[i].frames);
+	free(b.results);
+	free(b.chunks);
+	free(last_end);
+	stats->seconds = wall_clock() - t0;
+	if (!out || failed) {
+		free(out);
+		return -1;
+	}
+	*frames = out;
+	return total;
+}
@@ -0,0 +1,311 @@
+/*
+  ber.c - Bit and frame error rates of the frames of SpriteRadio_transmitByte()
+  over a sweep of Eb/N0, through the channel simulator and the ground
+  decoder, as CSV.
+
+  Every frame carries a random byte and starts at a random fraction of a
+  sample within the first symbol of the samples, with a random carrier
+  phase, the carrier offset and clock error asked for, and interferers on
+  the other PRN pairs of prn.c anywhere across it. The decoder searches
+  that first symbol for it. Eb is the energy of the whole frame, preamble
+  and postamble included, over its 8 data bits. With -K the frames, and
+  those of the interferers, are sent that many times back to back, as by
+  SpriteRadio_setRepeat(), and combined by the decoder: Eb is still that
+  of one copy, so the copies cost 10 log10 K dB more energy than the curve
+  shows.
+
+  The frames of each point are run in batches on the thread pool, each
+  batch from its own seed, so the curves do not depend on the threads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "ground.h"
+
+#define BATCH 64
+#define TWO_PI (2.0 * 3.14159265358979323846)
+
+struct result {
+	unsigned long frames;
+	unsigned long missed;       // Not found
+	unsigned long wrong;        // Found with the wrong byte
+	unsigned long bit_errors;   // In the bytes of the frames found
+	unsigned long raw_errors;   // In their codewords, before the FEC
+	double sim_seconds, decode_seconds;
+};
+
+struct scratch {
+	float *iq, *mix, *sums;
+	float chips[2][SPREAD_MAX_REPEATS * SIM_FRAME_CHIPS];
+};
+
+struct sweep {
+	struct spread_decoder decoder;
+	uint8_t code[2][GOLD_CHIPS];
+	uint8_t interferer_code[NUM_PRN_PAIRS][2][GOLD_CHIPS];
+	unsigned int ninterferer_codes;
+	unsigned int osr, interferers, repeats;
+	double from, step, fs, doppler, clock, interferer_power;
+	unsigned long frames, batches, nsamples;
+	uint64_t seed;
+	struct scratch *scratch;
+	struct result *results;     // Per batch
+};
+
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static double uniform(uint64_t *x)
+{
+	return (splitmix64(x) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// A frame and its copies
+static void copies(const uint8_t code[2][GOLD_CHIPS], uint8_t data, unsigned int repeats,
+                   float *chips)
+{
+	unsigned int r;
+
+	sim_frame(code, data, chips);
+	for (r = 1; r < repeats; r++)
+		memcpy(chips + r * SIM_FRAME_CHIPS, chips, SIM_FRAME_CHIPS * sizeof(*chips));
+}
+
+static void first_frame(const struct ground_frame *frame, void *ctx)
+{
+	struct ground_frame *found = ctx;
+
+	if (found->length == 0)
+		*found = *frame;
+}
+
+static void run_batch(unsigned long task, unsigned int thread, void *ctx)
+{
+	struct sweep *w = ctx;
+	struct scratch *sc = &w->scratch[thread];
+	struct result *r = &w->results[task];
+	unsigned long point = task / w->batches, batch = task % w->batches, f;
+	unsigned long symbol_samples = (unsigned long)GOLD_CHIPS * w->osr;
+	double ebn0 = w->from + point * w->step;
+	double variance = (double)SIM_FRAME_CHIPS * w->osr / (8.0 * pow(10.0, ebn0 / 10.0));
+	uint64_t x = w->seed ^ (task * 0xD1B54A32D192ED03ull);
+	struct sim_rng rng;
+
+	sim_seed(&rng, splitmix64(&x));
+	memset(r, 0, sizeof(*r));
+	for (f = batch * BATCH; f < w->frames && f < (batch + 1) * BATCH; f++) {
+		struct sim_signal s;
+		struct ground_frame found;
+		uint8_t data = splitmix64(&x);
+		unsigned int k;
+		double t0 = wall_clock(), t1;
+
+		memset(sc->iq, 0, 2 * w->nsamples * sizeof(float));
+		copies(w->code, data, w->repeats, sc->chips[0]);
+		s.chips = sc->chips[0];
+		s.nchips = w->repeats * SIM_FRAME_CHIPS;
+		s.start = uniform(&x) * symbol_samples;
+		s.clock = w->clock * 1e-6;
+		s.amplitude = 1.0f;
+		s.phase = TWO_PI * uniform(&x);
+		s.doppler = w->doppler / w->fs;
+		sim_add(sc->iq, w->nsamples, w->osr, &s, sc->mix);
+
+		for (k = 0; k < w->interferers; k++) {
+			struct sim_signal in = s;
+
+			copies(w->interferer_code[k % w->ninterferer_codes], splitmix64(&x), w->repeats,
+			       sc->chips[1]);
+			in.chips = sc->chips[1];
+			in.start = (uniform(&x) - 0.5) * in.nchips * w->osr;
+			in.amplitude = pow(10.0, w->interferer_power / 20.0);
+			in.phase = TWO_PI * uniform(&x);
+			if (uniform(&x) < 0.5) {
+				in.clock = -in.clock;
+				in.doppler = -in.doppler;
+			}
+			sim_add(sc->iq, w->nsamples, w->osr, &in, sc->mix);
+		}
+		sim_noise(&rng, sc->iq, w->nsamples, variance);
+		t1 = wall_clock();
+
+		sum_chips(sc->iq, w->nsamples, w->osr, sc->sums);
+		memset(&found, 0, sizeof(found));
+		spread_decode_chips(&w->decoder, sc->sums, w->nsamples - (w->osr - 1), 0,
+		                    symbol_samples + w->osr, NULL, NULL, first_frame, &found);
+		r->sim_seconds += t1 - t0;
+		r->decode_seconds += wall_clock() - t1;
+
+		r->frames++;
+		if (found.length == 0) {
+			r->missed++;
+			continue;
+		}
+		r->wrong += found.bytes[0] != data;
+		r->bit_errors += __builtin_popcount(found.bytes[0] ^ data);
+		r->raw_errors += __builtin_popcount(found.hard ^ (fec_parity(data) << 8 | data));
+	}
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -e A,B,S   Eb/N0 from A to B dB in steps of S (default 12,24,1)\n"
+		"  -n N       frames per point (default 1000)\n"
+		"  -p P0,P1   PRN pair of the sprite (default 2,3)\n"
+		"  -r N       samples per chip (default 2)\n"
+		"  -R RATE    chip rate (default 64072)\n"
+		"  -D HZ      carrier frequency offset left after Doppler correction\n"
+		"  -c PPM     chip clock error of the sprite\n"
+		"  -I N       interferers on the other PRN pairs of prn.c (default 0)\n"
+		"  -P DB      power of the interferers relative to the sprite (default 0)\n"
+		"  -K N       send every frame N times and combine the copies (default 1)\n"
+		"  -t FRAC    sync detection threshold, 0 to 1 (default 0.02)\n"
+		"  -T         do not track the chip timing\n"
+		"  -j N       worker threads (default: all cores)\n"
+		"  -S SEED    seed (default 1)\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static struct sweep w;
+	unsigned int prn0 = 2, prn1 = 3, nthreads = sysconf(_SC_NPROCESSORS_ONLN), i;
+	unsigned long npoints, p, b, steals, samples;
+	double to = 24.0, rate = 64072.0, threshold = -1.0, seconds, sim = 0.0, dec = 0.0;
+	int track = 1, opt;
+
+	w.from = 12.0;
+	w.step = 1.0;
+	w.frames = 1000;
+	w.osr = 2;
+	w.seed = 1;
+	w.repeats = 1;
+	while ((opt = getopt(argc, argv, "e:n:p:r:R:D:c:I:P:K:t:Tj:S:h")) != -1) {
+		switch (opt) {
+		case 'e':
+			if (sscanf(optarg, "%lf,%lf,%lf", &w.from, &to, &w.step) != 3) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'n': w.frames = strtoul(optarg, NULL, 0); break;
+		case 'p':
+			if (sscanf(optarg, "%u,%u", &prn0, &prn1) != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'r': w.osr = strtoul(optarg, NULL, 0); break;
+		case 'R': rate = strtod(optarg, NULL); break;
+		case 'D': w.doppler = strtod(optarg, NULL); break;
+		case 'c': w.clock = strtod(optarg, NULL); break;
+		case 'I': w.interferers = strtoul(optarg, NULL, 0); break;
+		case 'P': w.interferer_power = strtod(optarg, NULL); break;
+		case 'K': w.repeats = strtoul(optarg, NULL, 0); break;
+		case 't': threshold = strtod(optarg, NULL); break;
+		case 'T': track = 0; break;
+		case 'j': nthreads = strtoul(optarg, NULL, 0); break;
+		case 'S': w.seed = strtoull(optarg, NULL, 0); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (optind != argc || w.step <= 0.0 || to < w.from || w.frames == 0 || rate <= 0.0 ||
+	    nthreads == 0 || w.repeats == 0 || w.repeats > SPREAD_MAX_REPEATS ||
+	    spread_init(&w.decoder, prn0, prn1, w.osr)) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (threshold >= 0.0)
+		w.decoder.threshold = threshold;
+	w.decoder.track = track;
+	w.decoder.repeats = w.repeats;
+	gold_code(prn0, w.code[0]);
+	gold_code(prn1, w.code[1]);
+	for (i = 0; i < NUM_PRN_PAIRS; i++) {
+		if (PRN_PAIRS[i][0] == prn0 && PRN_PAIRS[i][1] == prn1)
+			continue;
+		gold_code(PRN_PAIRS[i][0], w.interferer_code[w.ninterferer_codes][0]);
+		gold_code(PRN_PAIRS[i][1], w.interferer_code[w.ninterferer_codes][1]);
+		w.ninterferer_codes++;
+	}
+
+	// A symbol to start in, the copies, and room for the clock error
+	w.fs = rate * w.osr;
+	w.nsamples = (unsigned long)GOLD_CHIPS * w.osr * (SPREAD_SYMBOLS * w.repeats + 2);
+	npoints = (unsigned long)((to - w.from) / w.step + 1e-9) + 1;
+	w.batches = (w.frames + BATCH - 1) / BATCH;
+	w.results = calloc(npoints * w.batches, sizeof(*w.results));
+	w.scratch = calloc(nthreads, sizeof(*w.scratch));
+	if (!w.results || !w.scratch) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < nthreads; i++) {
+		w.scratch[i].iq = sim_alloc(w.nsamples);
+		w.scratch[i].mix = sim_alloc(w.nsamples);
+		w.scratch[i].sums = sim_alloc(w.nsamples);
+		if (!w.scratch[i].iq || !w.scratch[i].mix || !w.scratch[i].sums) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+	}
+
+	seconds = wall_clock();
+	steals = pool_run(nthreads, npoints * w.batches, run_batch, &w);
+	seconds = wall_clock() - seconds;
+
+	printf("ebn0_db,snr_db,frames,missed,wrong,fer,ber,raw_ber\n");
+	for (p = 0; p < npoints; p++) {
+		struct result t = { 0 };
+		double ebn0 = w.from + p * w.step;
+		unsigned long found;
+
+		for (b = 0; b < w.batches; b++) {
+			const struct result *r = &w.results[p * w.batches + b];
+
+			t.frames += r->frames;
+			t.missed += r->missed;
+			t.wrong += r->wrong;
+			t.bit_errors += r->bit_errors;
+			t.raw_errors += r->raw_errors;
+			sim += r->sim_seconds;
+			dec += r->decode_seconds;
+		}
+		found = t.frames - t.missed;
+		printf("%.2f,%.2f,%lu,%lu,%lu,%.6g,%.6g,%.6g\n", ebn0,
+		       ebn0 + 10.0 * log10(8.0 / ((double)SIM_FRAME_CHIPS * w.osr)),
+		       t.frames, t.missed, t.wrong, (double)(t.missed + t.wrong) / t.frames,
+		       found ? t.bit_errors / (8.0 * found) : 0.0,
+		       found ? t.raw_errors / (16.0 * found) : 0.0);
+	}
+
+	samples = npoints * w.frames * w.nsamples;
+	fprintf(stderr,
+		"%lu frames at %lu points on %u threads (%lu steals) in %.3f s: %.0f frames/s, "
+		"%.2f MS/s\n"
+		"per thread: simulation %.2f MS/s, decoding %.2f MS/s\n",
+		npoints * w.frames, npoints, nthreads, steals, seconds,
+		npoints * w.frames / seconds, samples / seconds / 1e6,
+		samples / sim / 1e6, samples / dec / 1e6);
+
+	for (i = 0; i < nthreads; i++) {
+		free(w.scratch[i].iq);
+		free(w.scratch[i].mix);
+		free(w.scratch[i].sums);
+	}
+	free(w.scratch);
+	free(w.results);
+	return 0;
+}
@@ -0,0 +1,115 @@
+/*
+  channel.c - The decoders of the command line tools, and their output.
+*/
+
+#include <stdio.h>
+#include <ctype.h>
+
+#include "ground.h"
+
+const unsigned int PRN_PAIRS[NUM_PRN_PAIRS][2] = {
+	{ 2, 3 },
+	{ 266, 267 },
+	{ 268, 269 },
+};
+
+int channels_setup(struct channel channels[MAX_CHANNELS], unsigned int mode,
+                   const unsigned int pairs[][2], unsigned int npairs,
+                   const unsigned int firsts[], unsigned int nfirsts, unsigned int ncodes,
+                   unsigned int osr, float threshold)
+{
+	static const unsigned int default_first = CSK_FIRST_CODE;
+	unsigned int i;
+
+	if (mode == FRAME_CSK) {
+		if (nfirsts == 0) {
+			firsts = &default_first;
+			nfirsts = 1;
+		}
+		if (nfirsts > MAX_CHANNELS)
+			return -1;
+		for (i = 0; i < nfirsts; i++) {
+			channels[i].mode = FRAME_CSK;
+			if (csk_init(&channels[i].u.csk, firsts[i], ncodes, osr))
+				return -1;
+			if (threshold >= 0.0f)
+				channels[i].u.csk.threshold = threshold;
+		}
+		return nfirsts;
+	}
+
+	if (npairs == 0) {
+		pairs = PRN_PAIRS;
+		npairs = NUM_PRN_PAIRS;
+	}
+	if (npairs > MAX_CHANNELS)
+		return -1;
+	for (i = 0; i < npairs; i++) {
+		channels[i].mode = FRAME_SPREAD;
+		if (spread_init(&channels[i].u.spread, pairs[i][0], pairs[i][1], osr))
+			return -1;
+		if (threshold >= 0.0f)
+			channels[i].u.spread.threshold = threshold;
+	}
+	return npairs;
+}
+
+unsigned int channel_osr(const struct channel *c)
+{
+	return c->mode == FRAME_CSK ? c->u.csk.osr : c->u.spread.osr;
+}
+
+unsigned long channel_span(const struct channel *c)
+{
+	return c->mode == FRAME_CSK ? csk_span(&c->u.csk) : spread_span(&c->u.spread);
+}
+
+unsigned long channel_lookahead(const struct channel *c)
+{
+	return c->mode == FRAME_CSK ? csk_lookahead(&c->u.csk) : spread_lookahead(&c->u.spread);
+}
+
+long channel_decode_chips(const struct channel *c, const float *iq, unsigned long nsamples,
+                          unsigned long start, unsigned long limit, unsigned long *resume,
+                          struct spread_timing *timing, frame_fn fn, void *ctx)
+{
+	if (c->mode == FRAME_CSK)
+		return csk_decode_chips(&c->u.csk, iq, nsamples, start, limit, resume, fn, ctx);
+	return spread_decode_chips(&c->u.spread, iq, nsamples, start, limit, resume, timing,
+	                           fn, ctx);
+}
+
+void print_bytes(const uint8_t *bytes, unsigned int length)
+{
+	unsigned int i;
+
+	putchar('"');
+	for (i = 0; i < length; i++) {
+		uint8_t c = bytes[i];
+
+		if (isprint(c) && c != '"' && c != '\\')
+			putchar(c);
+		else
+			printf("\\x%02x", c);
+	}
+	putchar('"');
+}
+
+void print_frame(const struct ground_frame *frame, double fs, const char *columns)
+{
+	if (columns)
+		printf("%s ", columns);
+	printf("%12.6f %3u/%-3u %3u %5.3f %6.1f %3u %3u ", frame->sample / fs, frame->prn0,
+	       frame->prn1, frame->length, frame->quality, frame->clock, frame->corrected,
+	       frame->bad);
+	print_bytes(frame->bytes, frame->length);
+	putchar('\n');
+}
+
+void print_heading(const char *columns)
+{
+	if (columns)
+		printf("%s ", columns);
+	printf("%12s %-7s %3s %5s %6s %3s %3s %s\n", "time (s)", "PRNs", "len", "sync", "ppm",
+	       "fix", "bad", "bytes");
+}
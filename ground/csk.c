@@ -0,0 +1,170 @@
+/*
+  csk.c - Decoder of the M-ary code shift keying frames.
+
+  The samples of each chip are summed first, a matched filter for the
+  rectangular chips. A frame is found by correlating every sample offset
+  with the first sync code, normalized by the energy of the window, and
+  confirmed by the other sync symbols. Its symbols are then taken
+  noncoherently from the correlator bank, every GOLD_CHIPS chips, and the FEC
+  codewords of the length and the bytes unpacked from them.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ground.h"
+
+int csk_init(struct csk_decoder *d, unsigned int first, unsigned int ncodes,
+             unsigned int osr)
+{
+	if ((ncodes != 16 && ncodes != 64) || first + ncodes > GOLD_PERIOD || osr == 0)
+		return -1;
+	memset(d, 0, sizeof(*d));
+	d->first = first;
+	gold_bank_init(&d->bank, first, ncodes);
+	d->bits = ncodes == 16 ? 4 : 6;
+	d->osr = osr;
+	d->threshold = 0.02f;
+
+	d->sync_symbols[0] = 0;
+	d->sync_symbols[1] = ncodes - 1;
+	d->sync_symbols[2] = 1;
+	d->sync_symbols[3] = ncodes - 2;
+	gold_code_float(first + d->sync_symbols[0], d->sync);
+	return 0;
+}
+
+static unsigned int symbol(const struct csk_decoder *d, const float *iq)
+{
+	float power[GOLD_MAX_BANK];
+	unsigned int k, best = 0;
+
+	gold_bank_correlate(&d->bank, iq, d->osr, power);
+	for (k = 1; k < d->bank.ncodes; k++) {
+		if (power[k] > power[best])
+			best = k;
+	}
+	return best;
+}
+
+struct unpacker {
+	const struct csk_decoder *d;
+	const float *iq;            // Next symbol
+	unsigned long acc;
+	unsigned int nbits;
+};
+
+static uint16_t next_codeword(struct unpacker *u)
+{
+	unsigned long stride = 2ul * GOLD_CHIPS * u->d->osr;
+
+	while (u->nbits < 16) {
+		u->acc = (u->acc << u->d->bits) | symbol(u->d, u->iq);
+		u->nbits += u->d->bits;
+		u->iq += stride;
+	}
+	u->nbits -= 16;
+	return (u->acc >> u->nbits) & 0xFFFF;
+}
+
+static unsigned long symbols(const struct csk_decoder *d, unsigned int length)
+{
+	return CSK_SYNC_SYMBOLS + (16ul * (1 + length) + d->bits - 1) / d->bits;
+}
+
+unsigned long csk_span(const struct csk_decoder *d)
+{
+	return symbols(d, FRAME_MAX_LENGTH) * GOLD_CHIPS * d->osr + d->osr;
+}
+
+unsigned long csk_lookahead(const struct csk_decoder *d)
+{
+	return symbols(d, 0) * GOLD_CHIPS * d->osr;
+}
+
+long csk_decode_chips(const struct csk_decoder *d, const float *iq,
+                      unsigned long nsamples, unsigned long start, unsigned long limit,
+                      unsigned long *resume, frame_fn fn, void *ctx)
+{
+	unsigned long symbol_samples = (unsigned long)GOLD_CHIPS * d->osr;
+	unsigned long t = start;
+	long frames = 0;
+	struct ground_frame frame;
+
+	while (t < limit && t + symbols(d, 0) * symbol_samples <= nsamples) {
+		struct unpacker u;
+		unsigned int i, errors;
+		uint8_t length;
+		float q = sync_correlation(iq + 2 * t, d->osr, d->sync), next;
+
+		if (q < d->threshold) {
+			t++;
+			continue;
+		}
+		// Climb to the peak, within the chip
+		while (t + symbols(d, 0) * symbol_samples < nsamples &&
+		       (next = sync_correlation(iq + 2 * (t + 1), d->osr, d->sync)) > q) {
+			q = next;
+			t++;
+		}
+		if (t >= limit)
+			break;
+		for (i = 1; i < CSK_SYNC_SYMBOLS; i++) {
+			if (symbol(d, iq + 2 * (t + i * symbol_samples)) != d->sync_symbols[i])
+				break;
+		}
+		if (i < CSK_SYNC_SYMBOLS) {
+			t++;
+			continue;
+		}
+
+		memset(&frame, 0, sizeof(frame));
+		frame.sample = t;
+		frame.mode = FRAME_CSK;
+		frame.prn0 = d->first;
+		frame.prn1 = d->first + d->bank.ncodes - 1;
+		frame.quality = q;
+		u.d = d;
+		u.iq = iq + 2 * (t + CSK_SYNC_SYMBOLS * symbol_samples);
+		u.acc = 0;
+		u.nbits = 0;
+
+		errors = fec_decode(next_codeword(&u), &length);
+		if (errors > FEC_CORRECTABLE) {
+			t++;
+			continue;
+		}
+		if (t + symbols(d, length) * symbol_samples > nsamples)
+			break;  // Not received whole yet
+		frame.corrected = errors;
+		frame.length = length;
+		for (i = 0; i < length; i++) {
+			errors = fec_decode(next_codeword(&u), &frame.bytes[i]);
+			if (errors > FEC_CORRECTABLE)
+				frame.bad++;
+			else
+				frame.corrected += errors;
+		}
+		t += symbols(d, length) * symbol_samples;
+		frame.end = t;
+		fn(&frame, ctx);
+		frames++;
+	}
+	if (resume)
+		*resume = t;
+	return frames;
+}
+
+long csk_decode(const struct csk_decoder *d, const float *samples,
+                unsigned long nsamples, unsigned long limit, frame_fn fn, void *ctx)
+{
+	float *iq = chip_sums(samples, nsamples, d->osr);
+	long frames;
+
+	if (!iq)
+		return -1;
+	nsamples = nsamples < d->osr ? 0 : nsamples - (d->osr - 1);
+	frames = csk_decode_chips(d, iq, nsamples, 0, limit, NULL, fn, ctx);
+	free(iq);
+	return frames;
+}
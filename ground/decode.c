@@ -0,0 +1,146 @@
+/*
+  decode.c - Decode the frames of cf32 recordings, e.g. from sprite-swarm,
+  and print them in time order with the time of their first chip, their
+  sync quality and FEC corrections.
+
+  Recordings are memory-mapped and decoded in overlapping chunks on a
+  work-stealing thread pool, one task per chunk and PRN pair (or CSK code
+  set), and the frames merged without the duplicates of chunk boundaries.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ground.h"
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options] FILE...\n"
+		"  -M MODE    frames to decode (default spread):\n"
+		"               spread    SpriteRadio_transmitByte()\n"
+		"               csk       SpriteRadio_setMode(SR_MODE_CSK)\n"
+		"  -p P0,P1   PRN pair in spread mode, repeatable (default: those of prn.c)\n"
+		"  -c N       CSK codes, 16 or 64 (default 16)\n"
+		"  -f FIRST   first Gold code of a CSK code set, repeatable (default 4)\n"
+		"  -r N       samples per chip (default 2)\n"
+		"  -R RATE    chip rate, for the time of the frames (default 64072)\n"
+		"  -t FRAC    sync detection threshold, 0 to 1 (default 0.02)\n"
+		"  -T         do not track the chip timing of spread frames\n"
+		"  -K N       combine the N copies of each spread frame sent with\n"
+		"             SpriteRadio_setRepeat()\n"
+		"  -j N       worker threads (default: all cores)\n"
+		"  -C N       samples per chunk (default: 1M, at least 8 frames)\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static struct channel channels[MAX_CHANNELS];
+	unsigned int pairs[MAX_CHANNELS][2], npairs = 0, i;
+	unsigned int firsts[MAX_CHANNELS], nfirsts = 0;
+	unsigned int ncodes = 16, osr = 2, repeats = 1, nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int nrecordings;
+	const char *mode = "spread";
+	double rate = 64072.0, threshold = -1.0;
+	unsigned long chunk = 0, span, bytes = 0, bad = 0;
+	struct recording *recordings;
+	struct ground_frame *frames;
+	struct batch_stats stats;
+	long nframes, f;
+	int nchannels, track = 1, opt;
+
+	while ((opt = getopt(argc, argv, "M:p:c:f:r:R:t:TK:j:C:h")) != -1) {
+		switch (opt) {
+		case 'M': mode = optarg; break;
+		case 'p':
+			if (npairs == MAX_CHANNELS ||
+			    sscanf(optarg, "%u,%u", &pairs[npairs][0], &pairs[npairs][1]) != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+			npairs++;
+			break;
+		case 'c': ncodes = strtoul(optarg, NULL, 0); break;
+		case 'f':
+			if (nfirsts == MAX_CHANNELS) {
+				usage(argv[0]);
+				return 1;
+			}
+			firsts[nfirsts++] = strtoul(optarg, NULL, 0);
+			break;
+		case 'r': osr = strtoul(optarg, NULL, 0); break;
+		case 'R': rate = strtod(optarg, NULL); break;
+		case 't': threshold = strtod(optarg, NULL); break;
+		case 'T': track = 0; break;
+		case 'K': repeats = strtoul(optarg, NULL, 0); break;
+		case 'j': nthreads = strtoul(optarg, NULL, 0); break;
+		case 'C': chunk = strtoul(optarg, NULL, 0); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (optind == argc || rate <= 0.0 || nthreads == 0 || repeats == 0 ||
+	    repeats > SPREAD_MAX_REPEATS ||
+	    (strcmp(mode, "spread") && strcmp(mode, "csk"))) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	nchannels = channels_setup(channels, strcmp(mode, "csk") ? FRAME_SPREAD : FRAME_CSK,
+	                           pairs, npairs, firsts, nfirsts, ncodes, osr, threshold);
+	if (nchannels < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	for (i = 0, span = 0; i < (unsigned int)nchannels; i++) {
+		if (channels[i].mode == FRAME_SPREAD) {
+			channels[i].u.spread.track = track;
+			channels[i].u.spread.repeats = repeats;
+		}
+		if (channel_span(&channels[i]) > span)
+			span = channel_span(&channels[i]);
+	}
+	if (chunk == 0)
+		chunk = 8 * span > (1ul << 20) ? 8 * span : 1ul << 20;
+
+	nrecordings = argc - optind;
+	recordings = calloc(nrecordings, sizeof(*recordings));
+	for (i = 0; i < nrecordings; i++) {
+		if (recording_open(&recordings[i], argv[optind + i])) {
+			perror(argv[optind + i]);
+			return 1;
+		}
+	}
+
+	nframes = batch_decode(recordings, nrecordings, channels, nchannels, nthreads, chunk,
+	                       &frames, &stats);
+	if (nframes < 0) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	print_heading(nrecordings > 1 ? "file" : NULL);
+	for (f = 0; f < nframes; f++) {
+		print_frame(&frames[f], rate * osr,
+		            nrecordings > 1 ? recordings[frames[f].source].path : NULL);
+		bytes += frames[f].length;
+		bad += frames[f].bad;
+	}
+
+	fprintf(stderr,
+		"%ld frames, %lu bytes (%lu bad codewords) in %lu samples of %u recordings\n"
+		"%lu chunks x %u channels on %u threads: %lu steals, %lu duplicates dropped\n"
+		"decoded in %.3f s: %.2f MS/s, %.2f MS/s per channel\n",
+		nframes, bytes, bad, stats.samples, nrecordings, stats.chunks, nchannels,
+		nthreads, stats.steals, stats.duplicates, stats.seconds,
+		stats.samples / stats.seconds / 1e6,
+		stats.samples * (double)nchannels / stats.seconds / 1e6);
+
+	free(frames);
+	for (i = 0; i < nrecordings; i++)
+		recording_close(&recordings[i]);
+	free(recordings);
+	return 0;
+}
@@ -0,0 +1,63 @@
+/*
+  fec.c - The (16,8,5) block code of SpriteRadio_fecEncode().
+*/
+
+#include <math.h>
+
+#include "ground.h"
+
+#define BIT(x, n) (((x) >> (n)) & 1)
+
+uint8_t fec_parity(uint8_t d)
+{
+	uint8_t p = 0;
+
+	p |= (BIT(d, 7) ^ BIT(d, 5) ^ BIT(d, 2) ^ BIT(d, 0)) << 7;
+	p |= (BIT(d, 6) ^ BIT(d, 5) ^ BIT(d, 4) ^ BIT(d, 2) ^ BIT(d, 1) ^ BIT(d, 0)) << 6;
+	p |= (BIT(d, 4) ^ BIT(d, 3) ^ BIT(d, 2) ^ BIT(d, 1)) << 5;
+	p |= (BIT(d, 7) ^ BIT(d, 3) ^ BIT(d, 2) ^ BIT(d, 1) ^ BIT(d, 0)) << 4;
+	p |= (BIT(d, 7) ^ BIT(d, 6) ^ BIT(d, 5) ^ BIT(d, 1)) << 3;
+	p |= (BIT(d, 7) ^ BIT(d, 6) ^ BIT(d, 5) ^ BIT(d, 4) ^ BIT(d, 0)) << 2;
+	p |= (BIT(d, 7) ^ BIT(d, 6) ^ BIT(d, 4) ^ BIT(d, 3) ^ BIT(d, 2) ^ BIT(d, 0)) << 1;
+	p |= BIT(d, 5) ^ BIT(d, 4) ^ BIT(d, 3) ^ BIT(d, 0);
+	return p;
+}
+
+// Maximum likelihood over the 256 codewords
+unsigned int fec_decode(uint16_t codeword, uint8_t *data)
+{
+	unsigned int best = 17, d;
+
+	for (d = 0; d < 256; d++) {
+		unsigned int errors = __builtin_popcount(codeword ^ (fec_parity(d) << 8 | d));
+
+		if (errors < best) {
+			best = errors;
+			*data = d;
+		}
+	}
+	return best;
+}
+
+// Maximum correlation of the metrics with the codewords as +1/-1
+unsigned int fec_decode_soft(const float metric[16], uint8_t *data)
+{
+	float best = -INFINITY;
+	unsigned int d, i, errors = 0;
+
+	for (d = 0; d < 256; d++) {
+		uint16_t codeword = fec_parity(d) << 8 | d;
+		float sum = 0.0f;
+
+		for (i = 0; i < 16; i++)
+			sum += (codeword >> (15 - i)) & 1 ? metric[i] : -metric[i];
+		if (sum > best) {
+			best = sum;
+			*data = d;
+		}
+	}
+	d = fec_parity(*data) << 8 | *data;
+	for (i = 0; i < 16; i++)
+		errors += (metric[i] > 0.0f) != ((d >> (15 - i)) & 1);
+	return errors;
+}
@@ -0,0 +1,168 @@
+/*
+  feed.c - Play a cf32 recording in real time, standing in for an SDR: to
+  standard output, or to sprite-live over UDP or TCP on the loopback
+  interface, in blocks paced by the sample rate.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "ground.h"
+
+#define UDP_MAX_SAMPLES 8000    // As in live.c
+
+static int connect_socket(int type, unsigned int port)
+{
+	struct sockaddr_in addr;
+	int fd;
+
+	fd = socket(AF_INET, type, 0);
+	if (fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int write_all(int fd, const void *data, size_t size)
+{
+	const char *p = data;
+
+	while (size) {
+		ssize_t r = write(fd, p, size);
+
+		if (r <= 0)
+			return -1;
+		p += r;
+		size -= r;
+	}
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options] FILE [DEST]\n"
+		"  DEST       - for standard output (default), or udp:PORT or tcp:PORT\n"
+		"             on the loopback interface\n"
+		"  -r N       samples per chip (default 2)\n"
+		"  -R RATE    chip rate (default 64072)\n"
+		"  -x SPEED   times real time, 0 for as fast as possible (default 1)\n"
+		"  -b N       samples per block (default 1024)\n"
+		"  -l FRAC    drop this fraction of the UDP datagrams\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int osr = 2, port = 0;
+	unsigned long block = 1024, sent = 0, lost = 0;
+	double rate = 64072.0, speed = 1.0, loss = 0.0;
+	const char *dest = "-";
+	struct recording rec;
+	struct timespec t0;
+	int udp = 0, fd = 1, opt;
+	unsigned char *buf;
+
+	while ((opt = getopt(argc, argv, "r:R:x:b:l:h")) != -1) {
+		switch (opt) {
+		case 'r': osr = strtoul(optarg, NULL, 0); break;
+		case 'R': rate = strtod(optarg, NULL); break;
+		case 'x': speed = strtod(optarg, NULL); break;
+		case 'b': block = strtoul(optarg, NULL, 0); break;
+		case 'l': loss = strtod(optarg, NULL); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (argc - optind == 2)
+		dest = argv[optind + 1];
+	if (argc - optind < 1 || argc - optind > 2 || osr == 0 || rate <= 0.0 || speed < 0.0 ||
+	    block == 0 || block > UDP_MAX_SAMPLES) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (recording_open(&rec, argv[optind])) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (sscanf(dest, "udp:%u", &port) == 1) {
+		udp = 1;
+		fd = connect_socket(SOCK_DGRAM, port);
+	} else if (sscanf(dest, "tcp:%u", &port) == 1) {
+		fd = connect_socket(SOCK_STREAM, port);
+	} else if (strcmp(dest, "-")) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (fd < 0) {
+		perror(dest);
+		return 1;
+	}
+	buf = malloc(sizeof(uint64_t) + block * 2 * sizeof(float));
+	if (!buf) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while (sent < rec.nsamples) {
+		unsigned long n = rec.nsamples - sent < block ? rec.nsamples - sent : block;
+		size_t size = n * 2 * sizeof(float);
+		uint64_t first = sent;
+		int failed;
+
+		if (speed > 0.0) {
+			double at = sent / (rate * osr * speed);
+			struct timespec ts = t0;
+
+			ts.tv_sec += (time_t)at;
+			ts.tv_nsec += (long)((at - (time_t)at) * 1e9);
+			if (ts.tv_nsec >= 1000000000L) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		}
+		if (udp) {
+			memcpy(buf, &first, sizeof(first));
+			memcpy(buf + sizeof(first), rec.iq + 2 * sent, size);
+			if (rand() < loss * RAND_MAX) {
+				lost++;
+				failed = 0;
+			} else {
+				failed = send(fd, buf, sizeof(first) + size, 0) < 0;
+			}
+		} else {
+			failed = write_all(fd, rec.iq + 2 * sent, size);
+		}
+		if (failed) {
+			perror(dest);
+			return 1;
+		}
+		sent += n;
+	}
+	if (udp) {
+		uint64_t end = sent;
+
+		send(fd, &end, sizeof(end), 0);
+	}
+
+	fprintf(stderr, "%lu samples sent, %lu datagrams dropped\n", sent, lost);
+	free(buf);
+	recording_close(&rec);
+	if (fd > 1)
+		close(fd);
+	return 0;
+}
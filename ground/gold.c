@@ -0,0 +1,193 @@
+/*
+  gold.c - Gold codes of the sprites and correlators for them.
+
+  The codes of src/prn.c are the sum of the m-sequences of x^9+x^5+1 (a) and
+  x^9+x^6+x^5+x^3+1 (b), b shifted by the code index, both registers
+  starting from 101010101, followed by a 0 chip.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ground.h"
+
+#define GOLD_DEGREE 9
+#define GOLD_SEED   0x155       // 101010101
+
+static void msequence(unsigned int taps, uint8_t seq[GOLD_PERIOD])
+{
+	unsigned int n, j;
+
+	for (n = 0; n < GOLD_DEGREE; n++)
+		seq[n] = (GOLD_SEED >> n) & 1;
+	for (; n < GOLD_PERIOD; n++) {
+		seq[n] = 0;
+		for (j = 1; j <= GOLD_DEGREE; j++) {
+			if (taps & (1u << j))
+				seq[n] ^= seq[n - j];
+		}
+	}
+}
+
+#define TAPS_A ((1u << 5) | (1u << 9))
+#define TAPS_B ((1u << 3) | (1u << 5) | (1u << 6) | (1u << 9))
+
+void gold_code(unsigned int index, uint8_t chips[GOLD_CHIPS])
+{
+	uint8_t a[GOLD_PERIOD], b[GOLD_PERIOD];
+	unsigned int n;
+
+	msequence(TAPS_A, a);
+	msequence(TAPS_B, b);
+	for (n = 0; n < GOLD_PERIOD; n++)
+		chips[n] = a[n] ^ b[(n + index) % GOLD_PERIOD];
+	chips[GOLD_PERIOD] = 0;
+}
+
+void gold_code_float(unsigned int index, float code[GOLD_PERIOD])
+{
+	uint8_t chips[GOLD_CHIPS];
+	unsigned int n;
+
+	gold_code(index, chips);
+	for (n = 0; n < GOLD_PERIOD; n++)
+		code[n] = chips[n] ? 1.0f : -1.0f;
+}
+
+void sum_chips(const float *samples, unsigned long nsamples, unsigned int osr, float *iq)
+{
+	unsigned long n;
+	unsigned int j;
+
+	if (nsamples < osr)
+		return;
+	for (n = 0; n < nsamples - (osr - 1); n++) {
+		float i = 0.0f, q = 0.0f;
+
+		for (j = 0; j < osr; j++) {
+			i += samples[2 * (n + j)];
+			q += samples[2 * (n + j) + 1];
+		}
+		iq[2 * n] = i;
+		iq[2 * n + 1] = q;
+	}
+}
+
+float *chip_sums(const float *samples, unsigned long nsamples, unsigned int osr)
+{
+	float *iq;
+
+	if (nsamples < osr)
+		return malloc(1);
+	iq = malloc(2 * (nsamples - (osr - 1)) * sizeof(float));
+	if (iq)
+		sum_chips(samples, nsamples, osr, iq);
+	return iq;
+}
+
+void correlate(const float *iq, unsigned int stride, const float code[GOLD_PERIOD],
+               float *ci, float *cq)
+{
+	float i = 0.0f, q = 0.0f;
+	unsigned int n;
+
+	for (n = 0; n < GOLD_PERIOD; n++) {
+		const float *s = iq + 2 * (unsigned long)n * stride;
+
+		i += s[0] * code[n];
+		q += s[1] * code[n];
+	}
+	*ci = i;
+	*cq = q;
+}
+
+float sync_correlation(const float *iq, unsigned int stride, const float code[GOLD_PERIOD])
+{
+	float ci = 0.0f, cq = 0.0f, energy = 0.0f;
+	unsigned int n;
+
+	for (n = 0; n < GOLD_PERIOD; n++) {
+		const float *s = iq + 2 * (unsigned long)n * stride;
+
+		ci += s[0] * code[n];
+		cq += s[1] * code[n];
+		energy += s[0] * s[0] + s[1] * s[1];
+	}
+	if (energy == 0.0f)
+		return 0.0f;
+	return (ci * ci + cq * cq) / (energy * GOLD_PERIOD);
+}
+
+// The state of the b register at chip n is the window b[n..n+8], and every
+// shift of b is a linear function of it: b[n + k] = parity(walsh_k & state_n).
+// The state runs through every nonzero 9-bit value once per period.
+void gold_bank_init(struct gold_bank *bank, unsigned int first, unsigned int ncodes)
+{
+	uint8_t a[GOLD_PERIOD], b[GOLD_PERIOD];
+	unsigned int at[GOLD_DEGREE], n, j, k;
+
+	msequence(TAPS_A, a);
+	msequence(TAPS_B, b);
+	memset(bank, 0, sizeof(*bank));
+	bank->ncodes = ncodes > GOLD_MAX_BANK ? GOLD_MAX_BANK : ncodes;
+
+	for (n = 0; n < GOLD_PERIOD; n++) {
+		uint16_t state = 0;
+
+		for (j = 0; j < GOLD_DEGREE; j++)
+			state |= b[(n + j) % GOLD_PERIOD] << j;
+		bank->state[n] = state;
+		bank->a[n] = a[n] ? 1.0f : -1.0f;
+		for (j = 0; j < GOLD_DEGREE; j++) {
+			if (state == 1u << j)
+				at[j] = n;
+		}
+	}
+	for (k = 0; k < bank->ncodes; k++) {
+		for (j = 0; j < GOLD_DEGREE; j++)
+			bank->walsh[k] |= b[(at[j] + first + k) % GOLD_PERIOD] << j;
+	}
+}
+
+// In place, on interleaved complex values
+static void fwht(float *x, unsigned int n)
+{
+	unsigned int h, i, j;
+
+	for (h = 1; h < n; h <<= 1) {
+		for (i = 0; i < n; i += 2 * h) {
+			for (j = i; j < i + h; j++) {
+				float ui = x[2 * j], uq = x[2 * j + 1];
+				float vi = x[2 * (j + h)], vq = x[2 * (j + h) + 1];
+
+				x[2 * j] = ui + vi;
+				x[2 * j + 1] = uq + vq;
+				x[2 * (j + h)] = ui - vi;
+				x[2 * (j + h) + 1] = uq - vq;
+			}
+		}
+	}
+}
+
+// A chip of 1 is sent as +1, so each term is +1 for a matching chip
+void gold_bank_correlate(const struct gold_bank *bank, const float *iq,
+                         unsigned int stride, float *power)
+{
+	float x[2 * GOLD_CHIPS];
+	unsigned int n, k;
+
+	x[0] = x[1] = 0.0f;
+	for (n = 0; n < GOLD_PERIOD; n++) {
+		const float *s = iq + 2 * (unsigned long)n * stride;
+		uint16_t state = bank->state[n];
+
+		x[2 * state] = s[0] * bank->a[n];
+		x[2 * state + 1] = s[1] * bank->a[n];
+	}
+	fwht(x, GOLD_CHIPS);
+	for (k = 0; k < bank->ncodes; k++) {
+		const float *c = x + 2 * bank->walsh[k];
+
+		power[k] = c[0] * c[0] + c[1] * c[1];
+	}
+}
@@ -0,0 +1,446 @@
+/*
+  ground.h - Ground station receiver for sprite transmissions.
+
+  Gold code generation and correlation, decoding of the (16,8,5) FEC code
+  and frame decoders, working on baseband recordings of interleaved float32
+  I/Q samples (cf32) at a whole number of samples per chip, such as those
+  written by sprite-swarm.
+*/
+
+#ifndef GROUND_H
+#define GROUND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GOLD_CHIPS    512       // Chips per PRN code as sent
+#define GOLD_PERIOD   511       // Period of the Gold code, the last chip is 0
+#define GOLD_MAX_BANK 64
+
+// Chips (0 or 1) of the Gold code of the given index, as in src/prn.c
+void gold_code(unsigned int index, uint8_t chips[GOLD_CHIPS]);
+
+// Chips of the Gold code of the given index as +1 (chip 1) and -1
+void gold_code_float(unsigned int index, float code[GOLD_PERIOD]);
+
+// Correlator bank for consecutive codes of the family. Every code is the
+// m-sequence a plus a shift of the m-sequence b, so once a is stripped from
+// the chips the correlations with every code are one 512-point Walsh-Hadamard
+// transform of the chips reordered by the state of the b register, instead
+// of one dot product per code.
+struct gold_bank {
+	unsigned int ncodes;
+	uint16_t state[GOLD_PERIOD];    // State of the b register at each chip
+	float a[GOLD_PERIOD];           // Chips of a as +1/-1
+	uint16_t walsh[GOLD_MAX_BANK];  // Walsh function of each code
+};
+
+void gold_bank_init(struct gold_bank *bank, unsigned int first, unsigned int ncodes);
+
+// Noncoherent correlation of GOLD_PERIOD chips, one every stride complex
+// samples of iq, with every code of the bank: |correlation|^2 per code
+void gold_bank_correlate(const struct gold_bank *bank, const float *iq,
+                         unsigned int stride, float *power);
+
+// Sum of each run of osr samples, the matched filter of rectangular chips:
+// nsamples - osr + 1 complex values, allocated with malloc()
+float *chip_sums(const float *samples, unsigned long nsamples, unsigned int osr);
+
+// The same into iq, of room for nsamples - osr + 1 complex values
+void sum_chips(const float *samples, unsigned long nsamples, unsigned int osr, float *iq);
+
+// Noncoherent correlation of GOLD_PERIOD chips, one every stride complex
+// samples, with code, over the energy of the window: the fraction of the
+// energy that is the code, about 1/GOLD_PERIOD for noise
+float sync_correlation(const float *iq, unsigned int stride, const float code[GOLD_PERIOD]);
+
+// Complex correlation of GOLD_PERIOD chips with code
+void correlate(const float *iq, unsigned int stride, const float code[GOLD_PERIOD],
+               float *ci, float *cq);
+
+// Parity byte of SpriteRadio_fecEncode()
+uint8_t fec_parity(uint8_t data);
+
+// Nearest data byte to a received codeword (parity << 8 | data), returning
+// the number of bits in error. Up to 2 are corrected reliably.
+unsigned int fec_decode(uint16_t codeword, uint8_t *data);
+
+// Soft decision: the data byte whose codeword best matches the metrics of
+// its 16 bits, MSB of the parity first, positive for a 1. Returns the number
+// of metrics whose sign disagrees with the codeword.
+unsigned int fec_decode_soft(const float metric[16], uint8_t *data);
+
+#define FEC_CORRECTABLE 2
+
+// A frame decoded from a recording
+#define FRAME_SPREAD 0
+#define FRAME_CSK    1
+#define FRAME_MAX_LENGTH 255
+
+struct ground_frame {
+	unsigned long sample;       // First sample of the frame in the recording
+	unsigned long end;          // Sample after the frame
+	unsigned int source;        // Recording, set by batch_decode()
+	unsigned int channel;       // Decoder, set by batch_decode()
+	unsigned int mode;
+	unsigned int prn0, prn1;    // PRN pair, or first and last CSK code
+	unsigned int length;
+	uint8_t bytes[FRAME_MAX_LENGTH];
+	unsigned int corrected;     // Bits corrected by the FEC
+	unsigned int bad;           // Codewords beyond FEC_CORRECTABLE
+	float quality;              // Normalized sync correlation
+	float clock;                // Chip clock error tracked, ppm fast
+	uint16_t hard;              // Bits of a spread frame's codeword before the FEC
+};
+
+typedef void (*frame_fn)(const struct ground_frame *frame, void *ctx);
+
+// Decoder of the frames of SpriteRadio_transmitByte(): the preamble 1110010,
+// the parity and data bytes and the postamble 1011000, one bit per code of a
+// PRN pair, found by the first code of the preamble. The chip timing is
+// tracked through each frame with an early-late loop.
+//
+// With repeats, the copies of each frame sent back to back by
+// SpriteRadio_setRepeat() are combined: their sync correlations are averaged
+// to find them, under the clock error of the sprite that best lines them up,
+// and their soft metrics summed before the FEC.
+#define SPREAD_SYMBOLS 30
+#define SPREAD_MAX_REPEATS 8    // SR_REPEAT_MAX
+
+struct spread_decoder {
+	unsigned int prn0, prn1;
+	unsigned int osr;           // Samples per chip
+	float threshold;            // Of the normalized sync correlation, 0 to 1
+	int track;                  // Track the chip timing, on by default
+	unsigned int repeats;       // Copies of each frame, 1 by default
+	float max_clock;            // Clock error searched with repeats, ppm (default 100)
+	float code[2][GOLD_PERIOD];
+};
+
+// Chip timing of the last frame decoded, carried to the next: its drift
+// seeds the loop, and once two frames have come a period apart the next is
+// looked for where it is due at half the threshold. Zero to start with.
+struct spread_timing {
+	double start;               // Of the last frame, in the chip sums decoded
+	double period;              // Since the frame before
+	double drift;               // Samples per symbol beyond GOLD_CHIPS * osr
+	int locked;                 // The last frame came a period after the one before
+};
+
+int spread_init(struct spread_decoder *d, unsigned int prn0, unsigned int prn1,
+                unsigned int osr);
+
+// Decode the frames starting before sample limit of nsamples complex
+// samples, in time order, returning the number of frames or -1 if out of
+// memory
+long spread_decode(const struct spread_decoder *d, const float *samples,
+                   unsigned long nsamples, unsigned long limit, frame_fn fn, void *ctx);
+
+// As spread_decode() on nsamples chip sums, from sample start. A frame not
+// received whole stops the search; the sample it stopped at, limit or past
+// it, is stored in resume if not NULL. The timing is carried in timing if
+// not NULL. Nothing is allocated.
+long spread_decode_chips(const struct spread_decoder *d, const float *iq,
+                         unsigned long nsamples, unsigned long start, unsigned long limit,
+                         unsigned long *resume, struct spread_timing *timing,
+                         frame_fn fn, void *ctx);
+
+// Decoder of the CSK frames of SpriteRadio_setMode(SR_MODE_CSK). The copies
+// of SpriteRadio_setRepeat() are decoded one by one, as separate frames.
+#define CSK_FIRST_CODE  4       // Default of CONFIG_CSK_FIRST_CODE in src/csk.h
+#define CSK_SYNC_SYMBOLS 4
+
+struct csk_decoder {
+	struct gold_bank bank;
+	unsigned int first;         // Gold code index of symbol 0
+	unsigned int bits;          // Bits per symbol
+	unsigned int osr;           // Samples per chip
+	float threshold;            // Of the normalized sync correlation, 0 to 1
+	float sync[GOLD_PERIOD];    // First sync code as +1/-1
+	unsigned int sync_symbols[CSK_SYNC_SYMBOLS];
+};
+
+// The code set of a sprite: first and ncodes, 16 or 64, as
+// CONFIG_CSK_FIRST_CODE and CONFIG_CSK_CODES of its firmware
+int csk_init(struct csk_decoder *d, unsigned int first, unsigned int ncodes,
+             unsigned int osr);
+
+// As spread_decode()
+long csk_decode(const struct csk_decoder *d, const float *samples,
+                unsigned long nsamples, unsigned long limit, frame_fn fn, void *ctx);
+long csk_decode_chips(const struct csk_decoder *d, const float *iq,
+                      unsigned long nsamples, unsigned long start, unsigned long limit,
+                      unsigned long *resume, frame_fn fn, void *ctx);
+
+// Samples spanned by the longest frame
+unsigned long spread_span(const struct spread_decoder *d);
+unsigned long csk_span(const struct csk_decoder *d);
+
+// Chip sums past the start of a frame needed to find it and its end
+unsigned long spread_lookahead(const struct spread_decoder *d);
+unsigned long csk_lookahead(const struct csk_decoder *d);
+
+// A cf32 recording mapped into memory
+struct recording {
+	const char *path;
+	const float *iq;
+	unsigned long nsamples;
+	size_t size;
+};
+
+int recording_open(struct recording *r, const char *path);
+void recording_close(struct recording *r);
+
+// Run ntasks tasks on nthreads threads. Each thread starts with a run of
+// consecutive tasks and takes them in order; once out of work it steals the
+// far half of the run of another thread. Returns the number of steals.
+typedef void (*pool_fn)(unsigned long task, unsigned int thread, void *ctx);
+
+unsigned long pool_run(unsigned int nthreads, unsigned long ntasks, pool_fn fn, void *ctx);
+
+// One decoder of a batch or stream
+struct channel {
+	unsigned int mode;
+	union {
+		struct spread_decoder spread;
+		struct csk_decoder csk;
+	} u;
+};
+
+#define MAX_CHANNELS 16
+
+// PRN pairs of src/prn.c
+#define NUM_PRN_PAIRS 3
+extern const unsigned int PRN_PAIRS[NUM_PRN_PAIRS][2];
+
+// Set up the channels of the command line tools: one per PRN pair in spread
+// mode, the pairs of src/prn.c if npairs is 0, or one per CSK code set of
+// ncodes from each first code, from CSK_FIRST_CODE if nfirsts is 0. A
+// negative threshold keeps that of the decoders. Returns the number of
+// channels or -1 if the options are invalid.
+int channels_setup(struct channel channels[MAX_CHANNELS], unsigned int mode,
+                   const unsigned int pairs[][2], unsigned int npairs,
+                   const unsigned int firsts[], unsigned int nfirsts, unsigned int ncodes,
+                   unsigned int osr, float threshold);
+
+unsigned int channel_osr(const struct channel *c);
+unsigned long channel_span(const struct channel *c);
+unsigned long channel_lookahead(const struct channel *c);
+long channel_decode_chips(const struct channel *c, const float *iq, unsigned long nsamples,
+                          unsigned long start, unsigned long limit, unsigned long *resume,
+                          struct spread_timing *timing, frame_fn fn, void *ctx);
+
+// One line of the frame tables of the tools, at sample rate fs, after the
+// given columns if not NULL; and its heading
+void print_frame(const struct ground_frame *frame, double fs, const char *columns);
+void print_heading(const char *columns);
+
+// Bytes in double quotes, those not printable and '"' and '\\' as \xHH
+void print_bytes(const uint8_t *bytes, unsigned int length);
+
+// Seconds of CLOCK_MONOTONIC
+double wall_clock(void);
+
+struct batch_stats {
+	unsigned long samples;      // In all recordings
+	unsigned long chunks;
+	unsigned long tasks;        // Chunks times channels
+	unsigned long steals;
+	unsigned long duplicates;   // Frames dropped at chunk boundaries
+	double seconds;
+};
+
+// Decode every recording with every channel, in overlapping chunks of
+// chunk samples on nthreads threads. The frames are returned sorted by
+// recording, sample and channel, without duplicates, in an array allocated
+// with malloc(). Returns the number of frames or -1 if out of memory.
+long batch_decode(const struct recording *recordings, unsigned int nrecordings,
+                  const struct channel *channels, unsigned int nchannels,
+                  unsigned int nthreads, unsigned long chunk,
+                  struct ground_frame **frames, struct batch_stats *stats);
+
+// Channel simulator of the BER harness: frames of SpriteRadio_transmitByte()
+// with a carrier offset, chip timing offset and clock error, mixed with
+// other signals and white noise. Sample buffers come from sim_alloc(),
+// aligned and padded to whole vectors of SIM_VECTOR floats.
+#define SIM_VECTOR 8
+#define SIM_ALIGN  32
+#define SIM_FRAME_CHIPS (SPREAD_SYMBOLS * GOLD_CHIPS)
+
+typedef uint32_t sim_lanes __attribute__((vector_size(SIM_VECTOR * sizeof(uint32_t))));
+
+struct sim_rng {
+	sim_lanes x, y, z, w;
+};
+
+struct sim_signal {
+	const float *chips;         // +1 for a chip 1, -1 for a 0
+	unsigned long nchips;
+	double start;               // Sample of the start of the first chip
+	double clock;               // Chip clock error, fast if positive
+	float amplitude;
+	double phase;               // Of the carrier at sample 0, radians
+	double doppler;             // Carrier offset, cycles per sample
+};
+
+// Chips of SpriteRadio_transmitByte(data) with the codes of a PRN pair
+void sim_frame(const uint8_t code[2][GOLD_CHIPS], uint8_t data, float chips[SIM_FRAME_CHIPS]);
+
+// Zeroed samples, or NULL if out of memory; free() them
+float *sim_alloc(unsigned long nsamples);
+
+void sim_seed(struct sim_rng *r, uint64_t seed);
+
+// Add a signal at osr samples per chip, with scratch from sim_alloc() of
+// nsamples samples
+void sim_add(float *iq, unsigned long nsamples, unsigned int osr, const struct sim_signal *s,
+             float *scratch);
+
+// Add complex white noise of the given variance per sample
+void sim_noise(struct sim_rng *r, float *iq, unsigned long nsamples, float variance);
+
+// Decoding of samples as they arrive, from a pipe or socket. The chip sums
+// go into a buffer allocated once, of the longest frame of the channels
+// twice and a block. After each block every channel searches as far as the
+// lookahead of its decoder has arrived, so a frame is reported as soon as
+// its last symbol has been received. The buffer is shifted down to the
+// earliest sample a channel will resume from only once full.
+#define STREAM_MAX_OSR 16
+#define STREAM_ARRIVALS 256     // Blocks whose arrival time is kept
+
+// Frames with the seconds since the arrival of their last sample
+typedef void (*stream_fn)(const struct ground_frame *frame, double latency, void *ctx);
+
+struct stream {
+	const struct channel *channels;
+	unsigned int nchannels, osr;
+	float *iq;                  // Chip sums from sample base
+	unsigned long cap, n, base;
+	float raw[2 * STREAM_MAX_OSR];  // Samples not summed yet
+	unsigned int nraw;
+	unsigned long received;     // Samples received or dropped
+	unsigned long resume[MAX_CHANNELS];
+	struct spread_timing timing[MAX_CHANNELS];
+	struct {
+		unsigned long end;      // Sample after the block
+		double time;
+	} arrivals[STREAM_ARRIVALS];
+	unsigned int arrival;       // Next slot
+	stream_fn fn;
+	void *ctx;
+	unsigned long frames;
+	unsigned long dropped;      // Samples lost before they arrived
+	float *latency;             // Of the first maxlatency frames
+	unsigned long nlatency, maxlatency;
+};
+
+// block is the most samples passed to stream_push() at once. Returns -1 if
+// out of memory or the channels have different or too many samples per chip.
+int stream_init(struct stream *s, const struct channel *channels, unsigned int nchannels,
+                unsigned long block, unsigned long maxlatency, stream_fn fn, void *ctx);
+
+// Samples that arrived at wall_clock() time arrival
+void stream_push(struct stream *s, const float *samples, unsigned long nsamples,
+                 double arrival);
+
+// Samples lost before the next ones, e.g. a missing datagram
+void stream_gap(struct stream *s, unsigned long nsamples);
+
+// Decode the frames left at the end of the stream
+void stream_finish(struct stream *s);
+
+// Percentile p (0 to 100) of the latency of the frames in seconds
+double stream_latency(struct stream *s, double p);
+
+void stream_free(struct stream *s);
+
+// Frames of a mission from every ground station, indexed by sprite and time.
+// Frames are appended as they are ingested, then store_index() sorts them by
+// sprite, time and station, and the frames of a sprite in a time range are
+// found by binary search. Receptions of the same sprite less than a window
+// apart are one frame, received by several stations or twice by one, and
+// are merged byte by byte.
+#define STORE_MAX_STATIONS 32
+#define STORE_STATION_NAME 32
+
+// Votes of a reception in a merge
+#define STORE_MAJORITY   0      // One
+#define STORE_CONFIDENCE 1      // Its sync quality over 1 + its bad codewords
+
+// Sprite of a PRN pair, or of the first and last CSK code
+#define STORE_SPRITE(prn0, prn1) ((uint32_t)(prn0) << 16 | (uint32_t)(prn1))
+
+struct store_frame {
+	int64_t time;               // Of the first chip, microseconds since the epoch
+	uint32_t sprite;
+	uint32_t bytes;             // Offset of its bytes in the arena
+	float quality;              // Normalized sync correlation
+	uint16_t station;
+	uint16_t length;
+	uint16_t corrected, bad;    // As in ground_frame
+};
+
+struct store_sprite {
+	uint32_t sprite;
+	unsigned long first, count; // Its frames, once indexed
+};
+
+struct store {
+	struct store_frame *frames;
+	unsigned long nframes, maxframes;
+	uint8_t *bytes;             // Arena of the bytes of the frames
+	unsigned long nbytes, maxbytes;
+	char stations[STORE_MAX_STATIONS][STORE_STATION_NAME];
+	unsigned int nstations;
+	struct store_sprite *sprites;
+	unsigned int nsprites;
+	int indexed;                // Sorted since the last frame was added
+};
+
+// A frame merged from its receptions
+struct store_merged {
+	int64_t time;               // Of the earliest reception
+	uint32_t sprite;
+	uint32_t stations;          // A bit per station that received it
+	unsigned int receptions;
+	unsigned int length;
+	uint8_t bytes[FRAME_MAX_LENGTH];
+	unsigned int disputed;      // Bytes the receptions disagree on
+	float agreement;            // Votes for the bytes chosen over all votes, 0 to 1
+	float quality;              // Best of the receptions
+};
+
+typedef void (*merged_fn)(const struct store_merged *m, void *ctx);
+
+void store_init(struct store *s);
+void store_free(struct store *s);
+
+// Number of the station of the given name, added if new, or -1 if there are
+// STORE_MAX_STATIONS already
+int store_station(struct store *s, const char *name);
+
+// Add a frame received by a station at a time, returning -1 if out of memory
+int store_add(struct store *s, unsigned int station, int64_t time,
+              const struct ground_frame *frame);
+
+// Sort and index the frames, returning -1 if out of memory
+int store_index(struct store *s);
+
+// Frames of a sprite from time from until before time until, of an indexed
+// store: their number, from *first on
+unsigned long store_range(const struct store *s, uint32_t sprite, int64_t from, int64_t until,
+                          const struct store_frame **first);
+
+// Merge the receptions of the frames of a sprite starting from time from
+// until before time until, less than window apart, with the votes of the
+// given method, in time order. Returns the number of frames merged.
+unsigned long store_merge(const struct store *s, uint32_t sprite, int64_t from,
+                          int64_t until, int64_t window, unsigned int method,
+                          merged_fn fn, void *ctx);
+
+// Save the store to a file in host byte order, or add the frames of one to
+// it, returning -1 on error
+int store_save(const struct store *s, const char *path);
+int store_load(struct store *s, const char *path);
+
+#endif // GROUND_H
@@ -0,0 +1,266 @@
+/*
+  live.c - Decode cf32 samples as they arrive, from standard input or a
+  socket on the loopback interface, e.g. from an SDR or sprite-feed, and
+  print each frame as soon as its last symbol has been received, with the
+  time it was decoded and its latency since that symbol arrived.
+
+  Over UDP every datagram starts with the number of its first sample in
+  the stream, as a 64-bit integer in host order, so lost datagrams are
+  counted and the decoders resynchronized after them. A datagram without
+  samples ends the stream. Over a pipe or TCP nothing can be lost.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "ground.h"
+
+#define SOURCE_STDIN 0
+#define SOURCE_UDP   1
+#define SOURCE_TCP   2
+
+#define UDP_MAX_SAMPLES 8000    // Of a datagram, within 64 KiB
+
+static volatile sig_atomic_t stopping;
+
+static void stop(int sig)
+{
+	(void)sig;
+	stopping = 1;
+}
+
+struct output {
+	double fs;
+	unsigned long bytes, bad;
+};
+
+static void print_live(const struct ground_frame *frame, double latency, void *ctx)
+{
+	struct output *o = ctx;
+	struct timespec now;
+	struct tm tm;
+	char columns[64];
+	size_t len;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	gmtime_r(&now.tv_sec, &tm);
+	len = strftime(columns, sizeof(columns), "%Y-%m-%dT%H:%M:%S", &tm);
+	snprintf(columns + len, sizeof(columns) - len, ".%03ldZ %8.1f",
+	         now.tv_nsec / 1000000, latency * 1e3);
+	print_frame(frame, o->fs, columns);
+	fflush(stdout);
+	o->bytes += frame->length;
+	o->bad += frame->bad;
+}
+
+// Socket bound to the loopback port, and for TCP the first connection to it
+static int open_socket(int type, unsigned int port)
+{
+	struct sockaddr_in addr;
+	int fd, conn, one = 1;
+
+	fd = socket(AF_INET, type, 0);
+	if (fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    (type == SOCK_STREAM && listen(fd, 1))) {
+		close(fd);
+		return -1;
+	}
+	if (type == SOCK_DGRAM)
+		return fd;
+	conn = accept(fd, NULL, NULL);
+	close(fd);
+	return conn;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options] [SOURCE]\n"
+		"  SOURCE     - for standard input (default), or udp:PORT or tcp:PORT\n"
+		"             on the loopback interface\n"
+		"  -M MODE    frames to decode, spread (default) or csk\n"
+		"  -p P0,P1   PRN pair in spread mode, repeatable (default: those of prn.c)\n"
+		"  -c N       CSK codes, 16 or 64 (default 16)\n"
+		"  -f FIRST   first Gold code of a CSK code set, repeatable (default 4)\n"
+		"  -r N       samples per chip (default 2)\n"
+		"  -R RATE    chip rate, for the time of the frames (default 64072)\n"
+		"  -t FRAC    sync detection threshold, 0 to 1 (default 0.02)\n"
+		"  -T         do not track the chip timing of spread frames\n"
+		"  -K N       combine the N copies of each spread frame sent with\n"
+		"             SpriteRadio_setRepeat()\n"
+		"  -b N       samples per read (default 1024)\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static struct channel channels[MAX_CHANNELS];
+	static struct stream stream;
+	unsigned int pairs[MAX_CHANNELS][2], npairs = 0, port = 0;
+	unsigned int firsts[MAX_CHANNELS], nfirsts = 0;
+	unsigned int ncodes = 16, osr = 2, repeats = 1;
+	unsigned long block = 1024, have = 0, expected = 0, late = 0, reads = 0;
+	const char *mode = "spread", *source = "-";
+	double rate = 64072.0, threshold = -1.0, start, seconds;
+	struct output output = { 0 };
+	struct sigaction sa;
+	int nchannels, kind = SOURCE_STDIN, fd = 0, track = 1, opt;
+	unsigned int i;
+	unsigned char *buf;
+	size_t bufsize;
+
+	while ((opt = getopt(argc, argv, "M:p:c:f:r:R:t:TK:b:h")) != -1) {
+		switch (opt) {
+		case 'M': mode = optarg; break;
+		case 'p':
+			if (npairs == MAX_CHANNELS ||
+			    sscanf(optarg, "%u,%u", &pairs[npairs][0], &pairs[npairs][1]) != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+			npairs++;
+			break;
+		case 'c': ncodes = strtoul(optarg, NULL, 0); break;
+		case 'f':
+			if (nfirsts == MAX_CHANNELS) {
+				usage(argv[0]);
+				return 1;
+			}
+			firsts[nfirsts++] = strtoul(optarg, NULL, 0);
+			break;
+		case 'r': osr = strtoul(optarg, NULL, 0); break;
+		case 'R': rate = strtod(optarg, NULL); break;
+		case 't': threshold = strtod(optarg, NULL); break;
+		case 'T': track = 0; break;
+		case 'K': repeats = strtoul(optarg, NULL, 0); break;
+		case 'b': block = strtoul(optarg, NULL, 0); break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (optind < argc)
+		source = argv[optind++];
+	if (sscanf(source, "udp:%u", &port) == 1)
+		kind = SOURCE_UDP;
+	else if (sscanf(source, "tcp:%u", &port) == 1)
+		kind = SOURCE_TCP;
+	if (optind != argc || rate <= 0.0 || block == 0 || repeats == 0 ||
+	    repeats > SPREAD_MAX_REPEATS ||
+	    (kind == SOURCE_STDIN && strcmp(source, "-")) ||
+	    (kind == SOURCE_UDP && block > UDP_MAX_SAMPLES) ||
+	    (strcmp(mode, "spread") && strcmp(mode, "csk"))) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	nchannels = channels_setup(channels, strcmp(mode, "csk") ? FRAME_SPREAD : FRAME_CSK,
+	                           pairs, npairs, firsts, nfirsts, ncodes, osr, threshold);
+	if (nchannels < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	for (i = 0; i < (unsigned int)nchannels; i++) {
+		if (channels[i].mode == FRAME_SPREAD) {
+			channels[i].u.spread.track = track;
+			channels[i].u.spread.repeats = repeats;
+		}
+	}
+	output.fs = rate * osr;
+	bufsize = sizeof(uint64_t) + block * 2 * sizeof(float);
+	buf = malloc(bufsize);
+	if (!buf || stream_init(&stream, channels, nchannels, block, 1ul << 20, print_live,
+	                        &output)) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	// Without SA_RESTART, so that a signal ends a blocking read
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if (kind != SOURCE_STDIN) {
+		fprintf(stderr, "listening on %s\n", source);
+		fd = open_socket(kind == SOURCE_UDP ? SOCK_DGRAM : SOCK_STREAM, port);
+		if (fd < 0) {
+			perror(source);
+			return 1;
+		}
+	}
+
+	print_heading("time decoded (UTC)       latency (ms)");
+	start = wall_clock();
+	while (!stopping) {
+		unsigned long n;
+		ssize_t r;
+
+		if (kind == SOURCE_UDP) {
+			uint64_t first;
+
+			r = recv(fd, buf, bufsize, 0);
+			if (r < (ssize_t)sizeof(first)) {
+				if (r < 0 && errno == EINTR)
+					continue;
+				break;
+			}
+			memcpy(&first, buf, sizeof(first));
+			n = (r - sizeof(first)) / (2 * sizeof(float));
+			if (n == 0)
+				break;
+			if (first < expected) {
+				late++;
+				continue;
+			}
+			if (first > expected)
+				stream_gap(&stream, first - expected);
+			expected = first + n;
+			stream_push(&stream, (const float *)(buf + sizeof(first)), n, wall_clock());
+		} else {
+			r = read(fd, buf + have, bufsize - sizeof(uint64_t) - have);
+			if (r <= 0) {
+				if (r < 0 && errno == EINTR)
+					continue;
+				break;
+			}
+			have += r;
+			n = have / (2 * sizeof(float));
+			stream_push(&stream, (const float *)buf, n, wall_clock());
+			have -= n * 2 * sizeof(float);
+			memmove(buf, buf + n * 2 * sizeof(float), have);
+		}
+		reads++;
+	}
+	stream_finish(&stream);
+	seconds = wall_clock() - start;
+
+	fprintf(stderr,
+		"%lu frames, %lu bytes (%lu bad codewords) in %lu samples (%.3f s of signal)"
+		" in %.3f s\n"
+		"%lu reads, %lu samples dropped, %lu late datagrams\n"
+		"latency of %lu frames: median %.1f ms, 90%% %.1f ms, 99%% %.1f ms, max %.1f ms\n",
+		stream.frames, output.bytes, output.bad, stream.received,
+		stream.received / output.fs, seconds, reads, stream.dropped, late, stream.nlatency,
+		stream_latency(&stream, 50) * 1e3, stream_latency(&stream, 90) * 1e3,
+		stream_latency(&stream, 99) * 1e3, stream_latency(&stream, 100) * 1e3);
+
+	stream_free(&stream);
+	free(buf);
+	if (fd > 0)
+		close(fd);
+	return 0;
+}
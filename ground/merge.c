@@ -0,0 +1,306 @@
+/*
+  merge.c - Merge the frames decoded by several ground stations into a
+  store, and print the frames of each sprite in a time range, each merged
+  from its receptions, with the stations that received it and how far they
+  agree.
+
+  The frames of a station are read from the tables of sprite-decode or
+  sprite-live, one log per recording or stream, with the times of the frames
+  from the start of it. The station is the name of the log, without its
+  directory and extension, so the logs of several passes over a station
+  are one station. Stores written with -o are read back with -i, and may
+  be added to with more logs.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ground.h"
+
+#define MAX_TOKENS 16
+#define SECOND 1000000ll
+
+// Days since 1970-01-01 of a date of the Gregorian calendar
+static int64_t days_from_civil(int y, unsigned int m, unsigned int d)
+{
+	int64_t era;
+	unsigned int yoe, doy, doe;
+
+	y -= m <= 2;
+	era = (y >= 0 ? y : y - 399) / 400;
+	yoe = y - era * 400;
+	doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+// UTC as 2026-10-18T12:00:00.5Z, or seconds since the epoch, in microseconds
+static int parse_time(const char *s, int64_t *us)
+{
+	int y, mo, d, h, mi, n = 0;
+	double sec;
+	char *end;
+
+	if (strchr(s, 'T')) {
+		if (sscanf(s, "%d-%d-%dT%d:%d:%lf%n", &y, &mo, &d, &h, &mi, &sec, &n) != 6 ||
+		    mo < 1 || mo > 12 || d < 1 || d > 31 || (s[n] && strcmp(s + n, "Z")))
+			return -1;
+		*us = ((days_from_civil(y, mo, d) * 24 + h) * 60 + mi) * 60 * SECOND +
+		      (int64_t)(sec * SECOND + 0.5);
+		return 0;
+	}
+	sec = strtod(s, &end);
+	if (end == s || *end)
+		return -1;
+	*us = (int64_t)(sec * SECOND + (sec < 0.0 ? -0.5 : 0.5));
+	return 0;
+}
+
+static void format_time(int64_t us, char *buf, size_t size)
+{
+	int64_t sec = us / SECOND - (us % SECOND < 0);
+	time_t t = sec;
+	struct tm tm;
+	size_t len;
+
+	gmtime_r(&t, &tm);
+	len = strftime(buf, size, "%Y-%m-%dT%H:%M:%S", &tm);
+	snprintf(buf + len, size - len, ".%06ldZ", (long)(us - sec * SECOND));
+}
+
+// A line of print_frame(): any columns, the time, PRNs, length, sync, ppm,
+// FEC fixes and bad codewords, and the quoted bytes
+static int parse_frame(char *line, double *t, struct ground_frame *f)
+{
+	char *tokens[MAX_TOKENS], *open = strchr(line, '"'), *close = strrchr(line, '"'), *p;
+	unsigned int ntokens = 0, c;
+
+	if (!open || close == open)
+		return -1;
+	*open = '\0';
+	for (p = strtok(line, " \t"); p && ntokens < MAX_TOKENS; p = strtok(NULL, " \t"))
+		tokens[ntokens++] = p;
+	if (ntokens < 7)
+		return -1;
+
+	memset(f, 0, sizeof(*f));
+	p = tokens[ntokens - 7];
+	*t = strtod(p, &p);
+	if (*p || sscanf(tokens[ntokens - 6], "%u/%u", &f->prn0, &f->prn1) != 2 ||
+	    sscanf(tokens[ntokens - 4], "%f", &f->quality) != 1 ||
+	    sscanf(tokens[ntokens - 3], "%f", &f->clock) != 1 ||
+	    sscanf(tokens[ntokens - 2], "%u", &f->corrected) != 1 ||
+	    sscanf(tokens[ntokens - 1], "%u", &f->bad) != 1)
+		return -1;
+	for (p = open + 1; p < close && f->length < FRAME_MAX_LENGTH; f->length++) {
+		if (p[0] == '\\' && p[1] == 'x' && sscanf(p + 2, "%2x", &c) == 1) {
+			f->bytes[f->length] = c;
+			p += 4;
+		} else {
+			f->bytes[f->length] = *p++;
+		}
+	}
+	return 0;
+}
+
+// The station of a log: its name without directory and extension
+static int log_station(struct store *s, const char *path)
+{
+	char name[STORE_STATION_NAME];
+	const char *base = strrchr(path, '/');
+	char *dot;
+
+	base = base ? base + 1 : path;
+	snprintf(name, sizeof(name), "%s", base);
+	dot = strchr(name, '.');
+	if (dot && dot != name)
+		*dot = '\0';
+	return store_station(s, name);
+}
+
+// Read the frames of a log, LOG or LOG@START
+static long read_log(struct store *s, char *arg)
+{
+	char line[4096], *at = strrchr(arg, '@');
+	struct ground_frame frame;
+	int64_t start = 0;
+	long n = 0;
+	int station;
+	double t;
+	FILE *fp;
+
+	if (at) {
+		*at = '\0';
+		if (parse_time(at + 1, &start))
+			return -1;
+	}
+	station = log_station(s, arg);
+	fp = strcmp(arg, "-") ? fopen(arg, "r") : stdin;
+	if (station < 0 || !fp)
+		return -1;
+	while (fgets(line, sizeof(line), fp)) {
+		if (parse_frame(line, &t, &frame))
+			continue;
+		if (store_add(s, station, start + (int64_t)(t * SECOND + 0.5), &frame)) {
+			n = -1;
+			break;
+		}
+		n++;
+	}
+	if (fp != stdin)
+		fclose(fp);
+	return n;
+}
+
+struct output {
+	const struct store *s;
+	int quiet;
+	unsigned long receptions, disputed;
+};
+
+static void print_merged(const struct store_merged *m, void *ctx)
+{
+	struct output *o = ctx;
+	char time[40], stations[128];
+	size_t len = 0;
+	unsigned int i;
+
+	o->receptions += m->receptions;
+	o->disputed += m->disputed > 0;
+	if (o->quiet)
+		return;
+	stations[0] = '\0';
+	for (i = 0; i < o->s->nstations && len < sizeof(stations); i++) {
+		if (m->stations & 1u << i)
+			len += snprintf(stations + len, sizeof(stations) - len, "%s%s",
+			                len ? "," : "", o->s->stations[i]);
+	}
+	format_time(m->time, time, sizeof(time));
+	printf("%s %3u/%-3u %3u %3u %5.3f %5.3f %3u %-16s ", time, m->sprite >> 16,
+	       m->sprite & 0xFFFF, m->receptions, m->length, m->quality, m->agreement,
+	       m->disputed, stations);
+	print_bytes(m->bytes, m->length);
+	putchar('\n');
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [options] [LOG[@START]...]\n"
+		"  LOG        frames printed by sprite-decode or sprite-live at a station,\n"
+		"             - for standard input, with the times of the frames from\n"
+		"             START: UTC as 2026-10-18T12:00:00.5Z or seconds since the\n"
+		"             epoch (default 0)\n"
+		"  -i STORE   frames of a store written with -o, repeatable\n"
+		"  -o STORE   write the store of all the frames read\n"
+		"  -p P0,P1   only the sprite of this PRN pair (or first and last CSK code)\n"
+		"  -f TIME    only frames from this time, as START\n"
+		"  -u TIME    only frames before this time, as START\n"
+		"  -w SEC     receptions of the same frame are less than this apart\n"
+		"             (default 0.1)\n"
+		"  -m METHOD  votes of a reception: confidence (default), its sync quality\n"
+		"             over 1 + its bad codewords, or majority, one\n"
+		"  -q         print no frames, only the counts\n",
+		argv0);
+}
+
+int main(int argc, char **argv)
+{
+	static struct store store;
+	struct output output = { &store, 0, 0, 0 };
+	unsigned int prn0, prn1, method = STORE_CONFIDENCE, i;
+	int64_t from = INT64_MIN, until = INT64_MAX, window = SECOND / 10;
+	unsigned long merged = 0;
+	const char *out = NULL;
+	double t0, t1, t2;
+	int one = 0, opt;
+	long n;
+
+	store_init(&store);
+	t0 = wall_clock();
+	while ((opt = getopt(argc, argv, "i:o:p:f:u:w:m:qh")) != -1) {
+		switch (opt) {
+		case 'i':
+			if (store_load(&store, optarg)) {
+				fprintf(stderr, "%s: not a store or too many stations\n", optarg);
+				return 1;
+			}
+			break;
+		case 'o': out = optarg; break;
+		case 'p':
+			if (sscanf(optarg, "%u,%u", &prn0, &prn1) != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+			one = 1;
+			break;
+		case 'f':
+		case 'u':
+			if (parse_time(optarg, opt == 'f' ? &from : &until)) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'w': window = strtod(optarg, NULL) * SECOND; break;
+		case 'm':
+			if (strcmp(optarg, "confidence") == 0) {
+				method = STORE_CONFIDENCE;
+			} else if (strcmp(optarg, "majority") == 0) {
+				method = STORE_MAJORITY;
+			} else {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'q': output.quiet = 1; break;
+		default: usage(argv[0]); return 1;
+		}
+	}
+	if (window <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	for (; optind < argc; optind++) {
+		n = read_log(&store, argv[optind]);
+		if (n < 0) {
+			fprintf(stderr, "%s: cannot read, bad start time or too many stations\n",
+			        argv[optind]);
+			return 1;
+		}
+	}
+	t1 = wall_clock();
+	if (store_index(&store)) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	if (out && store_save(&store, out)) {
+		perror(out);
+		return 1;
+	}
+	t2 = wall_clock();
+
+	if (!output.quiet)
+		printf("%-27s %-7s %3s %3s %5s %5s %3s %-16s %s\n", "time (UTC)", "PRNs", "rx",
+		       "len", "sync", "agree", "dis", "stations", "bytes");
+	for (i = 0; i < store.nsprites; i++) {
+		uint32_t sprite = store.sprites[i].sprite;
+
+		if (one && sprite != STORE_SPRITE(prn0, prn1))
+			continue;
+		merged += store_merge(&store, sprite, from, until, window, method, print_merged,
+		                      &output);
+	}
+
+	fprintf(stderr,
+		"%lu frames of %u sprites from %u stations read in %.3f s, indexed in %.3f s\n"
+		"%lu frames merged from %lu receptions (%lu duplicates), %lu disputed,"
+		" in %.3f s\n",
+		store.nframes, store.nsprites, store.nstations, t1 - t0, t2 - t1, merged,
+		output.receptions, output.receptions - merged, output.disputed,
+		wall_clock() - t2);
+	store_free(&store);
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+  pool.c - Work-stealing thread pool.
+
+  Every thread owns a run of task numbers [next, end) and takes them from the
+  front, so that it walks through memory in order. A thread out of work
+  takes the back half of the longest run left, which keeps the remaining
+  runs contiguous and the steals few.
+*/
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "ground.h"
+
+struct deque {
+	pthread_mutex_t lock;
+	unsigned long next, end;
+} __attribute__((aligned(64)));
+
+struct pool {
+	struct deque *deques;
+	unsigned int nthreads;
+	pool_fn fn;
+	void *ctx;
+	atomic_ulong steals;
+};
+
+struct worker {
+	struct pool *pool;
+	unsigned int id;
+};
+
+static int take(struct deque *q, unsigned long *task)
+{
+	int ok;
+
+	pthread_mutex_lock(&q->lock);
+	ok = q->next < q->end;
+	if (ok)
+		*task = q->next++;
+	pthread_mutex_unlock(&q->lock);
+	return ok;
+}
+
+static unsigned long length(struct deque *q)
+{
+	unsigned long n;
+
+	pthread_mutex_lock(&q->lock);
+	n = q->end - q->next;
+	pthread_mutex_unlock(&q->lock);
+	return n;
+}
+
+// Move the back half of the longest other run into our empty deque. Both
+// locks are taken in thread order, as two threads may steal from each other.
+static int steal(struct pool *p, unsigned int self)
+{
+	struct deque *mine = &p->deques[self], *theirs, *first, *second;
+	unsigned long longest = 0, n;
+	unsigned int i, victim = self;
+
+	for (i = 0; i < p->nthreads; i++) {
+		if (i != self && (n = length(&p->deques[i])) > longest) {
+			longest = n;
+			victim = i;
+		}
+	}
+	if (victim == self)
+		return 0;
+
+	theirs = &p->deques[victim];
+	first = victim < self ? theirs : mine;
+	second = victim < self ? mine : theirs;
+	pthread_mutex_lock(&first->lock);
+	pthread_mutex_lock(&second->lock);
+	n = theirs->end - theirs->next;
+	if (n) {
+		mine->end = theirs->end;
+		theirs->end -= (n + 1) / 2;
+		mine->next = theirs->end;
+		atomic_fetch_add(&p->steals, 1);
+	}
+	pthread_mutex_unlock(&second->lock);
+	pthread_mutex_unlock(&first->lock);
+	return 1;
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct pool *p = w->pool;
+	unsigned long task;
+
+	do {
+		while (take(&p->deques[w->id], &task))
+			p->fn(task, w->id, p->ctx);
+	} while (steal(p, w->id));
+	return NULL;
+}
+
+unsigned long pool_run(unsigned int nthreads, unsigned long ntasks, pool_fn fn, void *ctx)
+{
+	struct pool p;
+	struct deque one;
+	struct worker *workers, alone;
+	pthread_t *threads;
+	unsigned int i, started;
+
+	if (nthreads == 0)
+		nthreads = 1;
+	p.deques = aligned_alloc(64, nthreads * sizeof(*p.deques));
+	workers = calloc(nthreads, sizeof(*workers));
+	threads = calloc(nthreads, sizeof(*threads));
+	if (!p.deques || !workers || !threads) {
+		// Out of memory: run every task on this thread
+		free(p.deques);
+		free(workers);
+		free(threads);
+		p.deques = &one;
+		workers = &alone;
+		threads = NULL;
+		nthreads = 1;
+	}
+	p.nthreads = nthreads;
+	p.fn = fn;
+	p.ctx = ctx;
+	atomic_init(&p.steals, 0);
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_mutex_init(&p.deques[i].lock, NULL);
+		p.deques[i].next = ntasks * i / nthreads;
+		p.deques[i].end = ntasks * (i + 1) / nthreads;
+		workers[i].pool = &p;
+		workers[i].id = i;
+	}
+	// The runs of threads that could not be created are stolen by the others
+	for (started = 1; started < nthreads; started++) {
+		if (pthread_create(&threads[started], NULL, worker_main, &workers[started]))
+			break;
+	}
+	worker_main(&workers[0]);
+	for (i = 1; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_mutex_destroy(&p.deques[i].lock);
+	if (threads) {
+		free(threads);
+		free(workers);
+		free(p.deques);
+	}
+	return atomic_load(&p.steals);
+}
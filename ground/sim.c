@@ -0,0 +1,159 @@
+/*
+  sim.c - Channel simulator of the BER harness.
+
+  Frames of SpriteRadio_transmitByte() are laid out chip by chip at the
+  sampling instants of the receiver, from a fractional start and with the
+  chip clock error of the sprite, then turned onto the carrier and summed
+  into the samples with the other signals and the noise.
+
+  The carrier and the noise take most of the time and run on GCC vector
+  extensions, SIM_VECTOR floats at a time, two per complex sample, so they
+  compile to whatever SIMD the target has. The carrier phasors of a vector's
+  samples are advanced by complex multiplication and recomputed every
+  SIM_RESYNC vectors. The noise is the sum of four uniform variates, scaled
+  to the variance: the decoders sum hundreds of samples per decision, so
+  only the variance matters, and unlike libm's the uniforms vectorize.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ground.h"
+
+#define SIM_RESYNC 256
+#define TWO_PI (2.0 * 3.14159265358979323846)
+
+typedef float vfloat __attribute__((vector_size(SIM_VECTOR * sizeof(float))));
+typedef int32_t vint __attribute__((vector_size(SIM_VECTOR * sizeof(int32_t))));
+
+// The frame of SpriteRadio_transmitByte()
+#define PREAMBLE  0x72
+#define POSTAMBLE 0x58
+
+void sim_frame(const uint8_t code[2][GOLD_CHIPS], uint8_t data, float chips[SIM_FRAME_CHIPS])
+{
+	uint32_t bits = (uint32_t)PREAMBLE << 23 | (uint32_t)fec_parity(data) << 15 |
+	                (uint32_t)data << 7 | POSTAMBLE;
+	unsigned int s, n;
+
+	for (s = 0; s < SPREAD_SYMBOLS; s++) {
+		const uint8_t *c = code[(bits >> (SPREAD_SYMBOLS - 1 - s)) & 1];
+
+		for (n = 0; n < GOLD_CHIPS; n++)
+			chips[s * GOLD_CHIPS + n] = c[n] ? 1.0f : -1.0f;
+	}
+}
+
+float *sim_alloc(unsigned long nsamples)
+{
+	size_t size = (2 * nsamples + SIM_VECTOR - 1) / SIM_VECTOR * SIM_VECTOR * sizeof(float);
+	float *iq = aligned_alloc(SIM_ALIGN, size);
+
+	if (iq)
+		memset(iq, 0, size);
+	return iq;
+}
+
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+void sim_seed(struct sim_rng *r, uint64_t seed)
+{
+	unsigned int i;
+
+	for (i = 0; i < SIM_VECTOR; i++) {
+		uint64_t a = splitmix64(&seed), b = splitmix64(&seed);
+
+		r->x[i] = a;
+		r->y[i] = a >> 32;
+		r->z[i] = b;
+		r->w[i] = (b >> 32) | 1;
+	}
+}
+
+// xorshift128 in every lane, into w
+static inline void next(struct sim_rng *r)
+{
+	sim_lanes t = r->x ^ (r->x << 11);
+
+	r->x = r->y;
+	r->y = r->z;
+	r->z = r->w;
+	r->w = r->w ^ (r->w >> 19) ^ t ^ (t >> 8);
+}
+
+void sim_noise(struct sim_rng *r, float *iq, unsigned long nsamples, float variance)
+{
+	// Four 16-bit uniforms have mean 131070 and variance 65536^2 / 3
+	float scale = sqrtf(1.5f * variance) / 65536.0f;
+	unsigned long i;
+
+	for (i = 0; i < 2 * nsamples; i += SIM_VECTOR) {
+		vfloat *v = (vfloat *)(iq + i);
+		sim_lanes a, b;
+		vint sum;
+
+		next(r);
+		a = r->w;
+		next(r);
+		b = r->w;
+		sum = (vint)((a & 0xFFFF) + (a >> 16) + (b & 0xFFFF) + (b >> 16));
+
+		*v += (__builtin_convertvector(sum, vfloat) - 131070.0f) * scale;
+	}
+}
+
+// Phasors of the samples of a vector from sample n on
+static void phasors(const struct sim_signal *s, unsigned long n, vfloat *p)
+{
+	unsigned int k;
+
+	for (k = 0; k < SIM_VECTOR / 2; k++) {
+		double theta = s->phase + TWO_PI * s->doppler * (double)(n + k);
+
+		(*p)[2 * k] = cos(theta);
+		(*p)[2 * k + 1] = sin(theta);
+	}
+}
+
+void sim_add(float *iq, unsigned long nsamples, unsigned int osr, const struct sim_signal *s,
+             float *scratch)
+{
+	const vint swap = { 1, 0, 3, 2, 5, 4, 7, 6 };
+	double step = (1.0 + s->clock) / osr, pos;
+	double turn = TWO_PI * s->doppler * (SIM_VECTOR / 2);
+	vfloat rc, rs, p = { 0 };
+	unsigned long n, i;
+
+	// Chips times the amplitude at each sample, for I and Q
+	pos = -s->start * step;
+	for (n = 0; n < nsamples; n++, pos += step) {
+		float c = pos >= 0.0 && pos < s->nchips ? s->chips[(unsigned long)pos] * s->amplitude
+		                                        : 0.0f;
+
+		scratch[2 * n] = c;
+		scratch[2 * n + 1] = c;
+	}
+	for (n = 2 * nsamples; n % SIM_VECTOR; n++)
+		scratch[n] = 0.0f;
+
+	// Each step turns the phasors by the carrier offset of a vector
+	for (i = 0; i < SIM_VECTOR; i += 2) {
+		rc[i] = rc[i + 1] = cos(turn);
+		rs[i] = -sin(turn);
+		rs[i + 1] = sin(turn);
+	}
+	for (i = 0; i < 2 * nsamples; i += SIM_VECTOR) {
+		if (i % (SIM_RESYNC * SIM_VECTOR) == 0)
+			phasors(s, i / 2, &p);
+		*(vfloat *)(iq + i) += *(const vfloat *)(scratch + i) * p;
+		p = p * rc + __builtin_shuffle(p, swap) * rs;
+	}
+}
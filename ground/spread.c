@@ -0,0 +1,530 @@
+/*
+  spread.c - Decoder of the spread spectrum frames of
+  SpriteRadio_transmitByte().
+
+  A frame is found like a CSK frame, by the first code of its preamble, and
+  confirmed by the rest of the preamble and by the postamble. Each bit is the code of the pair
+  with the larger noncoherent correlation, and their difference is the soft
+  metric of the FEC decoder.
+
+  The chip clock of a sprite runs off its own crystal, tens of ppm from
+  ours, which over the 15360 chips of a frame slips the later symbols by
+  a large part of a chip. Each symbol is therefore taken at a tracked,
+  fractional sample position, interpolating the correlations of the
+  samples either side. An early-late loop corrects the position from the
+  correlations half a chip either side with the code the symbol was taken
+  for, and integrates the corrections into the drift of the symbol period.
+  The drift is carried over to the next frame of the channel. Once frames
+  come at a steady period, the next one is looked for where it is due at
+  half the sync threshold.
+
+  Copies of a frame sent back to back are exactly a frame of the sprite's
+  chips apart, which is a frame of ours give or take its clock error. They
+  are found by the sync correlation averaged over the copies, at the clock
+  error of a grid over +/- max_clock that lines them up best: the grid
+  moves the last copy by half a sample a step, and the correlations of each
+  copy are kept in a ring over the window its clock error may move it in,
+  so every one is computed once. The noise of the average is smaller, and
+  its threshold lower for the same rate of false alarms. Copies found
+  early, the first ones in noise, are moved on while that lines up more of
+  them. The first symbol moves the copies to their peak together, the
+  clock error puts each symbol of every copy in place, and the metrics of
+  the copies of a symbol are summed.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ground.h"
+
+#define PREAMBLE      0x72      // 1110010
+#define PREAMBLE_BITS 7
+#define POSTAMBLE     0x58      // 1011000
+#define POSTAMBLE_BITS 7
+#define POSTAMBLE_ERRORS 2
+
+// Chip timing loop, per symbol: proportional and integral gains, the most
+// drift believed, and the window a frame is looked for in once the period
+// is known, in chips
+#define TRACK_GAIN       0.25
+#define TRACK_DRIFT_GAIN 0.02
+#define TRACK_MAX_DRIFT  500e-6
+#define TRACK_WINDOW     32
+
+// Sync correlations of a copy kept while combining, a power of two
+#define REPEAT_RING 1024
+
+int spread_init(struct spread_decoder *d, unsigned int prn0, unsigned int prn1,
+                unsigned int osr)
+{
+	if (osr == 0 || prn0 == prn1)
+		return -1;
+	memset(d, 0, sizeof(*d));
+	d->prn0 = prn0;
+	d->prn1 = prn1;
+	d->osr = osr;
+	d->threshold = 0.02f;
+	d->track = 1;
+	d->repeats = 1;
+	d->max_clock = 100.0f;
+	gold_code_float(prn0, d->code[0]);
+	gold_code_float(prn1, d->code[1]);
+	return 0;
+}
+
+// Most clock error searched with repeats, as a fraction, within the rings
+static double max_drift(const struct spread_decoder *d)
+{
+	double frames = (double)d->repeats * SPREAD_SYMBOLS * GOLD_CHIPS * d->osr;
+	double most = (REPEAT_RING / 4 - 4) / frames;
+
+	return d->max_clock * 1e-6 < most ? d->max_clock * 1e-6 : most;
+}
+
+// Samples the clock error may move copy k by
+static unsigned long copy_window(const struct spread_decoder *d, unsigned int k)
+{
+	return (unsigned long)(k * (double)SPREAD_SYMBOLS * GOLD_CHIPS * d->osr * max_drift(d)) + 1;
+}
+
+unsigned long spread_span(const struct spread_decoder *d)
+{
+	return spread_lookahead(d) + d->osr;
+}
+
+// With repeats, the copies of a frame found all but one copy early
+unsigned long spread_lookahead(const struct spread_decoder *d)
+{
+	unsigned long frame_samples = (unsigned long)SPREAD_SYMBOLS * GOLD_CHIPS * d->osr;
+
+	if (d->repeats <= 1)
+		return frame_samples;
+	return (2 * d->repeats) * frame_samples + copy_window(d, d->repeats) + 2;
+}
+
+// Complex correlation with code at a fractional sample position, kept
+// within the nsamples chip sums
+static void correlate_at(const struct spread_decoder *d, const float *iq,
+                         unsigned long nsamples, double pos, const float *code,
+                         float *ci, float *cq)
+{
+	double last = (double)nsamples - 2 - (GOLD_PERIOD - 1) * (double)d->osr;
+	unsigned long k;
+	float f, i1, q1;
+
+	if (pos > last)
+		pos = last;
+	if (pos < 0.0)
+		pos = 0.0;
+	k = (unsigned long)pos;
+	f = pos - k;
+	correlate(iq + 2 * k, d->osr, code, ci, cq);
+	if (f == 0.0f)
+		return;
+	correlate(iq + 2 * (k + 1), d->osr, code, &i1, &q1);
+	*ci += f * (i1 - *ci);
+	*cq += f * (q1 - *cq);
+}
+
+struct tracker {
+	double pos;                 // Of the next symbol
+	double drift;               // Samples per symbol beyond the nominal
+};
+
+// Power of the 1 code minus that of the 0 code of the symbol at the tracked
+// position, advancing it to the next symbol
+static float track_symbol(const struct spread_decoder *d, const float *iq,
+                          unsigned long nsamples, struct tracker *tr, double gain)
+{
+	double period = (double)GOLD_CHIPS * d->osr, half = 0.5 * d->osr, late;
+	float i0, q0, i1, q1, ie, qe, il, ql, e, l, m;
+
+	correlate_at(d, iq, nsamples, tr->pos, d->code[0], &i0, &q0);
+	correlate_at(d, iq, nsamples, tr->pos, d->code[1], &i1, &q1);
+	m = (i1 * i1 + q1 * q1) - (i0 * i0 + q0 * q0);
+	if (d->track) {
+		const float *code = d->code[m > 0.0f];
+
+		correlate_at(d, iq, nsamples, tr->pos - half, code, &ie, &qe);
+		correlate_at(d, iq, nsamples, tr->pos + half, code, &il, &ql);
+		e = sqrtf(ie * ie + qe * qe);
+		l = sqrtf(il * il + ql * ql);
+		if (e + l > 0.0f) {
+			// Of a triangular correlation peak, in samples
+			late = half * (e - l) / (e + l);
+			tr->pos -= gain * late;
+			tr->drift -= TRACK_DRIFT_GAIN * late;
+			if (fabs(tr->drift) > TRACK_MAX_DRIFT * period)
+				tr->drift = copysign(TRACK_MAX_DRIFT * period, tr->drift);
+		}
+	}
+	tr->pos += period + tr->drift;
+	return m;
+}
+
+// Sync threshold of the average of n copies with the false alarm rate of
+// one at threshold: the noise of one is exponential of mean 1/GOLD_PERIOD,
+// so that of the average is the Gamma distribution of shape n
+static float repeat_threshold(float threshold, unsigned int n)
+{
+	double target = exp(-threshold * GOLD_PERIOD), lo = 0.0, hi = n * threshold * GOLD_PERIOD;
+	unsigned int i, k;
+
+	for (i = 0; i < 60; i++) {
+		double y = 0.5 * (lo + hi), term = 1.0, tail = 0.0;
+
+		for (k = 0; k < n; k++) {
+			tail += term;
+			term *= y / (k + 1);
+		}
+		if (exp(-y) * tail > target)
+			lo = y;
+		else
+			hi = y;
+	}
+	return hi / n / GOLD_PERIOD;
+}
+
+struct copies {
+	const struct spread_decoder *d;
+	const float *iq;
+	unsigned long nsamples;
+	unsigned int n;                 // Copies combined
+	unsigned long frame;            // Samples of a frame
+	double step;                    // Of the clock error grid
+	int steps;                      // Either side of none
+	unsigned long window[SPREAD_MAX_REPEATS + 1];
+	unsigned long first[SPREAD_MAX_REPEATS + 1];    // Positions in the ring,
+	unsigned long next[SPREAD_MAX_REPEATS + 1];     // from first to before next
+	float ring[SPREAD_MAX_REPEATS + 1][REPEAT_RING];
+};
+
+// Correlate copies 0 to n, the one after the last too, up to where frames at
+// p and p + 1 may have them
+static void fill(struct copies *c, unsigned long p)
+{
+	unsigned long last = c->nsamples - (GOLD_PERIOD - 1) * c->d->osr, lo, hi, x;
+	unsigned int k;
+
+	for (k = 0; k <= c->n; k++) {
+		x = p + k * c->frame;
+		lo = x > c->window[k] ? x - c->window[k] : 0;
+		hi = x + c->window[k] + 2;
+		if (lo < c->first[k] || lo > c->next[k] || lo + REPEAT_RING < c->next[k])
+			c->first[k] = c->next[k] = lo;
+		for (x = c->next[k]; x <= hi; x++)
+			c->ring[k][x % REPEAT_RING] = x < last ? sync_correlation(c->iq + 2 * x, c->d->osr,
+			                                                          c->d->code[1]) : 0.0f;
+		c->next[k] = hi + 1;
+	}
+}
+
+// Sync correlation of copy k of a frame at p with clock error drift
+static float copy_sync(const struct copies *c, unsigned int k, unsigned long p, double drift)
+{
+	double pos = (double)k * c->frame * drift;
+	long i = (long)floor(pos);
+	float f = pos - i;
+	unsigned long x = p + k * c->frame + i;
+
+	return c->ring[k][x % REPEAT_RING] +
+	       f * (c->ring[k][(x + 1) % REPEAT_RING] - c->ring[k][x % REPEAT_RING]);
+}
+
+// Average sync correlation of the copies first on of a frame at p, at the
+// clock error of the grid that lines them up best, stored in drift
+static float combined_sync(const struct copies *c, unsigned long p, unsigned int first,
+                           double *drift)
+{
+	float best = -1.0f, q;
+	unsigned int k;
+	int h;
+
+	for (h = -c->steps; h <= c->steps; h++) {
+		for (k = first, q = 0.0f; k < first + c->n; k++)
+			q += copy_sync(c, k, p, h * c->step);
+		if (q > best) {
+			best = q;
+			*drift = h * c->step;
+		}
+	}
+	return best / c->n;
+}
+
+// Metric of a symbol summed over the copies, at pos[k] in each, moving them
+// on to the next symbol. For a known bit, the sync correlations with its
+// code are added to known.
+static float combined_symbol(const struct copies *c, double *pos, double drift, int bit,
+                             float *known)
+{
+	double symbol = (double)GOLD_CHIPS * c->d->osr;
+	unsigned long last = c->nsamples - (GOLD_PERIOD - 1) * c->d->osr, x;
+	float i0, q0, i1, q1, m = 0.0f;
+	unsigned int k;
+
+	for (k = 0; k < c->n; k++) {
+		correlate_at(c->d, c->iq, c->nsamples, pos[k], c->d->code[0], &i0, &q0);
+		correlate_at(c->d, c->iq, c->nsamples, pos[k], c->d->code[1], &i1, &q1);
+		m += (i1 * i1 + q1 * q1) - (i0 * i0 + q0 * q0);
+		x = (unsigned long)(pos[k] + 0.5);
+		if (bit >= 0 && x < last)
+			*known += sync_correlation(c->iq + 2 * x, c->d->osr, c->d->code[bit]);
+		pos[k] += symbol * (1.0 + drift);
+	}
+	return m;
+}
+
+static long decode_repeats(const struct spread_decoder *d, const float *iq,
+                           unsigned long nsamples, unsigned long start, unsigned long limit,
+                           unsigned long *resume, frame_fn fn, void *ctx)
+{
+	struct copies c;
+	double symbol = (double)GOLD_CHIPS * d->osr, half = 0.5 * d->osr;
+	float threshold = repeat_threshold(d->threshold, d->repeats);
+	unsigned int nknown = d->repeats * (PREAMBLE_BITS + POSTAMBLE_BITS);
+	float known_threshold = repeat_threshold(d->threshold, nknown);
+	unsigned long t = start, need, span, best, found, p;
+	long frames = 0;
+	struct ground_frame frame;
+	unsigned int k;
+
+	c.d = d;
+	c.iq = iq;
+	c.nsamples = nsamples;
+	c.n = d->repeats;
+	c.frame = SPREAD_SYMBOLS * (unsigned long)symbol;
+	c.step = 0.5 / ((c.n - 1) * (double)c.frame);
+	c.steps = (int)(max_drift(d) / c.step);
+	for (k = 0; k <= c.n; k++) {
+		c.window[k] = copy_window(d, k);
+		c.first[k] = c.next[k] = 0;
+	}
+	need = c.n * c.frame + c.window[c.n] + 2;
+	span = 2 * c.window[c.n - 1] + d->osr;
+
+	while (t < limit && t + need <= nsamples) {
+		float metric[16], q, next, e, l, known = 0.0f;
+		double drift, next_drift, pos[SPREAD_MAX_REPEATS], late;
+		unsigned int i, errors;
+
+		fill(&c, t);
+		q = combined_sync(&c, t, 0, &drift);
+		if (q < threshold) {
+			t++;
+			continue;
+		}
+		// A copy alone lines up at clock errors up to its window off, so
+		// the peak is the best over the windows either side
+		for (best = t, p = t + 1; p <= t + span && p + need <= nsamples; p++) {
+			fill(&c, p);
+			next = combined_sync(&c, p, 0, &next_drift);
+			if (next > q) {
+				q = next;
+				drift = next_drift;
+				best = p;
+			}
+		}
+		t = best;
+		if (t >= limit)
+			break;
+		// Copies found early, with the first ones in noise, line up better
+		// a copy or more on, by half a copy at least
+		found = t;
+		for (k = 1, p = t; k < c.n; k++) {
+			next = combined_sync(&c, p, 1, &next_drift);
+			p += (unsigned long)floor(c.frame * (1.0 + next_drift) + 0.5);
+			if (p + need > nsamples)
+				break;
+			if (next > q * (1.0f + 0.5f / c.n)) {
+				q = next;
+				drift = next_drift;
+				t = p;
+			}
+			fill(&c, p);
+		}
+		if (t >= limit || t + need > nsamples) {
+			t = found;
+			break;
+		}
+
+		// The first symbol of every copy moves them all to its peak
+		for (k = 0; k < c.n; k++)
+			pos[k] = t + k * c.frame * (1.0 + drift);
+		for (k = 0, e = l = 0.0f; k < c.n; k++) {
+			float ie, qe, il, ql;
+
+			correlate_at(d, iq, nsamples, pos[k] - half, d->code[1], &ie, &qe);
+			correlate_at(d, iq, nsamples, pos[k] + half, d->code[1], &il, &ql);
+			e += sqrtf(ie * ie + qe * qe);
+			l += sqrtf(il * il + ql * ql);
+		}
+		late = e + l > 0.0f ? half * (e - l) / (e + l) : 0.0;
+		for (k = 0; k < c.n; k++)
+			pos[k] -= late;
+
+		// At the lower threshold noise passes the preamble now and then,
+		// but seldom the sync correlations of all the known symbols
+		for (i = 0; i < PREAMBLE_BITS; i++) {
+			int bit = (PREAMBLE >> (PREAMBLE_BITS - 1 - i)) & 1;
+
+			if ((combined_symbol(&c, pos, drift, bit, &known) > 0.0f) != bit)
+				break;
+		}
+		if (i < PREAMBLE_BITS) {
+			t = found + 1;
+			continue;
+		}
+		for (i = 0; i < 16; i++)
+			metric[i] = combined_symbol(&c, pos, drift, -1, NULL);
+		for (i = 0, errors = 0; i < POSTAMBLE_BITS; i++) {
+			int bit = (POSTAMBLE >> (POSTAMBLE_BITS - 1 - i)) & 1;
+
+			errors += (combined_symbol(&c, pos, drift, bit, &known) > 0.0f) != bit;
+		}
+		if (errors > POSTAMBLE_ERRORS || known / nknown < known_threshold) {
+			t = found + 1;
+			continue;
+		}
+
+		memset(&frame, 0, sizeof(frame));
+		frame.sample = t;
+		frame.end = (unsigned long)ceil(pos[c.n - 1]);
+		frame.mode = FRAME_SPREAD;
+		frame.prn0 = d->prn0;
+		frame.prn1 = d->prn1;
+		frame.length = 1;
+		frame.quality = q;
+		frame.clock = drift ? -drift * 1e6 : 0.0;
+		for (i = 0; i < 16; i++)
+			frame.hard = frame.hard << 1 | (metric[i] > 0.0f);
+		errors = fec_decode_soft(metric, &frame.bytes[0]);
+		if (errors > FEC_CORRECTABLE)
+			frame.bad = 1;
+		else
+			frame.corrected = errors;
+		fn(&frame, ctx);
+		frames++;
+		t = frame.end;
+	}
+	if (resume)
+		*resume = t;
+	return frames;
+}
+
+long spread_decode_chips(const struct spread_decoder *d, const float *iq,
+                         unsigned long nsamples, unsigned long start, unsigned long limit,
+                         unsigned long *resume, struct spread_timing *timing,
+                         frame_fn fn, void *ctx)
+{
+	unsigned long symbol_samples = (unsigned long)GOLD_CHIPS * d->osr;
+	unsigned long frame_samples = SPREAD_SYMBOLS * symbol_samples;
+	double window = (double)TRACK_WINDOW * d->osr;
+	unsigned long t = start;
+	long frames = 0;
+	struct ground_frame frame;
+
+	if (d->repeats > 1)
+		return decode_repeats(d, iq, nsamples, start, limit, resume, fn, ctx);
+	while (t < limit && t + frame_samples <= nsamples) {
+		float metric[16];
+		float threshold = d->threshold, q, next;
+		struct tracker tr;
+		unsigned int i, errors;
+		double first;
+
+		if (timing && timing->locked) {
+			double due = timing->start + timing->period;
+
+			if (t > due + window)
+				timing->locked = 0;
+			else if (t + window >= due)
+				threshold *= 0.5f;
+		}
+		q = sync_correlation(iq + 2 * t, d->osr, d->code[1]);
+		if (q < threshold) {
+			t++;
+			continue;
+		}
+		while (t + frame_samples < nsamples &&
+		       (next = sync_correlation(iq + 2 * (t + 1), d->osr, d->code[1])) > q) {
+			q = next;
+			t++;
+		}
+		if (t >= limit)
+			break;
+
+		// The first symbol moves the position all the way to its peak
+		tr.pos = t;
+		tr.drift = timing ? timing->drift : 0.0;
+		track_symbol(d, iq, nsamples, &tr, 1.0);
+		first = tr.pos - symbol_samples - tr.drift;
+		for (i = 1; i < PREAMBLE_BITS; i++) {
+			float m = track_symbol(d, iq, nsamples, &tr, TRACK_GAIN);
+
+			if ((m > 0.0f) != ((PREAMBLE >> (PREAMBLE_BITS - 1 - i)) & 1))
+				break;
+		}
+		if (i < PREAMBLE_BITS) {
+			t++;
+			continue;
+		}
+		for (i = 0; i < 16; i++)
+			metric[i] = track_symbol(d, iq, nsamples, &tr, TRACK_GAIN);
+		for (i = 0, errors = 0; i < POSTAMBLE_BITS; i++) {
+			float m = track_symbol(d, iq, nsamples, &tr, TRACK_GAIN);
+
+			errors += (m > 0.0f) != ((POSTAMBLE >> (POSTAMBLE_BITS - 1 - i)) & 1);
+		}
+		if (errors > POSTAMBLE_ERRORS) {
+			t++;
+			continue;
+		}
+
+		if (timing) {
+			timing->locked = timing->period > 0.0 &&
+			                 fabs(first - timing->start - timing->period) <= window;
+			timing->period = first - timing->start;
+			timing->start = first;
+			timing->drift = tr.drift;
+		}
+		memset(&frame, 0, sizeof(frame));
+		frame.sample = t;
+		frame.end = t + frame_samples;
+		frame.mode = FRAME_SPREAD;
+		frame.prn0 = d->prn0;
+		frame.prn1 = d->prn1;
+		frame.length = 1;
+		frame.quality = q;
+		frame.clock = tr.drift ? -tr.drift / symbol_samples * 1e6 : 0.0;
+		for (i = 0; i < 16; i++)
+			frame.hard = frame.hard << 1 | (metric[i] > 0.0f);
+		errors = fec_decode_soft(metric, &frame.bytes[0]);
+		if (errors > FEC_CORRECTABLE)
+			frame.bad = 1;
+		else
+			frame.corrected = errors;
+		fn(&frame, ctx);
+		frames++;
+		t += frame_samples;
+	}
+	if (resume)
+		*resume = t;
+	return frames;
+}
+
+long spread_decode(const struct spread_decoder *d, const float *samples,
+                   unsigned long nsamples, unsigned long limit, frame_fn fn, void *ctx)
+{
+	float *iq = chip_sums(samples, nsamples, d->osr);
+	struct spread_timing timing;
+	long frames;
+
+	if (!iq)
+		return -1;
+	nsamples = nsamples < d->osr ? 0 : nsamples - (d->osr - 1);
+	memset(&timing, 0, sizeof(timing));
+	frames = spread_decode_chips(d, iq, nsamples, 0, limit, NULL, &timing, fn, ctx);
+	free(iq);
+	return frames;
+}
@@ -0,0 +1,399 @@
+/*
+  store.c - Frames of a mission from every ground station.
+
+  Frames are appended to one array as they are ingested, their bytes to
+  one arena, so that millions take a few allocations. store_index() sorts
+  them by sprite, time and station, unless a saved store left them so, and
+  lists the sprites with the run of frames of each, so that a range query
+  is a binary search for the sprite and one for the time.
+
+  The receptions of a frame by several stations differ in time by their
+  clocks and the paths to the sprite, milliseconds, while frames of a sprite
+  are at least one frame apart. Receptions less than a window apart are
+  merged into one frame: its length and each of its bytes is the value of
+  the most votes of the receptions that have it, ties going to the value of
+  the most confidence.
+
+  A saved store is a header, the station names, the frames and the bytes,
+  in host byte order.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "ground.h"
+
+#define STORE_MAGIC "SPRSTOR1"
+
+struct store_header {
+	char magic[8];
+	uint32_t nstations;
+	uint32_t frame_size;        // sizeof(struct store_frame)
+	uint64_t nframes, nbytes;
+};
+
+void store_init(struct store *s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+void store_free(struct store *s)
+{
+	free(s->frames);
+	free(s->bytes);
+	free(s->sprites);
+	store_init(s);
+}
+
+// Index of a station, or -1 if it is not in the store
+static int find_station(const struct store *s, const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < s->nstations; i++) {
+		if (strncmp(s->stations[i], name, STORE_STATION_NAME - 1) == 0)
+			return i;
+	}
+	return -1;
+}
+
+int store_station(struct store *s, const char *name)
+{
+	int i = find_station(s, name);
+
+	if (i >= 0)
+		return i;
+	if (s->nstations == STORE_MAX_STATIONS)
+		return -1;
+	strncpy(s->stations[s->nstations], name, STORE_STATION_NAME - 1);
+	return s->nstations++;
+}
+
+// Room for need elements of size, doubling up to the most that fit in
+// the address space
+static int reserve(void **p, unsigned long *max, unsigned long need, size_t size)
+{
+	unsigned long most = ULONG_MAX / size, n = *max ? *max : 4096;
+	void *q;
+
+	if (need <= *max)
+		return 0;
+	if (need > most)
+		return -1;
+	while (n < need)
+		n = n > most / 2 ? most : n * 2;
+	q = realloc(*p, n * size);
+	if (!q)
+		return -1;
+	*p = q;
+	*max = n;
+	return 0;
+}
+
+int store_add(struct store *s, unsigned int station, int64_t time,
+              const struct ground_frame *frame)
+{
+	struct store_frame *f;
+
+	// The offsets of the bytes are 32-bit
+	if (frame->length > FRAME_MAX_LENGTH || frame->length > UINT32_MAX - s->nbytes)
+		return -1;
+	if (reserve((void **)&s->frames, &s->maxframes, s->nframes + 1, sizeof(*s->frames)) ||
+	    reserve((void **)&s->bytes, &s->maxbytes, s->nbytes + frame->length, 1))
+		return -1;
+	f = &s->frames[s->nframes++];
+	f->time = time;
+	f->sprite = STORE_SPRITE(frame->prn0, frame->prn1);
+	f->bytes = s->nbytes;
+	f->quality = frame->quality;
+	f->station = station;
+	f->length = frame->length;
+	f->corrected = frame->corrected;
+	f->bad = frame->bad;
+	memcpy(s->bytes + s->nbytes, frame->bytes, frame->length);
+	s->nbytes += frame->length;
+	s->indexed = 0;
+	return 0;
+}
+
+static int compare_frames(const void *pa, const void *pb)
+{
+	const struct store_frame *a = pa, *b = pb;
+
+	if (a->sprite != b->sprite)
+		return a->sprite < b->sprite ? -1 : 1;
+	if (a->time != b->time)
+		return a->time < b->time ? -1 : 1;
+	return (int)a->station - (int)b->station;
+}
+
+int store_index(struct store *s)
+{
+	unsigned long f;
+	unsigned int n;
+
+	if (s->indexed)
+		return 0;
+	// A saved store loaded alone is in order already
+	for (f = 1; f < s->nframes; f++) {
+		if (compare_frames(&s->frames[f - 1], &s->frames[f]) > 0) {
+			qsort(s->frames, s->nframes, sizeof(*s->frames), compare_frames);
+			break;
+		}
+	}
+
+	for (f = 0, n = 0; f < s->nframes; f++)
+		n += f == 0 || s->frames[f].sprite != s->frames[f - 1].sprite;
+	free(s->sprites);
+	s->sprites = malloc((n ? n : 1) * sizeof(*s->sprites));
+	if (!s->sprites)
+		return -1;
+	s->nsprites = 0;
+	for (f = 0; f < s->nframes; f++) {
+		if (f == 0 || s->frames[f].sprite != s->frames[f - 1].sprite) {
+			s->sprites[s->nsprites].sprite = s->frames[f].sprite;
+			s->sprites[s->nsprites].first = f;
+			s->sprites[s->nsprites].count = 0;
+			s->nsprites++;
+		}
+		s->sprites[s->nsprites - 1].count++;
+	}
+	s->indexed = 1;
+	return 0;
+}
+
+// First of n frames at or after time
+static unsigned long lower_bound(const struct store_frame *frames, unsigned long n,
+                                 int64_t time)
+{
+	unsigned long lo = 0, hi = n;
+
+	while (lo < hi) {
+		unsigned long mid = lo + (hi - lo) / 2;
+
+		if (frames[mid].time < time)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+unsigned long store_range(const struct store *s, uint32_t sprite, int64_t from, int64_t until,
+                          const struct store_frame **first)
+{
+	unsigned int lo = 0, hi = s->nsprites;
+	const struct store_frame *frames;
+	unsigned long a, b;
+
+	*first = s->frames;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (s->sprites[mid].sprite < sprite)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == s->nsprites || s->sprites[lo].sprite != sprite || until <= from)
+		return 0;
+	frames = s->frames + s->sprites[lo].first;
+	a = lower_bound(frames, s->sprites[lo].count, from);
+	b = lower_bound(frames, s->sprites[lo].count, until);
+	*first = frames + a;
+	return b - a;
+}
+
+struct ballot {
+	double votes[256];
+	double confidence[256];
+};
+
+// Length of a reception, within the bytes of a merged frame. load() and
+// store_add() keep it so; this only guards the ballot and the merged frame.
+static unsigned int length(const struct store_frame *f)
+{
+	return f->length < FRAME_MAX_LENGTH ? f->length : FRAME_MAX_LENGTH;
+}
+
+static double confidence(const struct store_frame *f)
+{
+	return f->quality / (1.0 + f->bad);
+}
+
+// Value of the most votes of the receptions that have one at a byte
+// position, or of their lengths at position -1, with its votes and those of
+// all values. The ballot is left cleared.
+static unsigned int elect(struct ballot *b, const struct store_frame *rx, unsigned int n,
+                          const uint8_t *bytes, int position, unsigned int method,
+                          double *won, double *total)
+{
+	unsigned int i, v, best = 0;
+	int found = 0;
+
+	*total = 0.0;
+	for (i = 0; i < n; i++) {
+		if (position >= (int)length(&rx[i]))
+			continue;
+		v = position < 0 ? length(&rx[i]) : bytes[rx[i].bytes + position];
+		b->votes[v] += method == STORE_CONFIDENCE ? confidence(&rx[i]) : 1.0;
+		b->confidence[v] += confidence(&rx[i]);
+		*total += method == STORE_CONFIDENCE ? confidence(&rx[i]) : 1.0;
+	}
+	for (i = 0; i < n; i++) {
+		if (position >= (int)length(&rx[i]))
+			continue;
+		v = position < 0 ? length(&rx[i]) : bytes[rx[i].bytes + position];
+		if (!found || b->votes[v] > b->votes[best] ||
+		    (b->votes[v] == b->votes[best] && b->confidence[v] > b->confidence[best])) {
+			best = v;
+			found = 1;
+		}
+	}
+	*won = b->votes[best];
+	for (i = 0; i < n; i++) {
+		if (position >= (int)length(&rx[i]))
+			continue;
+		v = position < 0 ? length(&rx[i]) : bytes[rx[i].bytes + position];
+		b->votes[v] = 0.0;
+		b->confidence[v] = 0.0;
+	}
+	return best;
+}
+
+static void merge(const struct store *s, const struct store_frame *rx, unsigned int n,
+                  unsigned int method, struct store_merged *m)
+{
+	struct ballot b = { { 0 } };
+	double won, total, all_won = 0.0, all = 0.0;
+	unsigned int i;
+	int k;
+
+	memset(m, 0, sizeof(*m));
+	m->time = rx[0].time;
+	m->sprite = rx[0].sprite;
+	m->receptions = n;
+	for (i = 0; i < n; i++) {
+		m->stations |= 1u << rx[i].station;
+		if (rx[i].quality > m->quality)
+			m->quality = rx[i].quality;
+	}
+	m->length = elect(&b, rx, n, s->bytes, -1, method, &won, &total);
+	for (k = 0; k < (int)m->length; k++) {
+		m->bytes[k] = elect(&b, rx, n, s->bytes, k, method, &won, &total);
+		m->disputed += won < total;
+		all_won += won;
+		all += total;
+	}
+	m->agreement = all > 0.0 ? all_won / all : 1.0;
+}
+
+unsigned long store_merge(const struct store *s, uint32_t sprite, int64_t from,
+                          int64_t until, int64_t window, unsigned int method,
+                          merged_fn fn, void *ctx)
+{
+	const struct store_frame *rx;
+	unsigned long n = store_range(s, sprite, from, until, &rx), i, j, merged = 0;
+	struct store_merged m;
+
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n && rx[j].time - rx[i].time < window; j++)
+			;
+		merge(s, rx + i, j - i, method, &m);
+		fn(&m, ctx);
+		merged++;
+	}
+	return merged;
+}
+
+int store_save(const struct store *s, const char *path)
+{
+	struct store_header h;
+	FILE *fp = fopen(path, "wb");
+	int ok;
+
+	if (!fp)
+		return -1;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, STORE_MAGIC, sizeof(h.magic));
+	h.nstations = s->nstations;
+	h.frame_size = sizeof(struct store_frame);
+	h.nframes = s->nframes;
+	h.nbytes = s->nbytes;
+	ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+	     fwrite(s->stations, STORE_STATION_NAME, s->nstations, fp) == s->nstations &&
+	     fwrite(s->frames, sizeof(*s->frames), s->nframes, fp) == s->nframes &&
+	     fwrite(s->bytes, 1, s->nbytes, fp) == s->nbytes;
+	if (fclose(fp))
+		ok = 0;
+	return ok ? 0 : -1;
+}
+
+// The frames of a saved store, after those of s. The header and every frame
+// are checked before the stations are added, so that a bad store leaves s
+// as it was.
+static int load(struct store *s, FILE *fp)
+{
+	char names[STORE_MAX_STATIONS][STORE_STATION_NAME];
+	int station[STORE_MAX_STATIONS];
+	struct store_header h;
+	unsigned long f, first = s->nframes;
+	unsigned int i, j, added = 0;
+
+	if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, STORE_MAGIC, sizeof(h.magic)) ||
+	    h.frame_size != sizeof(struct store_frame) || h.nstations > STORE_MAX_STATIONS ||
+	    h.nframes > ULONG_MAX - s->nframes || h.nbytes > UINT32_MAX - s->nbytes ||
+	    fread(names, STORE_STATION_NAME, h.nstations, fp) != h.nstations)
+		return -1;
+	if (reserve((void **)&s->frames, &s->maxframes, s->nframes + h.nframes,
+	            sizeof(*s->frames)) ||
+	    reserve((void **)&s->bytes, &s->maxbytes, s->nbytes + h.nbytes, 1) ||
+	    fread(s->frames + first, sizeof(*s->frames), h.nframes, fp) != h.nframes ||
+	    fread(s->bytes + s->nbytes, 1, h.nbytes, fp) != h.nbytes)
+		return -1;
+	for (f = first; f < first + h.nframes; f++) {
+		const struct store_frame *sf = &s->frames[f];
+
+		if (sf->station >= h.nstations || sf->length > FRAME_MAX_LENGTH ||
+		    sf->bytes > h.nbytes || sf->length > h.nbytes - sf->bytes)
+			return -1;
+	}
+
+	// Room for the stations new to this store, each counted once
+	for (i = 0; i < h.nstations; i++) {
+		names[i][STORE_STATION_NAME - 1] = '\0';
+		for (j = 0; j < i && strcmp(names[j], names[i]); j++)
+			;
+		added += j == i && find_station(s, names[i]) < 0;
+	}
+	if (s->nstations + added > STORE_MAX_STATIONS)
+		return -1;
+
+	// Onto the stations and arena of this store
+	for (i = 0; i < h.nstations; i++)
+		station[i] = store_station(s, names[i]);
+	for (f = first; f < first + h.nframes; f++) {
+		struct store_frame *sf = &s->frames[f];
+
+		sf->station = station[sf->station];
+		sf->bytes += s->nbytes;
+	}
+	s->nframes += h.nframes;
+	s->nbytes += h.nbytes;
+	s->indexed = 0;
+	return 0;
+}
+
+int store_load(struct store *s, const char *path)
+{
+	FILE *fp = fopen(path, "rb");
+	int r;
+
+	if (!fp)
+		return -1;
+	r = load(s, fp);
+	fclose(fp);
+	return r;
+}
@@ -0,0 +1,221 @@
+/*
+  stream.c - Decode samples as they arrive.
+
+  Each sample is summed with the osr - 1 before it into the chip sum
+  buffer. After every block each channel searches on from where it stopped
+  to where the lookahead of its decoder has arrived: a spread frame is
+  found once it has been received whole, a CSK frame once its length has,
+  and its search then stops until the rest has. A frame found is reported
+  at once, with the time since the arrival of its last sample.
+
+  The buffer holds the longest frame twice and a block, so that shifting
+  it down to the earliest sample a channel resumes from always frees a
+  block or more. Nothing is allocated after stream_init().
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ground.h"
+
+int stream_init(struct stream *s, const struct channel *channels, unsigned int nchannels,
+                unsigned long block, unsigned long maxlatency, stream_fn fn, void *ctx)
+{
+	unsigned long span = 0;
+	unsigned int c;
+
+	memset(s, 0, sizeof(*s));
+	if (nchannels == 0 || nchannels > MAX_CHANNELS || block == 0)
+		return -1;
+	s->osr = channel_osr(&channels[0]);
+	for (c = 0; c < nchannels; c++) {
+		if (channel_osr(&channels[c]) != s->osr)
+			return -1;
+		if (channel_span(&channels[c]) > span)
+			span = channel_span(&channels[c]);
+	}
+	if (s->osr > STREAM_MAX_OSR)
+		return -1;
+
+	s->channels = channels;
+	s->nchannels = nchannels;
+	s->cap = 2 * span + block;
+	s->iq = malloc(2 * s->cap * sizeof(*s->iq));
+	s->maxlatency = maxlatency;
+	s->latency = malloc((maxlatency ? maxlatency : 1) * sizeof(*s->latency));
+	s->fn = fn;
+	s->ctx = ctx;
+	if (!s->iq || !s->latency) {
+		stream_free(s);
+		return -1;
+	}
+	return 0;
+}
+
+void stream_free(struct stream *s)
+{
+	free(s->iq);
+	free(s->latency);
+	s->iq = NULL;
+	s->latency = NULL;
+}
+
+// Arrival time of a sample, or of the last block if it is too old
+static double arrival_time(const struct stream *s, unsigned long sample)
+{
+	unsigned int i, slot;
+
+	for (i = 0; i < STREAM_ARRIVALS; i++) {
+		slot = (s->arrival + i) % STREAM_ARRIVALS;
+		if (s->arrivals[slot].end > sample)
+			return s->arrivals[slot].time;
+	}
+	return s->arrivals[(s->arrival + STREAM_ARRIVALS - 1) % STREAM_ARRIVALS].time;
+}
+
+struct report {
+	struct stream *s;
+	unsigned int channel;
+};
+
+static void report(const struct ground_frame *frame, void *ctx)
+{
+	struct report *r = ctx;
+	struct stream *s = r->s;
+	struct ground_frame f = *frame;
+	double latency;
+
+	f.sample += s->base;
+	f.end += s->base;
+	f.channel = r->channel;
+	// The last chip sum of the frame ends osr - 1 samples after it
+	latency = wall_clock() - arrival_time(s, f.end + s->osr - 2);
+	if (s->nlatency < s->maxlatency)
+		s->latency[s->nlatency++] = latency;
+	s->frames++;
+	s->fn(&f, latency, s->ctx);
+}
+
+// Search every channel up to its lookahead, or to the end when flushing
+static void search(struct stream *s, int flush)
+{
+	struct report r;
+	unsigned long lookahead, resume;
+
+	r.s = s;
+	for (r.channel = 0; r.channel < s->nchannels; r.channel++) {
+		const struct channel *c = &s->channels[r.channel];
+		unsigned long start = s->resume[r.channel] - s->base;
+
+		lookahead = flush ? 0 : channel_lookahead(c);
+		if (s->n <= lookahead || start >= s->n - lookahead)
+			continue;
+		channel_decode_chips(c, s->iq, s->n, start, s->n - lookahead, &resume,
+		                     &s->timing[r.channel], report, &r);
+		s->resume[r.channel] = s->base + resume;
+	}
+}
+
+// Drop the chip sums before the earliest sample a channel resumes from
+static void shift(struct stream *s)
+{
+	unsigned long drop = s->n;
+	unsigned int c;
+
+	for (c = 0; c < s->nchannels; c++) {
+		if (s->resume[c] - s->base < drop)
+			drop = s->resume[c] - s->base;
+	}
+	memmove(s->iq, s->iq + 2 * drop, 2 * (s->n - drop) * sizeof(*s->iq));
+	for (c = 0; c < s->nchannels; c++)
+		s->timing[c].start -= drop;
+	s->base += drop;
+	s->n -= drop;
+}
+
+static void append(struct stream *s, float i, float q)
+{
+	float si = 0.0f, sq = 0.0f;
+	unsigned int k;
+
+	s->raw[2 * s->nraw] = i;
+	s->raw[2 * s->nraw + 1] = q;
+	if (++s->nraw < s->osr)
+		return;
+	if (s->n == s->cap) {
+		search(s, 0);
+		shift(s);
+	}
+	for (k = 0; k < s->osr; k++) {
+		si += s->raw[2 * k];
+		sq += s->raw[2 * k + 1];
+	}
+	s->iq[2 * s->n] = si;
+	s->iq[2 * s->n + 1] = sq;
+	s->n++;
+	s->nraw--;
+	memmove(s->raw, s->raw + 2, 2 * s->nraw * sizeof(*s->raw));
+}
+
+void stream_push(struct stream *s, const float *samples, unsigned long nsamples,
+                 double arrival)
+{
+	unsigned long i;
+
+	s->received += nsamples;
+	s->arrivals[s->arrival].end = s->received;
+	s->arrivals[s->arrival].time = arrival;
+	s->arrival = (s->arrival + 1) % STREAM_ARRIVALS;
+
+	for (i = 0; i < nsamples; i++)
+		append(s, samples[2 * i], samples[2 * i + 1]);
+	search(s, 0);
+}
+
+// A gap of up to FEC_CORRECTABLE symbols is filled with zeros, for the FEC
+// to correct the frames across it. After a longer one the search starts
+// afresh.
+void stream_gap(struct stream *s, unsigned long nsamples)
+{
+	unsigned long i;
+	unsigned int c;
+
+	s->dropped += nsamples;
+	s->received += nsamples;
+	if (nsamples <= (unsigned long)FEC_CORRECTABLE * GOLD_CHIPS * s->osr) {
+		for (i = 0; i < nsamples; i++)
+			append(s, 0.0f, 0.0f);
+		return;
+	}
+	stream_finish(s);
+	s->base = s->received;
+	s->n = 0;
+	s->nraw = 0;
+	for (c = 0; c < s->nchannels; c++) {
+		s->resume[c] = s->base;
+		s->timing[c].locked = 0;
+	}
+}
+
+void stream_finish(struct stream *s)
+{
+	search(s, 1);
+}
+
+static int compare_floats(const void *pa, const void *pb)
+{
+	float a = *(const float *)pa, b = *(const float *)pb;
+
+	return a < b ? -1 : a > b;
+}
+
+double stream_latency(struct stream *s, double p)
+{
+	unsigned long i;
+
+	if (s->nlatency == 0)
+		return 0.0;
+	qsort(s->latency, s->nlatency, sizeof(*s->latency), compare_floats);
+	i = p / 100.0 * (s->nlatency - 1) + 0.5;
+	return s->latency[i < s->nlatency ? i : s->nlatency - 1];
+}
@@ -0,0 +1,160 @@
+#ifndef CC1101_CONFIG_H_
+#define CC1101_CONFIG_H_
+
+/* This header derives the CC1101 frequency, data rate and deviation register
+ * values from high-level parameters at compile time, so that the radio
+ * configuration can live in flash as a const CC1101Settings.
+ *
+ * The parameters are normally set from bld/Makefile.options (LIBSPRITE_RF_*),
+ * which allows keeping a profile per mission. The defaults below reproduce
+ * the original hand-computed register values.
+ *
+ * Formulas are from the CC1101 data sheet: http://www.ti.com/lit/ds/symlink/cc1101.pdf
+ */
+
+/* Crystal frequency of the CC430 radio core in Hz */
+#ifndef CONFIG_RF_XOSC_FREQ
+#define CONFIG_RF_XOSC_FREQ 26000000
+#endif
+
+/* Carrier frequency of channel 0 in Hz (0x10D121) */
+#ifndef CONFIG_RF_FREQ
+#define CONFIG_RF_FREQ 437239655
+#endif
+
+/* Chip rate in baud (DRATE_E = 11, DRATE_M = 67) */
+#ifndef CONFIG_RF_DATA_RATE
+#define CONFIG_RF_DATA_RATE 64072
+#endif
+
+/* Frequency deviation in Hz (DEVIATION_E = 0, DEVIATION_M = 7) */
+#ifndef CONFIG_RF_DEVIATION
+#define CONFIG_RF_DEVIATION 2975
+#endif
+
+/* Channel number, spaced by CHANSPC in MDMCFG1/MDMCFG0 (~200 kHz) */
+#ifndef CONFIG_RF_CHANNEL
+#define CONFIG_RF_CHANNEL 0
+#endif
+
+/* Calibrate the frequency synthesizer once per channel and temperature band
+ * and restore the cached results, instead of on every IDLE to TX transition */
+#ifndef CONFIG_FSCAL_CACHE
+#define CONFIG_FSCAL_CACHE 1
+#endif
+
+/* Command uplink (see uplink.h): 2-FSK packets received on the same carrier */
+#ifndef CONFIG_UPLINK_DATA_RATE
+#define CONFIG_UPLINK_DATA_RATE 4800
+#endif
+
+#ifndef CONFIG_UPLINK_DEVIATION
+#define CONFIG_UPLINK_DEVIATION 25391
+#endif
+
+#if CONFIG_RF_FREQ < 300000000 || CONFIG_RF_FREQ > 928000000
+#error CONFIG_RF_FREQ is outside of the CC1101 frequency bands
+#endif
+
+#if CONFIG_RF_DATA_RATE < 600 || CONFIG_RF_DATA_RATE > 500000
+#error CONFIG_RF_DATA_RATE must be between 600 and 500000 baud
+#endif
+
+#if CONFIG_RF_DEVIATION < 1587 || CONFIG_RF_DEVIATION > 380859
+#error CONFIG_RF_DEVIATION must be between 1587 Hz and 380859 Hz
+#endif
+
+#if CONFIG_UPLINK_DATA_RATE < 600 || CONFIG_UPLINK_DATA_RATE > 500000
+#error CONFIG_UPLINK_DATA_RATE must be between 600 and 500000 baud
+#endif
+
+#if CONFIG_UPLINK_DEVIATION < 1587 || CONFIG_UPLINK_DEVIATION > 380859
+#error CONFIG_UPLINK_DEVIATION must be between 1587 Hz and 380859 Hz
+#endif
+
+#if CONFIG_RF_CHANNEL < 0 || CONFIG_RF_CHANNEL > 255
+#error CONFIG_RF_CHANNEL must fit in the CHANNR register
+#endif
+
+#define CC1101_XOSC ((unsigned long long)CONFIG_RF_XOSC_FREQ)
+
+/* floor(log2(x)) for 0 < x < 2^16 */
+#define CC1101_LOG2(x) \
+	((x) >= (1ULL << 15) ? 15 : (x) >= (1ULL << 14) ? 14 : \
+	 (x) >= (1ULL << 13) ? 13 : (x) >= (1ULL << 12) ? 12 : \
+	 (x) >= (1ULL << 11) ? 11 : (x) >= (1ULL << 10) ? 10 : \
+	 (x) >= (1ULL << 9)  ?  9 : (x) >= (1ULL << 8)  ?  8 : \
+	 (x) >= (1ULL << 7)  ?  7 : (x) >= (1ULL << 6)  ?  6 : \
+	 (x) >= (1ULL << 5)  ?  5 : (x) >= (1ULL << 4)  ?  4 : \
+	 (x) >= (1ULL << 3)  ?  3 : (x) >= (1ULL << 2)  ?  2 : \
+	 (x) >= (1ULL << 1)  ?  1 : 0)
+
+/* Rounded integer division */
+#define CC1101_DIV_ROUND(n, d) (((n) + (d) / 2) / (d))
+
+/*----------------------FREQUENCY------------------------------------
+ * f_carrier = f_xosc / 2^16 * FREQ
+ */
+#define CC1101_FREQ \
+	CC1101_DIV_ROUND((unsigned long long)CONFIG_RF_FREQ << 16, CC1101_XOSC)
+
+#define CC1101_FREQ2 ((unsigned char)(CC1101_FREQ >> 16))
+#define CC1101_FREQ1 ((unsigned char)(CC1101_FREQ >> 8))
+#define CC1101_FREQ0 ((unsigned char)(CC1101_FREQ))
+
+/*----------------------DATA RATE------------------------------------
+ * R = (256 + DRATE_M) * 2^DRATE_E * f_xosc / 2^28
+ */
+#define CC1101_DRATE_E_(rate) \
+	CC1101_LOG2(((unsigned long long)(rate) << 20) / CC1101_XOSC)
+#define CC1101_DRATE_M_(rate) \
+	(CC1101_DIV_ROUND((unsigned long long)(rate) << 28, \
+	                  CC1101_XOSC << CC1101_DRATE_E_(rate)) - 256)
+
+/* Rounding the mantissa up to 256 carries into the exponent */
+#define CC1101_DRATE_E_FOR(rate) \
+	(CC1101_DRATE_M_(rate) >= 256 ? CC1101_DRATE_E_(rate) + 1 : CC1101_DRATE_E_(rate))
+#define CC1101_DRATE_M_FOR(rate) \
+	(CC1101_DRATE_M_(rate) >= 256 ? 0 : CC1101_DRATE_M_(rate))
+
+#define CC1101_DRATE_E CC1101_DRATE_E_FOR(CONFIG_RF_DATA_RATE)
+#define CC1101_DRATE_M CC1101_DRATE_M_FOR(CONFIG_RF_DATA_RATE)
+
+/*----------------------DEVIATION------------------------------------
+ * f_dev = f_xosc / 2^17 * (8 + DEVIATION_M) * 2^DEVIATION_E
+ */
+#define CC1101_DEVIATN_E_(dev) \
+	CC1101_LOG2(((unsigned long long)(dev) << 14) / CC1101_XOSC)
+#define CC1101_DEVIATN_M_(dev) \
+	(CC1101_DIV_ROUND((unsigned long long)(dev) << 17, \
+	                  CC1101_XOSC << CC1101_DEVIATN_E_(dev)) - 8)
+
+#define CC1101_DEVIATN_FOR(dev) ((unsigned char)(CC1101_DEVIATN_M_(dev) >= 8 ? \
+	(CC1101_DEVIATN_E_(dev) + 1) << 4 : \
+	(CC1101_DEVIATN_E_(dev) << 4) | CC1101_DEVIATN_M_(dev)))
+
+/*----------------------REGISTERS------------------------------------
+ * Channel bandwidth in MDMCFG4[7:4] is kept at 812 kHz (0x0).
+ */
+#define CC1101_MDMCFG4 ((unsigned char)(0x00 | CC1101_DRATE_E))
+#define CC1101_MDMCFG3 ((unsigned char)(CC1101_DRATE_M))
+#define CC1101_DEVIATN CC1101_DEVIATN_FOR(CONFIG_RF_DEVIATION)
+#define CC1101_CHANNR  ((unsigned char)(CONFIG_RF_CHANNEL))
+
+/* The uplink receiver filter is 102 kHz wide (MDMCFG4[7:4] = 0xC), enough
+ * for the deviation and the Doppler shift in low Earth orbit */
+#define CC1101_UPLINK_MDMCFG4 \
+	((unsigned char)(0xC0 | CC1101_DRATE_E_FOR(CONFIG_UPLINK_DATA_RATE)))
+#define CC1101_UPLINK_MDMCFG3 \
+	((unsigned char)(CC1101_DRATE_M_FOR(CONFIG_UPLINK_DATA_RATE)))
+#define CC1101_UPLINK_DEVIATN CC1101_DEVIATN_FOR(CONFIG_UPLINK_DEVIATION)
+
+/* MCSM0: FS_AUTOCAL = 1 (calibrate when going from IDLE to TX) unless the
+ * calibration cache is used, PO_TIMEOUT = 64 cycles */
+#if CONFIG_FSCAL_CACHE
+#define CC1101_MCSM0   ((unsigned char)0x08)
+#else
+#define CC1101_MCSM0   ((unsigned char)0x18)
+#endif
+
+#endif
@@ -9,14 +9,19 @@
 
 #include "cc430f5137.h"
 #include "CC430Radio.h"
+#include "ClockConfig.h"
+#include "instrument.h"
 
-static void __inline__ delayClockCycles(register unsigned int n);
+// Erratum RF1A7: wait at least 810 us after the core reports chip ready on
+// wake-up from SLEEP or XOFF before issuing the next instruction
+#define RF1A7_WAKE_DELAY_US 810
 
 // Send a command to the radio - adapted from TI example code: http://www.ti.com/lit/an/slaa465b/slaa465b.pdf
 unsigned char strobe(unsigned char command)
 {
 	unsigned char status_byte = 0;
 	unsigned int  gdo_state;
+	INSTRUMENT_BEGIN(span);
 	
 	// Check for valid strobe command 
 	if((command == 0xBD) || ((command >= RF_SRES) && (command <= RF_SNOP)))
@@ -25,10 +30,17 @@ unsigned char strobe(unsigned char command)
     	RF1AIFCTL1 &= ~(RFSTATIFG);    
     
     	// Wait for radio to be ready for next instruction
-    	while( !(RF1AIFCTL1 & RFINSTRIFG));
+    	while( !(RF1AIFCTL1 & RFINSTRIFG)) INSTRUMENT_SPIN(span);
     
     	// Write the strobe instruction
-    	if ((command > RF_SRES) && (command < RF_SNOP))
+    	if ((command == RF_SXOFF) || (command == RF_SPWD) || (command == RF_SWOR))
+    	{
+    		// Nothing to wait for when powering down, and touching IOCFG2
+    		// afterwards would wake the core up again
+    		RF1AINSTRB = command;
+    		while( !(RF1AIFCTL1 & RFSTATIFG) ) INSTRUMENT_SPIN(span);
+    	}
+    	else if ((command > RF_SRES) && (command < RF_SNOP))
     	{
       		gdo_state = readRegister(IOCFG2);    // buffer IOCFG2 state
       		writeRegister(IOCFG2, 0x29);         // chip-ready to GDO2
@@ -36,16 +48,12 @@ unsigned char strobe(unsigned char command)
       		RF1AINSTRB = command; 
       		if ( (RF1AIN&0x04)== 0x04 )           // chip at sleep mode
       		{
-        		if ( (command == RF_SXOFF) || (command == RF_SPWD) || (command == RF_SWOR) ) { }
-        		else  	
-        		{
-          			while ((RF1AIN&0x04)== 0x04);     // chip-ready ?
-          			delayClockCycles(6480); // Delay for ~810usec at 8MHz CPU clock, see erratum RF1A7
-        		}
+      			while ((RF1AIN&0x04)== 0x04);     // chip-ready ?
+      			__delay_cycles(CLOCK_US_TO_CYCLES(RF1A7_WAKE_DELAY_US)); // see erratum RF1A7
       		}
       		writeRegister(IOCFG2, gdo_state);    // restore IOCFG2 setting
     
-      		while( !(RF1AIFCTL1 & RFSTATIFG) );
+      		while( !(RF1AIFCTL1 & RFSTATIFG) ) INSTRUMENT_SPIN(span);
     	}
 		else		                    // chip active mode (SRES)
     	{	
@@ -53,6 +61,7 @@ unsigned char strobe(unsigned char command)
     	}
 		status_byte = RF1ASTATB;
 	}
+	INSTRUMENT_END(span, PROBE_RF_STROBE);
 	return status_byte;
 }
 
@@ -66,6 +75,7 @@ void reset(void) {
 unsigned char readRegister(unsigned char address) {
 	
 	unsigned char data_out;
+	INSTRUMENT_BEGIN(span);
 
 	// Check for valid configuration register address, 0x3E refers to PATABLE 
 	if ((address <= 0x2E) || (address == 0x3E))
@@ -79,39 +89,44 @@ unsigned char readRegister(unsigned char address) {
 		RF1AINSTR1B = (address | RF_STATREGRD);
 	}
 
-	while (!(RF1AIFCTL1 & RFDOUTIFG) );
+	while (!(RF1AIFCTL1 & RFDOUTIFG) ) INSTRUMENT_SPIN(span);
 	data_out = RF1ADOUTB;  // Read data and clear the RFDOUTIFG
 
+	INSTRUMENT_END(span, PROBE_RF_READ);
 	return data_out;
 }
 
 
 // Write a single byte to the radio register - adapted from TI example code: http://www.ti.com/lit/an/slaa465b/slaa465b.pdf
 void writeRegister(unsigned char address, unsigned char value) {
+	INSTRUMENT_BEGIN(span);
 	
-	while (!(RF1AIFCTL1 & RFINSTRIFG));  // Wait for the Radio to be ready for next instruction
+	while (!(RF1AIFCTL1 & RFINSTRIFG)) INSTRUMENT_SPIN(span);  // Wait for the Radio to be ready for next instruction
 	RF1AINSTRB = (address | RF_SNGLREGWR);	// Send address + instruction
 
 	RF1ADINB = value;  // Write data
 
 	__nop();
+	INSTRUMENT_END(span, PROBE_RF_WRITE);
 }
 
 // Write data to the transmit FIFO buffer. Max length is 64 bytes.
-void writeTXBuffer(unsigned char *data, unsigned char length) {
+void writeTXBuffer(const unsigned char *data, unsigned char length) {
 	
 	// Write Burst works wordwise not bytewise - known errata
 	unsigned char i;
+	INSTRUMENT_BEGIN(span);
 
-	while (!(RF1AIFCTL1 & RFINSTRIFG));       // Wait for the Radio to be ready for next instruction
+	while (!(RF1AIFCTL1 & RFINSTRIFG)) INSTRUMENT_SPIN(span);       // Wait for the Radio to be ready for next instruction
 	RF1AINSTRW = ((RF_TXFIFOWR | RF_REGWR)<<8 ) + data[0]; // Send address + instruction
 
 	for (i = 1; i < length; i++)
 	{
 	  RF1ADINB = data[i];                   // Send data
-	  while (!(RFDINIFG & RF1AIFCTL1));     // Wait for TX to finish
+	  while (!(RFDINIFG & RF1AIFCTL1)) INSTRUMENT_SPIN(span);     // Wait for TX to finish
 	} 
 	i = RF1ADOUTB;                          // Reset RFDOUTIFG flag which contains status byte
+	INSTRUMENT_END(span, PROBE_RF_TXFIFO);
 	
 }
 
@@ -120,16 +135,18 @@ void writeTXBufferZeros(unsigned char length) {
   
   // Write Burst works wordwise not bytewise - known errata
   unsigned char i;
+  INSTRUMENT_BEGIN(span);
 
-  while (!(RF1AIFCTL1 & RFINSTRIFG));       // Wait for the Radio to be ready for next instruction
+  while (!(RF1AIFCTL1 & RFINSTRIFG)) INSTRUMENT_SPIN(span);       // Wait for the Radio to be ready for next instruction
   RF1AINSTRW = ((RF_TXFIFOWR | RF_REGWR)<<8 ) + 0; // Send address + instruction
 
   for (i = 1; i < length; i++)
   {
     RF1ADINB = 0;                           // Send data
-    while (!(RFDINIFG & RF1AIFCTL1));       // Wait for TX to finish
+    while (!(RFDINIFG & RF1AIFCTL1)) INSTRUMENT_SPIN(span);       // Wait for TX to finish
   } 
   i = RF1ADOUTB;                            // Reset RFDOUTIFG flag which contains status byte
+  INSTRUMENT_END(span, PROBE_RF_TXFIFO);
   
 }
 
@@ -152,7 +169,7 @@ void readRXBuffer(unsigned char *data, unsigned char length) {
 }
 
 // Write the RF configuration settings to the radio - adapted from TI example code: http://www.ti.com/lit/an/slaa465b/slaa465b.pdf
-void writeConfiguration(CC1101Settings *settings) {
+void writeConfiguration(const CC1101Settings *settings) {
 	writeRegister(FSCTRL1,  settings->fsctrl1);
     writeRegister(FSCTRL0,  settings->fsctrl0);
     writeRegister(FREQ2,    settings->freq2);
@@ -218,13 +235,4 @@ void writePATable(unsigned char value) {
 	}
 }
 
-static void __inline__ delayClockCycles(register unsigned int n)
-{
-    __asm__ __volatile__ (
-                "1: \n"
-                " dec        %[n] \n"
-                " jne        1b \n"
-        : [n] "+r"(n));
-}
-
 //CC430Radio Radio;
@@ -0,0 +1,145 @@
+#ifndef CLOCK_CONFIG_H_
+#define CLOCK_CONFIG_H_
+
+/* This header derives the UCS and PMM settings of the main clock, and every
+ * constant counted in its cycles, from the clock frequency at compile time.
+ *
+ * MCLK and SMCLK run from DCOCLKDIV: the FLL locks DCOCLK to twice the
+ * clock frequency against REFO (32768 Hz) and divides it by 2, so the clock
+ * is the multiple of 32768 Hz nearest to F_CPU, within 0.2%. Delays and
+ * timer constants are computed from F_CPU itself.
+ *
+ * F_CPU is normally set from bld/Makefile.options (LIBSPRITE_CLOCK_FREQ).
+ * Clock system formulas and limits are from the CC430 family user's guide
+ * (SLAU259) and the CC430F513x data sheet.
+ */
+
+/* Main clock frequency in Hz, a whole number of MHz */
+#ifndef F_CPU
+#define F_CPU 8000000L
+#endif
+
+/* Configure the clock system in SpriteRadio_SpriteRadio(). Set to 0 when the
+ * application sets up MCLK and SMCLK at F_CPU itself. */
+#ifndef CONFIG_CLOCK_INIT
+#define CONFIG_CLOCK_INIT 1
+#endif
+
+/* ACLK source: SELA__VLOCLK, the VLO of about 9.4 kHz (6 to 14 kHz), or
+ * SELA__REFOCLK, 32768 Hz within 3.5%. The watchdog runs from ACLK while
+ * delay() sleeps in LPM3, where the VLO costs less current. */
+#ifndef CONFIG_CLOCK_ACLK
+#define CONFIG_CLOCK_ACLK SELA__VLOCLK
+#endif
+
+/* Measure ACLK against the DCO again when the last measurement is older */
+#ifndef CONFIG_ACLK_CAL_MAX_AGE_MS
+#define CONFIG_ACLK_CAL_MAX_AGE_MS 60000UL
+#endif
+
+#if F_CPU < 1000000L || F_CPU > 20000000L
+#error F_CPU must be between 1 MHz and 20 MHz
+#endif
+
+#if F_CPU % 1000000L
+#error F_CPU must be a whole number of MHz
+#endif
+
+#define CLOCK_REFO_FREQ 32768UL
+
+#define CLOCK_CYCLES_PER_US (F_CPU / 1000000UL)
+#define CLOCK_CYCLES_PER_MS (F_CPU / 1000UL)
+
+/* CPU cycles of a delay in microseconds, for __delay_cycles() */
+#define CLOCK_US_TO_CYCLES(us) ((unsigned long)(us) * CLOCK_CYCLES_PER_US)
+
+/* FLL multiplier: DCOCLKDIV = (FLLN + 1) * REFO */
+#define CLOCK_FLLN ((F_CPU + CLOCK_REFO_FREQ / 2) / CLOCK_REFO_FREQ - 1)
+
+/* DCO range whose guaranteed span holds DCOCLK = 2 * F_CPU on any part: the
+ * highest DCO(n, 0) and the lowest DCO(n, 31) of the data sheet bound it,
+ * 0.75-3.17, 1.51-6.07, 3.2-12.3, 6.0-23.7, 10.7-39.0 and 19.6-60 MHz for
+ * ranges 2 to 7. Above 32 MHz range 6 would leave the FLL too little room
+ * below its top tap, so that a slow part rails at DCO = 31 and never locks. */
+#if F_CPU <= 1000000L
+#define CLOCK_DCORSEL DCORSEL_2
+#elif F_CPU <= 2000000L
+#define CLOCK_DCORSEL DCORSEL_3
+#elif F_CPU <= 4000000L
+#define CLOCK_DCORSEL DCORSEL_4
+#elif F_CPU <= 9000000L
+#define CLOCK_DCORSEL DCORSEL_5
+#elif F_CPU <= 16000000L
+#define CLOCK_DCORSEL DCORSEL_6
+#else
+#define CLOCK_DCORSEL DCORSEL_7
+#endif
+
+/* Worst case settling time of the DCO after a range change, 32 x 32 periods
+ * of the FLL reference */
+#define CLOCK_SETTLE_CYCLES (32UL * 32UL * (CLOCK_FLLN + 1))
+
+/* Core voltage level: the highest MCLK of levels 0 to 3 is 8, 12, 16 and
+ * 20 MHz, and the radio core needs level 2 at least */
+#define CLOCK_RADIO_VCORE 2
+
+#if F_CPU > 16000000L
+#define CLOCK_VCORE 3
+#elif F_CPU > 12000000L
+#define CLOCK_VCORE 2
+#elif F_CPU > 8000000L
+#define CLOCK_VCORE 1
+#else
+#define CLOCK_VCORE 0
+#endif
+
+#if CLOCK_VCORE < CLOCK_RADIO_VCORE
+#undef CLOCK_VCORE
+#define CLOCK_VCORE CLOCK_RADIO_VCORE
+#endif
+
+/* Watchdog interval from SMCLK: every 8192 cycles from 8 MHz, about a
+ * millisecond, and every 512 cycles below */
+#if F_CPU < 8000000L
+#define CLOCK_WDT_TICKS 512
+#define CLOCK_WDT_INTERVAL WDT_MDLY_0_5
+#else
+#define CLOCK_WDT_TICKS 8192
+#define CLOCK_WDT_INTERVAL WDT_MDLY_8
+#endif
+
+/* Time per watchdog interval, in whole milliseconds and microseconds and
+ * the cycles left over, so that millis() and micros() are exact at any
+ * frequency */
+#define CLOCK_WDT_MILLIS  (CLOCK_WDT_TICKS / CLOCK_CYCLES_PER_MS)
+#define CLOCK_WDT_MILLIS_CYCLES (CLOCK_WDT_TICKS % CLOCK_CYCLES_PER_MS)
+#define CLOCK_WDT_MICROS  (CLOCK_WDT_TICKS / CLOCK_CYCLES_PER_US)
+#define CLOCK_WDT_MICROS_CYCLES (CLOCK_WDT_TICKS % CLOCK_CYCLES_PER_US)
+
+/* Timer_A0 times the sleep of sensors_run() from SMCLK / 8: its longest
+ * interval, 65536 ticks, in microseconds, 26 ms at 20 MHz */
+#define CLOCK_TIMER_DIV 8
+#define CLOCK_TIMER_MAX_US (65536UL * CLOCK_TIMER_DIV / CLOCK_CYCLES_PER_US)
+
+/* Watchdog interval from ACLK while sleeping in LPM3: 512 periods, 54 ms of
+ * the VLO or 16 ms of REFO */
+#define CLOCK_WDT_SLEEP_TICKS 512
+#define CLOCK_WDT_SLEEP_INTERVAL WDT_ADLY_16
+
+/* ACLK is measured over intervals of 64 of its periods (WDT_ADLY_1_9), in
+ * SMCLK / 8 ticks of Timer_A1 which do not wrap in one interval down to
+ * 6 kHz at 20 MHz */
+#define CLOCK_ACLK_CAL_INTERVALS 2
+#define CLOCK_ACLK_CAL_TICKS 64
+
+#if CONFIG_CLOCK_ACLK == SELA__REFOCLK
+#define CLOCK_ACLK_MIN_FREQ 31000UL
+#else
+#define CLOCK_ACLK_MIN_FREQ 6000UL
+#endif
+
+/* Shortest delay() worth sleeping in: two sleep intervals of the slowest
+ * ACLK */
+#define CLOCK_SLEEP_MIN_MS (2UL * 1000UL * CLOCK_WDT_SLEEP_TICKS / CLOCK_ACLK_MIN_FREQ)
+
+#endif // CLOCK_CONFIG_H_
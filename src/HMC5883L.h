@@ -7,17 +7,25 @@
 
 #define MAG_ADDRESS 0x1E
 
+/*----------------------REGISTERS------------------------------------*/
+#define MAG_CONFIG_A_REG  0x00
+#define MAG_CONFIG_B_REG  0x01
+#define MAG_MODE_REG      0x02
+#define MAG_DATA_REG      0x03 //X MSB, X LSB, Z MSB, Z LSB, Y MSB, Y LSB
+#define MAG_STATUS_REG    0x09
+#define MAG_STATUS_RDY    0b00000001
+
 /*----------------------GAIN------------------------------------*/
 /*Choose the magnetometer gain, only uncomment one.*/
 
 #define MAG_GAIN 0b00000000 //0.73mG/LSb Range = +-0.88Ga
 //#define MAG_GAIN 0b00100000 // 0.92mG/LSb Range = +-1.3Ga
-//#define MAG_GAIN 0x01000000 // 1.22mG/LSb Range = +-1.9Ga
-//#define MAG_GAIN 0x01100000 // 1.52mG/LSb Range = +-2.5Ga
-//#define MAG_GAIN 0x10000000 // 2.27mG/LSb Range = +-4.0Ga
-//#define MAG_GAIN 0x10100000 // 2.56mG/LSb Range = +-4.7Ga
-//#define MAG_GAIN 0x11000000 // 3.03mG/LSb Range = +-5.6Ga
-//#define MAG_GAIN 0x11100000 // 4.35mG/LSb Range = +-8.1Ga
+//#define MAG_GAIN 0b01000000 // 1.22mG/LSb Range = +-1.9Ga
+//#define MAG_GAIN 0b01100000 // 1.52mG/LSb Range = +-2.5Ga
+//#define MAG_GAIN 0b10000000 // 2.27mG/LSb Range = +-4.0Ga
+//#define MAG_GAIN 0b10100000 // 2.56mG/LSb Range = +-4.7Ga
+//#define MAG_GAIN 0b11000000 // 3.03mG/LSb Range = +-5.6Ga
+//#define MAG_GAIN 0b11100000 // 4.35mG/LSb Range = +-8.1Ga
 
 
 /*-----------------SAMPLES AVERAGED-----------------------
@@ -45,11 +53,29 @@
 #define MAG_MEAS_MODE 0b00000000
 
 /*----------------OPERATING MODE-----------------------
- * Use continuous measurement for now
+ * In single measurement mode SpriteMag::read() triggers a conversion, sleeps
+ * until the data is ready and then reads it. The sensor goes back to idle by
+ * itself, so it only draws measurement current when a sample is requested.
+ * The data output rate above only applies to continuous measurement.
  */
-#define MAG_OPER_MODE 0b00000000 //continuous measurement mode --default
-//#define MAG_OPER_MODE 0b00000001 //single measurement mode (DON'T USE: CURRENTLY NOT SUPPORTED)
-//#define MAG_OPER_MODE 0b00000010 //idle mode
+#define MAG_MODE_CONTINUOUS 0b00000000
+#define MAG_MODE_SINGLE     0b00000001
+#define MAG_MODE_IDLE       0b00000010
+
+//#define MAG_OPER_MODE MAG_MODE_CONTINUOUS //continuous measurement mode
+#define MAG_OPER_MODE MAG_MODE_SINGLE //single measurement mode --default
+//#define MAG_OPER_MODE MAG_MODE_IDLE //idle mode
+
+/*----------------DATA READY-----------------------
+ * A single measurement completes in about 6 ms. By default the CPU sleeps for
+ * that long and then checks the RDY bit of the status register. If the DRDY pin
+ * is wired to the MCU, define MAG_DRDY_PIN to the Energia pin number to sleep
+ * until its falling edge instead.
+ */
+#define MAG_CONVERSION_MS 6
+#define MAG_READY_RETRIES 4
+
+//#define MAG_DRDY_PIN P2_0
 
 
 #endif
@@ -7,6 +7,7 @@
 
 #define SMPL_RATE_REG_ADDR  0x15
 #define DLPF_RANGE_REG_ADDR 0x16
+#define GYRO_DATA_REG       0x1D //X MSB, X LSB, Y MSB, Y LSB, Z MSB, Z LSB
 
 /*----------------------ADDRESS------------------------------------*/
 /*Choose the gyro i2c address (depending on whether if VIO is high or low)
@@ -49,6 +50,7 @@
 * TEMPERATURE SENSITIVITY SCALE FACTOR = 280 LSb/ degree celsius
 * -range = -30 to +85 degrees celsius
 * -initial offset = -13000 LSb = 35 degrees celsius
+*/
 
 
 
@@ -59,13 +61,13 @@
  * sampling rate.
  */
 //											  LOW PASS FILTER BANDWIDTH | INTERNAL SAMPLE RATE
-//#define GYRO_FILTER_SMPL_RATE 0b00000000; //			256 Hz			|		8kHz
-//#define GYRO_FILTER_SMPL_RATE 0b00000001; //			188 Hz			|		1kHz
-//#define GYRO_FILTER_SMPL_RATE 0b00000010; //			 98 Hz			|		1kHz
-//#define GYRO_FILTER_SMPL_RATE 0b00000011; //			 42 Hz			|		1kHz
-//#define GYRO_FILTER_SMPL_RATE 0b00000100; //			 20 Hz			|		1kHz
-//#define GYRO_FILTER_SMPL_RATE 0b00000101; //			 10 Hz			|		1kHz
-#define GYRO_FILTER_SMPL_RATE 0b00000110; //			  5 Hz			|		1kHz    --Default
+//#define GYRO_FILTER_SMPL_RATE 0b00000000  //			256 Hz			|		8kHz
+//#define GYRO_FILTER_SMPL_RATE 0b00000001  //			188 Hz			|		1kHz
+//#define GYRO_FILTER_SMPL_RATE 0b00000010  //			 98 Hz			|		1kHz
+//#define GYRO_FILTER_SMPL_RATE 0b00000011  //			 42 Hz			|		1kHz
+//#define GYRO_FILTER_SMPL_RATE 0b00000100  //			 20 Hz			|		1kHz
+//#define GYRO_FILTER_SMPL_RATE 0b00000101  //			 10 Hz			|		1kHz
+#define GYRO_FILTER_SMPL_RATE 0b00000110  //			  5 Hz			|		1kHz    --Default
 
 
 
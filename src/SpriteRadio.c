@@ -13,65 +13,132 @@
 #include "cc430f5137.h"
 #include "random.h"
 #include "prn.h"
-
-	CC1101Settings m_settings;
-	char m_power;
-	unsigned char *m_prn0;
-	unsigned char *m_prn1;
-
-/**
- * System clock
- */
-#define SYSTEM_CLK_FREQ 8000000L
-#ifndef F_CPU
-#define F_CPU  SYSTEM_CLK_FREQ
+#include "csk.h"
+#include "CC1101Config.h"
+#include "ClockConfig.h"
+#include "clock.h"
+#include "state.h"
+#include "instrument.h"
+
+// Radio core state between transmissions: RF_SPWD (SLEEP) or RF_SXOFF
+#ifndef CONFIG_RF_POWER_DOWN
+#define CONFIG_RF_POWER_DOWN RF_SPWD
 #endif
 
-#define clockCyclesPerMicrosecond() ( F_CPU / 1000000L )
-#define clockCyclesToMicroseconds(a) ( (a) / clockCyclesPerMicrosecond() )
-#define microsecondsToClockCycles(a) ( (a) * clockCyclesPerMicrosecond() )
-
-
-// the clock source is set so that watch dog timer (WDT) ticks every clock
-// cycle (F_CPU), and the watch dog timer ISR is called every 512 ticks
-// for F_CPU < 8MHz and every 8192 ticks for F_CPU > 8MHz.
-#if F_CPU < 8000000L
-#define TICKS_PER_WDT_OVERFLOW 512
-#else
-#define TICKS_PER_WDT_OVERFLOW 8192
+// Sync word of packet mode, see SpriteRadio_setMode()
+#ifndef CONFIG_RF_PACKET_SYNC
+#define CONFIG_RF_PACKET_SYNC 0xD391
 #endif
 
-// the whole number of microseconds per WDT overflow
-#define MICROSECONDS_PER_WDT_OVERFLOW (clockCyclesToMicroseconds(TICKS_PER_WDT_OVERFLOW))
-
-// the whole number of milliseconds per WDT overflow
-#define MILLIS_INC (MICROSECONDS_PER_WDT_OVERFLOW / 1000)
-
-// the fractional number of milliseconds per WDT overflow. 
-#define FRACT_INC (MICROSECONDS_PER_WDT_OVERFLOW % 1000)
-#define FRACT_MAX 1000
-
-// Increments when sleeping. Depends on ACLK source.
-uint16_t SMILLIS_INC;
-uint16_t SFRACT_INC;
+// Frequency synthesizer calibration cache: results older than this, or from
+// another temperature band, are recalibrated
+#ifndef CONFIG_FSCAL_MAX_AGE_MS
+#define CONFIG_FSCAL_MAX_AGE_MS 600000UL
+#endif
+#ifndef CONFIG_FSCAL_TEMP_BAND
+#define CONFIG_FSCAL_TEMP_BAND 10   // Degrees Celsius per band
+#endif
+#define FSCAL_TEMP_MIN (-40)
+#define FSCAL_CACHE_SIZE 4
 
-volatile unsigned long wdt_overflow_count = 0;
-volatile unsigned long wdt_millis = 0;
-volatile unsigned int wdt_fract = 0;
-volatile uint8_t sleeping = false;
-volatile uint16_t vlo_freq = 0;
+	// Radio configuration, generated at compile time from CC1101Config.h
+	const CC1101Settings m_settings = {
+	    0x0E,   // FSCTRL1
+		0x00,   // FSCTRL0
+		CC1101_FREQ2,   // FREQ2
+		CC1101_FREQ1,   // FREQ1
+		CC1101_FREQ0,   // FREQ0
+		CC1101_MDMCFG4, // MDMCFG4
+		CC1101_MDMCFG3, // MDMCFG3
+		0x70,   // MDMCFG2
+		0x02,   // MDMCFG1
+		0xF8,   // MDMCFG0
+		CC1101_CHANNR,  // CHANNR
+		CC1101_DEVIATN, // DEVIATN
+		0xB6,   // FREND1
+		0x10,   // FREND0
+		CC1101_MCSM0,   // MCSM0
+		0x1D,   // FOCCFG
+		0x1C,   // BSCFG
+		0xC7,   // AGCCTRL2
+		0x00,   // AGCCTRL1
+		0xB0,   // AGCCTRL0
+		0xEA,   // FSCAL3
+		0x2A,   // FSCAL2
+		0x00,   // FSCAL1
+		0x1F,   // FSCAL0
+		0x59,   // FSTEST
+		0x88,   // TEST2
+		0x31,   // TEST1
+		0x09,   // TEST0
+		0x07,   // FIFOTHR
+		0x29,   // IOCFG2
+		0x06,   // IOCFG0
+		0x00,   // PKTCTRL1  Packet Automation (0x04 = append status bytes)
+		0x02,   // PKTCTRL0  0x02 = infinite packet length, 0x00 = Fixed Packet Size, 0x40 = whitening, 0x20 = PN9
+		0x00,   // ADDR      Device address.
+		0xFF    // PKTLEN    Packet Length (Bytes)
+	};
+	SPRITE_STATE char m_power;
+	SPRITE_STATE unsigned char m_mode;           // SR_MODE_SPREAD, SR_MODE_PACKET or SR_MODE_CSK
+	SPRITE_STATE unsigned char m_packet_length;  // Fixed packet length, 0 for variable
+	SPRITE_STATE unsigned char m_next_mode;      // ... as set, until SpriteRadio_txInit()
+	SPRITE_STATE unsigned char m_next_packet_length;
+	SPRITE_STATE uint8_t m_asleep;  // Radio core powered down since the last transmission
+	SPRITE_STATE unsigned char m_repeat;         // Copies of each frame, 0 meaning 1
+
+#if CONFIG_FSCAL_CACHE
+	// Frequency synthesizer calibration results
+	typedef struct {
+		unsigned char valid;
+		unsigned char channel;
+		unsigned char band;         // Temperature band
+		unsigned char fscal3, fscal2, fscal1;
+		unsigned long time;         // millis() at calibration
+	} FSCalEntry;
+
+	SPRITE_STATE FSCalEntry m_fscal[FSCAL_CACHE_SIZE];
+	SPRITE_STATE FSCalEntry *m_fscal_loaded;  // Entry in the FSCAL registers, if any
+#endif
+	SPRITE_STATE unsigned char m_temp_band;
+	SPRITE_STATE const unsigned char *m_prn0;
+	SPRITE_STATE const unsigned char *m_prn1;
+	SPRITE_STATE unsigned int m_csk_first;       // Gold code index of CSK symbol 0
+
+// The watchdog timer runs in interval mode from SMCLK, and its ISR adds the
+// time of an interval, CLOCK_WDT_TICKS cycles, to the clocks (see
+// ClockConfig.h). The cycles left over after whole milliseconds and
+// microseconds are carried, so neither clock drifts at any F_CPU.
+#define MILLIS_INC CLOCK_WDT_MILLIS
+#define FRACT_INC  CLOCK_WDT_MILLIS_CYCLES
+#define FRACT_MAX  CLOCK_CYCLES_PER_MS
+
+// Increments when sleeping, with the watchdog on ACLK, in milliseconds,
+// microseconds and cycles of F_CPU. Set from the last measurement of ACLK.
+SPRITE_STATE uint16_t SMILLIS_INC;
+SPRITE_STATE uint16_t SFRACT_INC;
+SPRITE_STATE unsigned long SMICROS_INC;
+SPRITE_STATE uint16_t SMICROS_FRACT_INC;
+
+SPRITE_STATE volatile unsigned long wdt_micros = 0;
+SPRITE_STATE volatile unsigned int wdt_micros_fract = 0;
+SPRITE_STATE volatile unsigned long wdt_millis = 0;
+SPRITE_STATE volatile unsigned int wdt_fract = 0;
+SPRITE_STATE volatile uint8_t sleeping = false;   // Watchdog on ACLK
+SPRITE_STATE volatile uint8_t wdt_sleep = false;  // ... allowed until:
+SPRITE_STATE volatile unsigned long wdt_sleep_until;
+SPRITE_STATE volatile uint8_t wdt_wake = true;    // Wake the CPU on every interval
+SPRITE_STATE volatile uint8_t wdt_idle = false;   // Sleep on ACLK until further notice
+SPRITE_STATE uint8_t aclk_measured = false;
+SPRITE_STATE unsigned long aclk_time;             // millis() at the measurement
 
 
 void enableWatchDogIntervalMode(void)
 {
-	/* WDT Password + WDT interval mode + Watchdog clock source /512 for F_CPU < 8MHz
-	 * and /8192 for F_CPU > 8MHz + source from SMCLK.
+	/* WDT Password + WDT interval mode + Watchdog clock source /CLOCK_WDT_TICKS
+	 * + source from SMCLK.
 	 * Note that we WDT is running in interval mode. WDT will not trigger a reset on expire in this mode. */
-#if F_CPU < 8000000L
-	WDTCTL = WDTPW | WDTTMSEL | WDTCNTCL | WDT_MDLY_0_5;
-#else
-	WDTCTL = WDTPW | WDTTMSEL | WDTCNTCL | WDT_MDLY_8;
-#endif
+	WDTCTL = WDTPW | WDTTMSEL | WDTCNTCL | CLOCK_WDT_INTERVAL;
 
 	/* WDT interrupt enable */
 #ifdef __MSP430_HAS_SFR__
@@ -85,24 +152,18 @@ unsigned long micros()
 {
 	unsigned long m;
 
-	// disable interrupts to ensure consistent readings
-	// safe SREG to avoid issues if interrupts were already disabled
-	bool int_state = _get_interrupt_state();
-	__dint();
-
-	m = wdt_overflow_count;
-
-;	// safe to enable interrupts again
-    if (int_state)
-      __eint();
+	// The 32-bit count is read in two halves, so read it until two reads
+	// agree instead of disabling interrupts around the read.
+	do {
+		m = wdt_micros;
+	} while (m != wdt_micros);
 
-	// MSP430 does not give read access to current WDT, so we
-	// have to approximate microseconds from overflows and
-	// fractional milliseconds.
+	// MSP430 does not give read access to current WDT, so
+	// microseconds only advance at each overflow.
 	// With an WDT interval of SMCLK/512, precision is +/- 256/SMCLK,
 	// for example +/-256us @1MHz and +/-16us @16MHz
 
-	return (m * MICROSECONDS_PER_WDT_OVERFLOW);
+	return m;
 }
 
 __attribute__((interrupt(WDT_VECTOR)))
@@ -112,33 +173,129 @@ void watchdog_isr (void)
   // (volatile variables must be read from memory on every access)
   unsigned long m = wdt_millis;
   unsigned int f = wdt_fract;
-
-  m += sleeping ? SMILLIS_INC:MILLIS_INC;
-  f += sleeping ? SFRACT_INC:FRACT_INC;
+  unsigned long u = wdt_micros;
+  unsigned int uf = wdt_micros_fract;
+
+  if (sleeping) {
+    m += SMILLIS_INC;
+    f += SFRACT_INC;
+    u += SMICROS_INC;
+    uf += SMICROS_FRACT_INC;
+  } else {
+    m += MILLIS_INC;
+    f += FRACT_INC;
+    u += CLOCK_WDT_MICROS;
+    uf += CLOCK_WDT_MICROS_CYCLES;
+  }
   if (f >= FRACT_MAX) {
     f -= FRACT_MAX;
     m += 1;
   }
+  if (uf >= CLOCK_CYCLES_PER_US) {
+    uf -= CLOCK_CYCLES_PER_US;
+    u += 1;
+  }
 
   wdt_fract = f;
   wdt_millis = m;
-  wdt_overflow_count++;
+  wdt_micros_fract = uf;
+  wdt_micros = u;
+
+  // Sleep on ACLK for the next interval if it ends before the delay() does.
+  // The watchdog clock is changed as an interval starts, so that no more
+  // than a period of ACLK is lost.
+  if ((wdt_idle || (wdt_sleep && (long)(wdt_sleep_until - m) > (long)SMILLIS_INC + 1)) != sleeping) {
+    sleeping = !sleeping;
+    WDTCTL = WDTPW | WDTHOLD;
+    WDTCTL = WDTPW | WDTTMSEL | WDTCNTCL |
+             (sleeping ? CLOCK_WDT_SLEEP_INTERVAL : CLOCK_WDT_INTERVAL);
+  }
 
   /* Exit from LMP3 on reti (this includes LMP0) */
-  __bic_SR_register_on_exit(LPM3_bits);
+  if (wdt_wake)
+    __bic_SR_register_on_exit(LPM3_bits);
+}
+
+void wakeOnTick(unsigned char enable)
+{
+	wdt_wake = enable;
+}
+
+static unsigned long millis()
+{
+	unsigned long m;
+
+	do {
+		m = wdt_millis;
+	} while (m != wdt_millis);
+
+	return m;
+}
+
+// Measure ACLK and derive the increments of a sleeping interval from it,
+// then restart the watchdog on SMCLK, adding the time the measurement took
+static void calibrateACLK(void)
+{
+	uint32_t elapsed, cycles = clock_measureACLK(&elapsed);
+	unsigned int f;
+
+	SMILLIS_INC = cycles / FRACT_MAX;
+	SFRACT_INC = cycles % FRACT_MAX;
+	SMICROS_INC = cycles / CLOCK_CYCLES_PER_US;
+	SMICROS_FRACT_INC = cycles % CLOCK_CYCLES_PER_US;
+
+	// The watchdog is stopped, its interrupt cannot change the clocks
+	f = wdt_fract + elapsed % FRACT_MAX;
+	wdt_millis += elapsed / FRACT_MAX + (f >= FRACT_MAX);
+	wdt_fract = f >= FRACT_MAX ? f - FRACT_MAX : f;
+	f = wdt_micros_fract + elapsed % CLOCK_CYCLES_PER_US;
+	wdt_micros += elapsed / CLOCK_CYCLES_PER_US + (f >= CLOCK_CYCLES_PER_US);
+	wdt_micros_fract = f >= CLOCK_CYCLES_PER_US ? f - CLOCK_CYCLES_PER_US : f;
+
+	aclk_time = wdt_millis;
+	aclk_measured = true;
+	enableWatchDogIntervalMode();
 }
 
-/* (ab)use the WDT */
+/* (ab)use the WDT. Long delays sleep in LPM3 with the watchdog on ACLK,
+ * measured against the DCO at most CONFIG_ACLK_CAL_MAX_AGE_MS before, and
+ * finish in LPM0 with it back on SMCLK, so that they end on time. */
 void delay(uint32_t milliseconds)
 {
-	uint32_t start = micros();
-	while(milliseconds > 0) {
-		if ((micros() - start) >= 1000) {
-			milliseconds--;
-			start += 1000;
-		}
+	uint32_t start = millis();
+	INSTRUMENT_BEGIN(span);
+
+	// millis() was up to an interval behind at the start
+	if (milliseconds)
+		milliseconds++;
+	if (milliseconds >= CLOCK_SLEEP_MIN_MS &&
+	    (!aclk_measured || start - aclk_time >= CONFIG_ACLK_CAL_MAX_AGE_MS)) {
+		// Right after a watchdog interrupt, so that stopping it loses little
+		__bis_SR_register(LPM0_bits+GIE);
+		calibrateACLK();
+	}
+
+	wdt_sleep_until = start + milliseconds;
+	wdt_sleep = aclk_measured && milliseconds >= CLOCK_SLEEP_MIN_MS;
+
+	while (millis() - start < milliseconds || sleeping) {
+		__bis_SR_register((sleeping ? LPM3_bits : LPM0_bits)+GIE);
+		INSTRUMENT_SPIN(span);  // Woken by the watchdog interrupt
+	}
+	wdt_sleep = false;
+	INSTRUMENT_COUNT(span, PROBE_DELAY);
+}
+
+void keepTimeOnACLK(unsigned char enable)
+{
+	// Measure ACLK first if need be, as delay() does, unless the watchdog is
+	// on it already
+	if (enable && !sleeping &&
+	    (!aclk_measured || millis() - aclk_time >= CONFIG_ACLK_CAL_MAX_AGE_MS)) {
 		__bis_SR_register(LPM0_bits+GIE);
+		calibrateACLK();
 	}
+	wdt_idle = enable;
 }
 
 static void randomSeed(unsigned int seed)
@@ -148,62 +305,28 @@ static void randomSeed(unsigned int seed)
   }
 }
 
-// From wiring.h
+// From wiring.h. Busy-waits, us must be a constant.
 inline void delayMicroseconds(const uint16_t us)
 {
-  const uint16_t cyclesPerMicro = SYSTEM_CLK_FREQ/1000000L;
-  __delay_cycles((us * cyclesPerMicro));
+  __delay_cycles(CLOCK_US_TO_CYCLES(us));
 }
 
 void SpriteRadio_SpriteRadio() {
-	
+
+#if CONFIG_CLOCK_INIT
+	clock_init();
+#endif
 	m_power = 0xC3;
-	
-	m_settings = (CC1101Settings){
-	    0x0E,   // FSCTRL1
-		0x00,   // FSCTRL0
-		0x10,   // FREQ2
-		0xD1,   // FREQ1
-		0x21,   // FREQ0
-		0x0B,   // MDMCFG4
-		0x43,   // MDMCFG3
-		0x70,   // MDMCFG2
-		0x02,   // MDMCFG1
-		0xF8,   // MDMCFG0
-		0x00,   // CHANNR
-		0x07,   // DEVIATN
-		0xB6,   // FREND1
-		0x10,   // FREND0
-		0x18,   // MCSM0
-		0x1D,   // FOCCFG
-		0x1C,   // BSCFG
-		0xC7,   // AGCCTRL2
-		0x00,   // AGCCTRL1
-		0xB0,   // AGCCTRL0
-		0xEA,   // FSCAL3
-		0x2A,   // FSCAL2
-		0x00,   // FSCAL1
-		0x1F,   // FSCAL0
-		0x59,   // FSTEST
-		0x88,   // TEST2
-		0x31,   // TEST1
-		0x09,   // TEST0
-		0x07,   // FIFOTHR
-		0x29,   // IOCFG2
-		0x06,   // IOCFG0
-		0x00,   // PKTCTRL1  Packet Automation (0x04 = append status bytes)
-		0x02,   // PKTCTRL0  0x02 = infinite packet length, 0x00 = Fixed Packet Size, 0x40 = whitening, 0x20 = PN9
-		0x00,   // ADDR      Device address.
-		0xFF    // PKTLEN    Packet Length (Bytes)
-	};
 
 	m_prn0 = PRN_0;
 	m_prn1 = PRN_1;
+	m_csk_first = CONFIG_CSK_FIRST_CODE;
 
 	//Initialize random number generator
 	randomSeed(((int)m_prn0[0]) + ((int)m_prn1[0]) + ((int)m_prn0[1]) + ((int)m_prn1[1]));
 
     enableWatchDogIntervalMode();
+    instrument_reset();
 }
 
 #if 0
@@ -220,113 +343,53 @@ void SpriteRadio_SpriteRadio(unsigned char prn0[], unsigned char prn1[], CC1101S
 }
 #endif
 
+// PA table values for -30 dBm to 10 dBm, indexed by (tx_power_dbm - PA_POWER_MIN_DBM).
+// These values are from TI Design Note DN013 and are calibrated for operation at 434 MHz.
+#define PA_POWER_MIN_DBM -30
+#define PA_POWER_MAX_DBM 10
+
+static const unsigned char PA_POWER[PA_POWER_MAX_DBM - PA_POWER_MIN_DBM + 1] = {
+	0x03, 0x03, 0x03, 0x03, // -30 .. -27 dBm
+	0x07, 0x07, 0x07,       // -26 .. -24 dBm
+	0x0A, 0x0A, 0x0A,       // -23 .. -21 dBm
+	0x0E, 0x0E,             // -20 .. -19 dBm
+	0x1A, 0x1A, 0x1A,       // -18 .. -16 dBm
+	0x1D, 0x1D, 0x1D,       // -15 .. -13 dBm
+	0x26,                   // -12 dBm
+	0x25,                   // -11 dBm
+	0x34,                   // -10 dBm
+	0x6E,                   //  -9 dBm
+	0x6D,                   //  -8 dBm
+	0x6C,                   //  -7 dBm
+	0x6A,                   //  -6 dBm
+	0x69,                   //  -5 dBm
+	0x57,                   //  -4 dBm
+	0x65,                   //  -3 dBm
+	0x63,                   //  -2 dBm
+	0x52,                   //  -1 dBm
+	0x60,                   //   0 dBm
+	0x50,                   //   1 dBm
+	0x8C,                   //   2 dBm
+	0x8A,                   //   3 dBm
+	0x87,                   //   4 dBm
+	0x84,                   //   5 dBm
+	0x82,                   //   6 dBm
+	0xC9,                   //   7 dBm
+	0xC6,                   //   8 dBm
+	0xC3,                   //   9 dBm
+	0xC0                    //  10 dBm
+};
+
 // Set the output power of the transmitter.
 void SpriteRadio_setPower(int tx_power_dbm) {
-	
-	// These values are from TI Design Note DN013 and are calibrated for operation at 434 MHz.
-	switch (tx_power_dbm) {
-		case 10:
-			m_power = 0xC0;
-			break;
-		case 9:
-			m_power = 0xC3;
-			break;
-		case 8:
-			m_power = 0xC6;
-			break;
-		case 7:
-			m_power = 0xC9;
-			break;
-		case 6:
-			m_power = 0x82;
-			break;
-		case 5:
-			m_power = 0x84;
-			break;
-		case 4:
-			m_power = 0x87;
-			break;
-		case 3:
-			m_power = 0x8A;
-			break;
-		case 2:
-			m_power = 0x8C;
-			break;
-		case 1:
-			m_power = 0x50;
-			break;
-		case 0:
-			m_power = 0x60;
-			break;
-		case -1:
-			m_power = 0x52;
-			break;
-		case -2:
-			m_power = 0x63;
-			break;
-		case -3:
-			m_power = 0x65;
-			break;
-		case -4:
-			m_power = 0x57;
-			break;
-		case -5:
-			m_power = 0x69;
-			break;
-		case -6:
-			m_power = 0x6A;
-			break;
-		case -7:
-			m_power = 0x6C;
-			break;
-		case -8:
-			m_power = 0x6D;
-			break;
-		case -9:
-			m_power = 0x6E;
-			break;
-		case -10:
-			m_power = 0x34;
-			break;
-		case -11:
-			m_power = 0x25;
-			break;
-		case -12:
-			m_power = 0x26;
-			break;
-		case -13:
-		case -14:
-		case -15:
-			m_power = 0x1D;
-			break;
-		case -16:
-		case -17:
-		case -18:
-			m_power = 0x1A;
-			break;
-		case -19:
-		case -20:
-			m_power = 0x0E;
-			break;
-		case -21:
-		case -22:
-		case -23:
-			m_power = 0x0A;
-			break;
-		case -24:
-		case -25:
-		case -26:
-			m_power = 0x07;
-			break;
-		case -27:
-		case -28:
-		case -29:	
-		case -30:
-			m_power = 0x03;
-			break;
-		default:
-			m_power = 0xC3; // 10 dBm
-		}
+
+	if (tx_power_dbm < PA_POWER_MIN_DBM || tx_power_dbm > PA_POWER_MAX_DBM)
+	{
+		m_power = 0xC3; // 10 dBm
+		return;
+	}
+
+	m_power = PA_POWER[tx_power_dbm - PA_POWER_MIN_DBM];
 }
 
 char SpriteRadio_fecEncode(char data)
@@ -356,13 +419,160 @@ char SpriteRadio_fecEncode(char data)
   	return p;
 }
 
-void SpriteRadio_transmit(char bytes[], unsigned int length)
+// Shift the bits of a codeword into the CSK symbol accumulator and send every
+// whole symbol, opening the transmission with the first one
+static void cskShift(unsigned long *acc, unsigned char *nbits, uint16_t bits,
+                     unsigned char count, unsigned char *started)
+{
+	*acc = (*acc << count) | bits;
+	*nbits += count;
+	while (*nbits >= CSK_BITS)
+	{
+		unsigned char code[CSK_CODE_BYTES];
+
+		*nbits -= CSK_BITS;
+		csk_code(m_csk_first + ((*acc >> *nbits) & (CONFIG_CSK_CODES - 1)), code);
+
+		if (*started)
+		{
+			continueRawTransmit(code, CSK_CODE_BYTES);
+		}
+		else
+		{
+			beginRawTransmit(code, CSK_CODE_BYTES);
+			*started = 1;
+		}
+	}
+}
+
+// Position in a message scattered over segments
+typedef struct {
+	const radio_segment_t *segment;
+	unsigned int count;     // Segments left, the current one included
+	unsigned int offset;    // Bytes of the current segment read
+} MessageCursor;
+
+static void cursorSkipEmpty(MessageCursor *c)
+{
+	while (c->count && c->offset == c->segment->length)
+	{
+		c->segment++;
+		c->count--;
+		c->offset = 0;
+	}
+}
+
+static void cursorInit(MessageCursor *c, const radio_segment_t segments[], unsigned int count)
+{
+	c->segment = segments;
+	c->count = count;
+	c->offset = 0;
+	cursorSkipEmpty(c);
+}
+
+// Up to max bytes at the cursor that are contiguous in memory, which the
+// cursor moves past
+static unsigned int cursorRun(MessageCursor *c, unsigned int max, const unsigned char **bytes)
+{
+	unsigned int n;
+
+	*bytes = 0;
+	if (!c->count)
+		return 0;
+	n = c->segment->length - c->offset;
+	if (n > max)
+		n = max;
+	*bytes = (const unsigned char *)c->segment->bytes + c->offset;
+	c->offset += n;
+	cursorSkipEmpty(c);
+	return n;
+}
+
+static char cursorByte(MessageCursor *c)
+{
+	const unsigned char *byte;
+
+	return cursorRun(c, 1, &byte) ? (char)*byte : 0;
+}
+
+static uint16_t fecCodeword(char byte)
+{
+	return ((uint16_t)(unsigned char)SpriteRadio_fecEncode(byte) << 8) | (unsigned char)byte;
+}
+
+// Send one CSK frame of the next length bytes of a message, see
+// SpriteRadio_setMode(), and its copies
+static void transmitCSK(MessageCursor *message, unsigned char length)
 {
+	const MessageCursor start = *message;
+	unsigned long acc = 0;
+	unsigned char nbits = 0, started = 0, r = 0;
+	unsigned int k;
+
+	do
+	{
+		*message = start;
+		cskShift(&acc, &nbits, 0, CSK_BITS, &started);
+		cskShift(&acc, &nbits, CONFIG_CSK_CODES - 1, CSK_BITS, &started);
+		cskShift(&acc, &nbits, 1, CSK_BITS, &started);
+		cskShift(&acc, &nbits, CONFIG_CSK_CODES - 2, CSK_BITS, &started);
+
+		cskShift(&acc, &nbits, fecCodeword(length), 16, &started);
+		for (k = 0; k < length; ++k)
+		{
+			cskShift(&acc, &nbits, fecCodeword(cursorByte(message)), 16, &started);
+		}
+		if (nbits)
+		{
+			cskShift(&acc, &nbits, 0, CSK_BITS - nbits, &started);
+		}
+	} while (++r < m_repeat);
+
+	endRawTransmit();
+}
+
+static void transmitPacket(MessageCursor *message, unsigned char length);
+
+void SpriteRadio_transmitv(const radio_segment_t segments[], unsigned int count)
+{
+	MessageCursor message;
+	unsigned int length = 0, i;
+
+	for (i = 0; i < count; ++i)
+		length += segments[i].length;
+	cursorInit(&message, segments, count);
+
+	if (m_mode == SR_MODE_CSK)
+	{
+		while (length)
+		{
+			unsigned char n = length < SR_CSK_MAX ? length : SR_CSK_MAX;
+
+			transmitCSK(&message, n);
+			length -= n;
+		}
+		return;
+	}
+
+	if (m_mode == SR_MODE_PACKET)
+	{
+		unsigned char max = m_packet_length ? m_packet_length : SR_PACKET_MAX;
+
+		while (length)
+		{
+			unsigned char n = length < max ? length : max;
+
+			transmitPacket(&message, n);
+			length -= n;
+		}
+		return;
+	}
+
 #ifdef SR_DEBUG_MODE
 
 	for(unsigned int k = 0; k < length; ++k)
 	{
-		SpriteRadio_transmitByte(bytes[k]);
+		SpriteRadio_transmitByte(cursorByte(&message));
 		delay(1000);
 	}
 
@@ -372,7 +582,7 @@ void SpriteRadio_transmit(char bytes[], unsigned int length)
 
 	for(unsigned int k = 0; k < length; ++k)
 	{
-		SpriteRadio_transmitByte(bytes[k]);
+		SpriteRadio_transmitByte(cursorByte(&message));
 
 		delay(random(8000, 12000));
 	}
@@ -380,69 +590,174 @@ void SpriteRadio_transmit(char bytes[], unsigned int length)
 #endif
 }
 
+void SpriteRadio_transmit(const char bytes[], unsigned int length)
+{
+	radio_segment_t segment = { bytes, length };
+
+	SpriteRadio_transmitv(&segment, 1);
+}
+
+void SpriteRadio_transmitQueued(ringbuf_t *queue)
+{
+	const uint8_t *record;
+	uint16_t length;
+
+	// Records are sent from where the producer wrote them and only released
+	// afterwards, so producers may keep enqueuing during the transmission.
+	while ((record = ringbuf_peek(queue, &length)))
+	{
+		SpriteRadio_transmit((const char *)record, length);
+		ringbuf_release(queue);
+	}
+}
+
 void SpriteRadio_transmitByte(char byte)
 {
 	char parity = SpriteRadio_fecEncode(byte);
+	unsigned char r = 0;
 
-	//Transmit preamble (1110010)
-	beginRawTransmit(m_prn1,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-
-	//Transmit parity byte
-	parity & BIT7 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	parity & BIT6 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	parity & BIT5 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	parity & BIT4 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	parity & BIT3 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	parity & BIT2 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	parity & BIT1 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	parity & BIT0 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	
-	//Transmit data byte
-	byte & BIT7 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	byte & BIT6 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	byte & BIT5 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	byte & BIT4 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	byte & BIT3 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	byte & BIT2 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	byte & BIT1 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	byte & BIT0 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-
-	//Transmit postamble (1011000)
-	continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
-	continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+	// The copies of the frame follow each other, the first opening the
+	// transmission
+	do
+	{
+		//Transmit preamble (1110010)
+		r ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : beginRawTransmit(m_prn1,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+
+		//Transmit parity byte
+		parity & BIT7 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		parity & BIT6 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		parity & BIT5 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		parity & BIT4 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		parity & BIT3 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		parity & BIT2 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		parity & BIT1 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		parity & BIT0 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+
+		//Transmit data byte
+		byte & BIT7 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		byte & BIT6 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		byte & BIT5 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		byte & BIT4 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		byte & BIT3 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		byte & BIT2 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		byte & BIT1 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		byte & BIT0 ? continueRawTransmit(m_prn1,PRN_LENGTH_BYTES) : continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+
+		//Transmit postamble (1011000)
+		continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn1,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+		continueRawTransmit(m_prn0,PRN_LENGTH_BYTES);
+	} while (++r < m_repeat);
 
 	endRawTransmit();
 }
 
-void SpriteRadio_rawTransmit(unsigned char bytes[], unsigned int length) {
+void SpriteRadio_rawTransmit(const unsigned char bytes[], unsigned int length) {
 	
 	beginRawTransmit(bytes, length);
 	endRawTransmit();
 }
 
-void beginRawTransmit(unsigned char bytes[], unsigned int length) {
+#if CONFIG_FSCAL_CACHE
+// Put calibration results for the current channel and temperature into the
+// FSCAL registers, calibrating only if there are none or they are too old.
+// The radio must be in IDLE.
+static void loadCalibration() {
+	unsigned long now = millis();
+	FSCalEntry *entry = 0, *oldest = &m_fscal[0];
+	unsigned char i;
+	char status;
+	INSTRUMENT_BEGIN(span);
+
+	for (i = 0; i < FSCAL_CACHE_SIZE; i++)
+	{
+		FSCalEntry *e = &m_fscal[i];
+
+		if (e->valid && e->channel == m_settings.channr && e->band == m_temp_band)
+			entry = e;
+		if (oldest->valid && (!e->valid || now - e->time > now - oldest->time))
+			oldest = e;
+	}
+
+	if (entry && now - entry->time < CONFIG_FSCAL_MAX_AGE_MS)
+	{
+		if (entry != m_fscal_loaded)
+		{
+			writeRegister(FSCAL3, entry->fscal3);
+			writeRegister(FSCAL2, entry->fscal2);
+			writeRegister(FSCAL1, entry->fscal1);
+			m_fscal_loaded = entry;
+		}
+		return;
+	}
+
+	if (!entry)
+		entry = oldest;
+
+	status = strobe(RF_SCAL);
+	while (status & 0xF0)
+	{
+		status = strobe(RF_SNOP);
+		INSTRUMENT_SPIN(span);
+	}
+	INSTRUMENT_END(span, PROBE_FSCAL_WAIT);
+
+	entry->fscal3 = readRegister(FSCAL3);
+	entry->fscal2 = readRegister(FSCAL2);
+	entry->fscal1 = readRegister(FSCAL1);
+	entry->channel = m_settings.channr;
+	entry->band = m_temp_band;
+	entry->time = now;
+	entry->valid = 1;
+	m_fscal_loaded = entry;
+}
+#endif
+
+void SpriteRadio_setTemperature(int celsius) {
+
+	if (celsius < FSCAL_TEMP_MIN)
+		celsius = FSCAL_TEMP_MIN;
+	m_temp_band = (celsius - FSCAL_TEMP_MIN) / CONFIG_FSCAL_TEMP_BAND;
+}
+
+// Wake the radio up into IDLE, calibrated and with an empty TX FIFO
+static void prepareTransmit() {
 	char status;
+	INSTRUMENT_BEGIN(span);
+
+	SpriteRadio_wake();
 
 	//Wait for radio to be in idle state
 	status = strobe(RF_SIDLE);
 	while (status & 0xF0)
 	{
 		status = strobe(RF_SNOP);
+		INSTRUMENT_SPIN(span);
 	}
+	INSTRUMENT_END(span, PROBE_TX_IDLE_WAIT);
+
+#if CONFIG_FSCAL_CACHE
+	loadCalibration();
+#endif
 	
 	//Clear TX FIFO
-	status = strobe(RF_SFTX);
+	strobe(RF_SFTX);
+}
+
+void beginRawTransmit(const unsigned char bytes[], unsigned int length) {
+	char status;
+
+	prepareTransmit();
 
 	if(length <= 64)
 	{
@@ -480,7 +795,7 @@ void beginRawTransmit(unsigned char bytes[], unsigned int length) {
 	}
 }
 
-void continueRawTransmit(unsigned char bytes[], unsigned int length) {
+void continueRawTransmit(const unsigned char bytes[], unsigned int length) {
 
 	unsigned char bytes_free, bytes_to_write;
 	unsigned int bytes_to_go, counter;
@@ -522,24 +837,160 @@ void continueRawTransmit(unsigned char bytes[], unsigned int length) {
 
 void endRawTransmit() {
 
-	char status = strobe(RF_SNOP);
+	char status;
+	INSTRUMENT_BEGIN(span);
+
+	status = strobe(RF_SNOP);
 
 	//Wait for transmission to finish
 	while(status != 0x7F)
 	{
 		status = strobe(RF_SNOP);
+		INSTRUMENT_SPIN(span);
 	}
-	strobe(RF_SIDLE); //Put radio back in idle mode
+	INSTRUMENT_END(span, PROBE_TX_END_WAIT);
+	SpriteRadio_sleep(); //Power the radio down until the next transmission
 	return;
 }
 
+void SpriteRadio_setMode(unsigned char mode, unsigned char packet_length) {
+
+	// The registers of the mode are only written by SpriteRadio_txInit()
+	m_next_mode = mode;
+	m_next_packet_length = packet_length > SR_PACKET_MAX + 1 ? SR_PACKET_MAX + 1 : packet_length;
+}
+
+void SpriteRadio_setRepeat(unsigned char count) {
+
+	m_repeat = count > SR_REPEAT_MAX ? SR_REPEAT_MAX : count;
+}
+
+// Packet handler settings of packet mode, on top of m_settings
+static void writePacketConfiguration() {
+
+	writeRegister(MDMCFG2,  0x72);  // MSK, 16/16 sync word bits
+	writeRegister(MDMCFG1,  0x22);  // 4 preamble bytes
+	writeRegister(SYNC1,    (CONFIG_RF_PACKET_SYNC >> 8) & 0xFF);
+	writeRegister(SYNC0,    CONFIG_RF_PACKET_SYNC & 0xFF);
+	writeRegister(PKTCTRL1, 0x00);  // No address check or status bytes
+	if (m_packet_length)
+	{
+		writeRegister(PKTCTRL0, 0x44);  // PN9 whitening, CRC, fixed length
+		writeRegister(PKTLEN,   m_packet_length);
+	}
+	else
+	{
+		writeRegister(PKTCTRL0, 0x45);  // PN9 whitening, CRC, variable length
+		writeRegister(PKTLEN,   SR_PACKET_MAX);
+	}
+}
+
+// Twice the longest packet on air, preamble, sync word, length, 64 bytes
+// and CRC, and a millisecond for the synthesizer to calibrate and settle
+#define PACKET_TIMEOUT_US (2UL * (4 + 2 + 1 + 64 + 2) * 8 * 1000000UL / CONFIG_RF_DATA_RATE + 1000)
+
+// MCSM1.TXOFF_MODE returns to IDLE after the CRC. Returns 0, with the radio
+// in IDLE and the TX FIFO flushed, if the FIFO underflowed or the packet did
+// not go out in time.
+static int waitPacketSent() {
+
+	unsigned long start = micros();
+	char status;
+	INSTRUMENT_BEGIN(span);
+
+	status = strobe(RF_SNOP);
+	while ((status & 0x70) || (readRegister(TXBYTES) & 0x7F))
+	{
+		if ((status & 0x70) == 0x70 || micros() - start > PACKET_TIMEOUT_US)
+		{
+			status = strobe(RF_SIDLE);
+			while (status & 0xF0)
+			{
+				status = strobe(RF_SNOP);
+			}
+			strobe(RF_SFTX);
+			INSTRUMENT_END(span, PROBE_TX_END_WAIT);
+			return 0;
+		}
+		status = strobe(RF_SNOP);
+		INSTRUMENT_SPIN(span);
+	}
+	INSTRUMENT_END(span, PROBE_TX_END_WAIT);
+	return 1;
+}
+
+// Send one packet of the next length bytes of a message, and its copies
+static void transmitPacket(MessageCursor *message, unsigned char length) {
+
+	const MessageCursor start = *message;
+	const unsigned char *bytes;
+	unsigned char r = 0, left, n;
+
+	prepareTransmit();
+
+	// The whole packet fits in the FIFO: the radio adds the preamble, sync
+	// word and CRC, and whitens the rest. TXOFF_MODE leaves it in IDLE for
+	// the next copy.
+	do
+	{
+		*message = start;
+		if (!m_packet_length)
+			writeTXBuffer(&length, 1);
+		for (left = length; left; left -= n)
+		{
+			n = cursorRun(message, left, &bytes);
+			if (!n)
+				break;
+			writeTXBuffer(bytes, n);
+		}
+		if (m_packet_length > length)
+			writeTXBufferZeros(m_packet_length - length);
+		strobe(RF_STX);
+
+		if (!waitPacketSent())
+			break;
+	} while (++r < m_repeat);
+	SpriteRadio_sleep();
+}
+
+void SpriteRadio_transmitPacket(const unsigned char bytes[], unsigned char length) {
+
+	radio_segment_t segment = { bytes, length };
+	MessageCursor message;
+
+	// The packet handler is only set up by txInit() in packet mode
+	if (m_mode != SR_MODE_PACKET)
+		return;
+	if (m_packet_length)
+	{
+		if (length > m_packet_length)
+			length = m_packet_length;
+	}
+	else if (length > SR_PACKET_MAX)
+	{
+		length = SR_PACKET_MAX;
+	}
+
+	cursorInit(&message, &segment, 1);
+	transmitPacket(&message, length);
+}
+
 void SpriteRadio_txInit() {
 	
 	char status;
 
+	m_mode = m_next_mode;
+	m_packet_length = m_next_packet_length;
+
 	reset();
 	writeConfiguration(&m_settings);  // Write settings to configuration registers
+	if (m_mode == SR_MODE_PACKET)
+		writePacketConfiguration();
 	writePATable(m_power);
+	m_asleep = 0;
+#if CONFIG_FSCAL_CACHE
+	m_fscal_loaded = 0;  // The reset cleared the FSCAL registers
+#endif
 
 	//Put radio into idle state
 	status = strobe(RF_SIDLE);
@@ -550,6 +1001,46 @@ void SpriteRadio_txInit() {
 }
 
 void SpriteRadio_sleep() {
-	
-	strobe(RF_SIDLE); //Put radio back in idle mode
+
+	char status;
+
+	if (m_asleep)
+		return;
+
+	// SPWD and SXOFF are only accepted in IDLE
+	status = strobe(RF_SIDLE);
+	while (status & 0xF0)
+	{
+	  status = strobe(RF_SNOP);
+	}
+
+	strobe(CONFIG_RF_POWER_DOWN);
+	m_asleep = 1;
+}
+
+void SpriteRadio_wake() {
+
+	char status;
+
+	if (!m_asleep)
+		return;
+
+	// Any strobe wakes the core; strobe() waits for the crystal and the
+	// RF1A7 delay
+	status = strobe(RF_SIDLE);
+	while (status & 0xF0)
+	{
+	  status = strobe(RF_SNOP);
+	}
+
+#if CONFIG_RF_POWER_DOWN == RF_SPWD
+	// These are not retained in SLEEP. The rest of the configuration is, and
+	// so is PATABLE entry 0, the only one used.
+	writeRegister(FSTEST, m_settings.fstest);
+	writeRegister(TEST2,  m_settings.test2);
+	writeRegister(TEST1,  m_settings.test1);
+	writeRegister(TEST0,  m_settings.test0);
+#endif
+
+	m_asleep = 0;
 }
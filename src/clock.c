@@ -0,0 +1,109 @@
+/*
+  clock.c - Main clock of the CC430 unified clock system (UCS)
+
+  Adapted from the PMM and UCS examples of the CC430 RF Examples from TI:
+  http://www.ti.com/lit/an/slaa465b/slaa465b.pdf
+*/
+
+#include <stdint.h>
+
+#include "cc430f5137.h"
+#include "ClockConfig.h"
+#include "clock.h"
+#include "instrument.h"
+
+// Timer_A1 is shared with the instrumentation, which must run it at the
+// same rate for its spans to survive a measurement
+#if CONFIG_INSTRUMENT && INSTRUMENT_TICK_SHIFT != 3
+#error clock_measureACLK() needs INSTRUMENT_TICK_SHIFT 3
+#endif
+
+// One core voltage level up: move the high side supervisor and the low side
+// monitor to the new level, wait for the monitor, then raise the core and
+// move the low side supervisor once it has got there
+static void setVCoreUp(uint8_t level)
+{
+	PMMCTL0_H = PMMPW_H;
+	SVSMHCTL = SVSHE | SVSHRVL0 * level | SVMHE | SVSMHRRL0 * level;
+	SVSMLCTL = SVSLE | SVMLE | SVSMLRRL0 * level;
+	while (!(PMMIFG & SVSMLDLYIFG))
+		;
+	PMMIFG &= ~(SVMLVLRIFG | SVMLIFG);
+	PMMCTL0_L = PMMCOREV0 * level;
+	if (PMMIFG & SVMLIFG) {
+		while (!(PMMIFG & SVMLVLRIFG))
+			;
+	}
+	SVSMLCTL = SVSLE | SVSLRVL0 * level | SVMLE | SVSMLRRL0 * level;
+	PMMCTL0_H = 0x00;
+}
+
+void clock_setVCore(uint8_t level)
+{
+	uint8_t current = PMMCTL0_L & PMMCOREV_3;
+
+	if (level > 3)
+		level = 3;
+	while (current < level)
+		setVCoreUp(++current);
+}
+
+void clock_init(void)
+{
+	// Before the clock gets faster
+	clock_setVCore(CLOCK_VCORE);
+
+	UCSCTL3 = SELREF__REFOCLK;
+
+	// The FLL is off while the DCO is set up, from its lowest tap
+	__bis_SR_register(SCG0);
+	UCSCTL0 = 0x0000;
+	UCSCTL1 = CLOCK_DCORSEL;
+	UCSCTL2 = FLLD_1 | CLOCK_FLLN;
+	__bic_SR_register(SCG0);
+
+	__delay_cycles(CLOCK_SETTLE_CYCLES);
+	do {
+		UCSCTL7 &= ~DCOFFG;
+	} while (UCSCTL7 & DCOFFG);
+
+	UCSCTL4 = (UCSCTL4 & ~(SELA_7 | SELS_7 | SELM_7)) |
+	          CONFIG_CLOCK_ACLK | SELS__DCOCLKDIV | SELM__DCOCLKDIV;
+}
+
+uint32_t clock_measureACLK(uint32_t *elapsed)
+{
+	uint32_t ticks = 0, total;
+	uint16_t last, now;
+	uint8_t i;
+
+	// Free-running from SMCLK / 8, as the instrumentation runs it
+	TA1CTL = TASSEL_2 | ID_3 | MC_2;
+	SFRIE1 &= ~WDTIE;
+	last = TA1R;
+	WDTCTL = WDT_ADLY_1_9;
+	SFRIFG1 &= ~WDTIFG;
+
+	// The first interval starts at an unknown phase of ACLK
+	while (!(SFRIFG1 & WDTIFG))
+		;
+	SFRIFG1 &= ~WDTIFG;
+	now = TA1R;
+	total = (uint16_t)(now - last);
+	last = now;
+
+	for (i = 0; i < CLOCK_ACLK_CAL_INTERVALS; i++) {
+		while (!(SFRIFG1 & WDTIFG))
+			;
+		SFRIFG1 &= ~WDTIFG;
+		now = TA1R;
+		ticks += (uint16_t)(now - last);
+		last = now;
+	}
+	WDTCTL = WDTPW | WDTHOLD;
+
+	total += ticks + (uint16_t)(TA1R - last);
+	*elapsed = total << 3;
+	return (ticks << 3) * (CLOCK_WDT_SLEEP_TICKS / CLOCK_ACLK_CAL_TICKS) /
+	       CLOCK_ACLK_CAL_INTERVALS;
+}
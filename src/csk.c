@@ -0,0 +1,41 @@
+/* Codes of the M-ary code shift keying mode (SR_MODE_CSK): Gold codes of
+ * the family of prn.c, the 511-chip sum of the m-sequences of x^9+x^5+1 (a)
+ * and x^9+x^6+x^5+x^3+1 (b), b shifted by the code index, followed by a 0
+ * chip. Both registers start from 101010101. Each code is made from the two
+ * sequences as it is sent, so that any set of 16 or 64 codes from any index
+ * takes the same 192 bytes of flash. */
+
+#include "csk.h"
+
+// a, MSB first, and the 0 chip
+static const unsigned char CSK_SEQ_A[CSK_CODE_BYTES] = {
+  0xAA, 0x81, 0x4A, 0xF2, 0xEE, 0x07, 0x3A, 0x4F, 0x5D, 0x44, 0x86, 0x70, 0xBD, 0xB3, 0x43, 0xBC,
+  0x3F, 0xE0, 0xF7, 0xC5, 0xCC, 0x82, 0x53, 0xB4, 0x79, 0xF3, 0x62, 0xA4, 0x71, 0xB5, 0x71, 0x31,
+  0x10, 0x08, 0x46, 0x13, 0x95, 0x61, 0xBD, 0x37, 0x22, 0x85, 0x69, 0xFB, 0x24, 0xB7, 0xE4, 0xD4,
+  0xCC, 0x06, 0x32, 0x8D, 0x2F, 0xE8, 0xB1, 0xD6, 0x59, 0xE3, 0xEE, 0x83, 0x5B, 0x76, 0x0B, 0x5E
+};
+
+// b, MSB first, repeated so that every shift of it is contiguous
+static const unsigned char CSK_SEQ_B[2 * CSK_CODE_BYTES] = {
+  0xAA, 0xF7, 0xE7, 0xA4, 0xF9, 0x7D, 0x02, 0xC4, 0xCE, 0xF5, 0xB7, 0x56, 0x97, 0x44, 0x10, 0xD7,
+  0x61, 0x1F, 0xF1, 0x82, 0x8E, 0xD0, 0xB8, 0x70, 0x74, 0xD5, 0x31, 0xED, 0x9F, 0xBB, 0x9C, 0xC3,
+  0x17, 0x9A, 0x32, 0x01, 0x28, 0x79, 0x37, 0x1C, 0x89, 0x09, 0xD7, 0xF5, 0x23, 0x6A, 0x0C, 0xCA,
+  0x54, 0x53, 0x8A, 0xE5, 0x60, 0x37, 0x88, 0xB5, 0x92, 0x59, 0xB1, 0xA7, 0x81, 0xF6, 0x5B, 0xE1,
+  0x55, 0xEF, 0xCF, 0x49, 0xF2, 0xFA, 0x05, 0x89, 0x9D, 0xEB, 0x6E, 0xAD, 0x2E, 0x88, 0x21, 0xAE,
+  0xC2, 0x3F, 0xE3, 0x05, 0x1D, 0xA1, 0x70, 0xE0, 0xE9, 0xAA, 0x63, 0xDB, 0x3F, 0x77, 0x39, 0x86,
+  0x2F, 0x34, 0x64, 0x02, 0x50, 0xF2, 0x6E, 0x39, 0x12, 0x13, 0xAF, 0xEA, 0x46, 0xD4, 0x19, 0x94,
+  0xA8, 0xA7, 0x15, 0xCA, 0xC0, 0x6F, 0x11, 0x6B, 0x24, 0xB3, 0x63, 0x4F, 0x03, 0xEC, 0xB7, 0xC2
+};
+
+void csk_code(unsigned int index, unsigned char chips[CSK_CODE_BYTES])
+{
+	const unsigned char *b = CSK_SEQ_B + (index >> 3);
+	unsigned char shift = 8 - (index & 7);
+	unsigned char j;
+
+	for (j = 0; j < CSK_CODE_BYTES; j++)
+	{
+		chips[j] = CSK_SEQ_A[j] ^ (unsigned char)((((unsigned int)b[j] << 8) | b[j + 1]) >> shift);
+	}
+	chips[CSK_CODE_BYTES - 1] &= 0xFE;
+}
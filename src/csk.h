@@ -0,0 +1,36 @@
+#ifndef LIBSPRITE_CSK_H
+#define LIBSPRITE_CSK_H
+
+/* Codes of the M-ary code shift keying mode: 16 codes carry 4 bits per
+ * symbol, 64 codes carry 6 */
+#ifndef CONFIG_CSK_CODES
+#define CONFIG_CSK_CODES 16
+#endif
+
+#if CONFIG_CSK_CODES == 16
+#define CSK_BITS 4
+#elif CONFIG_CSK_CODES == 64
+#define CSK_BITS 6
+#else
+#error "CONFIG_CSK_CODES must be 16 or 64"
+#endif
+
+/* Gold code index of the first code. Sprites in CSK mode on one channel are
+ * told apart by their code sets, as spread sprites are by their PRN pairs, so
+ * each needs a set of its own, e.g. from 4, 20, 36... with 16 codes. Sets
+ * should stay clear of the PRN pairs of prn.c (2 and 3, 266 to 269). */
+#ifndef CONFIG_CSK_FIRST_CODE
+#define CONFIG_CSK_FIRST_CODE 4
+#endif
+
+#if CONFIG_CSK_FIRST_CODE < 0 || CONFIG_CSK_FIRST_CODE + CONFIG_CSK_CODES > 511
+#error "CONFIG_CSK_FIRST_CODE must leave CONFIG_CSK_CODES codes of the 511 of the family"
+#endif
+
+// Chips of a code, packed MSB first: 511 and a 0 chip
+#define CSK_CODE_BYTES 64
+
+// The chips of Gold code index, 0 to 510
+void csk_code(unsigned int index, unsigned char chips[CSK_CODE_BYTES]);
+
+#endif // LIBSPRITE_CSK_H
@@ -3,9 +3,13 @@
 
 */
 
-#include "SpriteGyro.h"
-#include "utility/ITG3200_Config.h"
-#include "TI_USCI_I2C_master.h"
+#include "gyro.h"
+#include "ITG3200.h"
+#include "i2cdevice.h"
+
+typedef I2CDevice<USCI_I2C, GYRO_ADDRESS, AxisRegisters<GYRO_DATA_REG, 0, 2, 4> > ITG3200;
+
+static ITG3200 s_gyro;
 
 SpriteGyro::SpriteGyro() {
 	m_biasx = 0;
@@ -20,31 +24,17 @@ SpriteGyro::SpriteGyro(AngularVelocity bias) {
 }
 
 void SpriteGyro::init() {
-	//Sample rate divider registers
-	m_sendBufer[0] = SMPL_RATE_REG_ADDR;
-	m_sendBufer[1] = GYRO_SAMPLE_RATE;				
-	
-	TI_USCI_I2C_transmitinit(GYRO_ADDRESS, I2C_PRESCALE);
-	TI_USCI_I2C_transmit(m_sendBufer, 2);						//write to register
-
-	m_sendBufer[0] = DLPF_RANGE_REG_ADDR;					//Sample rate divider registers
-	m_sendBufer[1] = GYRO_RANGE|GYRO_FILTER_SMPL_RATE ;		//sample rate divider relative to internal sampling
-
-	TI_USCI_I2C_transmit(m_sendBufer, 2);						//write to DLPF and range register
+	s_gyro.write(SMPL_RATE_REG_ADDR, GYRO_SAMPLE_RATE);				//sample rate divider relative to internal sampling
+	s_gyro.write(DLPF_RANGE_REG_ADDR, GYRO_RANGE|GYRO_FILTER_SMPL_RATE);	//DLPF and range register
 }
 
 AngularVelocity SpriteGyro::read() {
-	m_sendBufer[0] = 0x1D;							//point to first gyro data register
-	TI_USCI_I2C_transmitinit(GYRO_ADDRESS, I2C_PRESCALE);
-	TI_USCI_I2C_transmit(m_sendBufer, 1);
-
-	TI_USCI_I2C_receiveinit(GYRO_ADDRESS, I2C_PRESCALE);   	//receiving 6 bytes
-	TI_USCI_I2C_receive(m_receiveBuffer, 6);
+	const unsigned char *data = s_gyro.readData();
 
 	AngularVelocity output;
-	output.x = ((int)m_receiveBuffer[0]<<8) + (int)m_receiveBuffer[1] + m_biasx;
-	output.y = ((int)m_receiveBuffer[2]<<8) + (int)m_receiveBuffer[3] + m_biasy;
-	output.z = ((int)m_receiveBuffer[4]<<8) + (int)m_receiveBuffer[5] + m_biasz;
+	output.x = ITG3200::Layout::x(data) + m_biasx;
+	output.y = ITG3200::Layout::y(data) + m_biasy;
+	output.z = ITG3200::Layout::z(data) + m_biasz;
 
 	return output;
 }
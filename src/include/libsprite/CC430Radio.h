@@ -63,7 +63,7 @@ typedef struct {
 	void writeRegister(unsigned char address, unsigned char value);
 	
 	// Write data to the transmit FIFO buffer. Max length is 64 bytes.
-	void writeTXBuffer(unsigned char *data, unsigned char length);
+	void writeTXBuffer(const unsigned char *data, unsigned char length);
 
     // Write zeros to the transmit FIFO buffer. Max length is 64 bytes.
     void writeTXBufferZeros(unsigned char length);
@@ -72,7 +72,7 @@ typedef struct {
     void readRXBuffer(unsigned char *data, unsigned char length);
 	
 	// Write the RF configuration settings to the radio - adapted from TI example code: http://www.ti.com/lit/an/slaa465b/slaa465b.pdf
-	void writeConfiguration(CC1101Settings *settings);
+	void writeConfiguration(const CC1101Settings *settings);
 	
 	// Set the RF power amplifier output power - adapted from TI example code: http://www.ti.com/lit/an/slaa465b/slaa465b.pdf
 	void writePATable(unsigned char value);
@@ -12,7 +12,26 @@
 
 #define PRN_LENGTH_BYTES 64
 
+// Transmit modes, see SpriteRadio_setMode()
+#define SR_MODE_SPREAD   0    // Gold code spread spectrum, one bit per PRN code
+#define SR_MODE_PACKET   1    // CC1101 packet handler, for high-SNR links
+#define SR_MODE_CSK      2    // Code shift keying, 4 or 6 bits per PRN code
+
+// Symbols opening a frame in CSK mode
+#define SR_CSK_SYNC_SYMBOLS 4
+
+// Longest message of one frame in CSK mode
+#define SR_CSK_MAX       255
+
+// Longest packet payload in variable length packet mode
+#define SR_PACKET_MAX    63
+
+// Most copies of a frame, see SpriteRadio_setRepeat()
+#define SR_REPEAT_MAX    8
+
 #include "CC430Radio.h"
+#include "ringbuf.h"
+#include "radio.h"
 
 	// Constructor - optionally supply radio register settings
 	void SpriteRadio_SpriteRadio();
@@ -21,24 +40,85 @@
 	// Set the transmitter power level. Default is 10 dBm.
 	void SpriteRadio_setPower(int tx_power_dbm);
 
+	// Select the transmit mode, taking effect at SpriteRadio_txInit(). Packet
+	// mode sends MSK packets with a preamble, sync word, PN9 whitening and
+	// CRC-16 at the chip rate: variable length if packet_length is 0, else
+	// fixed packets of packet_length bytes (up to 64), zero-padded.
+	//
+	// CSK mode sends a whole message of up to SR_CSK_MAX bytes as one frame of
+	// codes out of a set of 16 or 64 (CONFIG_CSK_CODES, see csk.h), each
+	// carrying 4 or 6 bits. The set, from CONFIG_CSK_FIRST_CODE, identifies
+	// the sprite as its PRN pair does in spread mode. The frame is the sync
+	// symbols 0, M-1, 1 and M-2, then the FEC codewords (parity byte, then
+	// data byte) of the length and of every byte, MSB first and zero-padded
+	// to a whole symbol. packet_length is ignored.
+	void SpriteRadio_setMode(unsigned char mode, unsigned char packet_length);
+
+	// Send every spread frame, CSK frame or packet count times (1 to
+	// SR_REPEAT_MAX, default 1) instead of once. The copies of a spread or
+	// CSK frame follow each other in one transmission, so on the ground they
+	// are exactly a frame apart in chips and can be combined before the FEC
+	// where no copy alone can be decoded. The copies of a packet are sent one
+	// after the other. Back to back, the copies gain against noise but not
+	// against a fade that outlasts them: for that, transmit the message
+	// again later.
+	void SpriteRadio_setRepeat(unsigned char count);
+
+	// Send one packet of up to SR_PACKET_MAX bytes (or the fixed length) in
+	// packet mode, and nothing in the other modes. SpriteRadio_transmit()
+	// splits longer messages.
+	void SpriteRadio_transmitPacket(const unsigned char bytes[], unsigned char length);
+
 	// Transmit the given byte array as-is
-    void SpriteRadio_rawTransmit(unsigned char bytes[], unsigned int length);
+    void SpriteRadio_rawTransmit(const unsigned char bytes[], unsigned int length);
 
     // Encode the given byte with FEC and transmit
     void SpriteRadio_transmitByte(char byte);
 
     // Encode the given byte array with FEC and transmit
-    void SpriteRadio_transmit(char bytes[], unsigned int length);
+    void SpriteRadio_transmit(const char bytes[], unsigned int length);
+
+    // Encode the concatenation of count segments with FEC and transmit it,
+    // reading each byte from its segment: the frames, packets and their
+    // copies are the same as those of SpriteRadio_transmit() on one buffer
+    void SpriteRadio_transmitv(const radio_segment_t segments[], unsigned int count);
+
+    // Transmit and release every record queued by ISRs, e.g. telemetry
+    void SpriteRadio_transmitQueued(ringbuf_t *queue);
 
 	// Initialize the radio - must be called before transmitting
     void SpriteRadio_txInit();
 
-	// Put the radio in low power mode - call after transmitting
+	// Power the radio core down (SLEEP, or XOFF if so configured). Transmissions
+	// do this by themselves once they are done.
 	void SpriteRadio_sleep();
+
+	// Bring the radio core back to IDLE, restoring the registers lost in SLEEP.
+	// Transmissions do this by themselves.
+	void SpriteRadio_wake();
 	
+	// Temperature of the radio in degrees Celsius, e.g. from the ADC. With the
+	// calibration cache, a change of temperature band triggers recalibration.
+	void SpriteRadio_setTemperature(int celsius);
+
 	char SpriteRadio_fecEncode(char data);
-void beginRawTransmit(unsigned char bytes[], unsigned int length);
-void continueRawTransmit(unsigned char bytes[], unsigned int length);
+void beginRawTransmit(const unsigned char bytes[], unsigned int length);
+void continueRawTransmit(const unsigned char bytes[], unsigned int length);
 void endRawTransmit();
 
+// Watchdog-based timekeeping, started by SpriteRadio_SpriteRadio()
+unsigned long micros();
+void delay(uint32_t milliseconds);
+
+// Whether the watchdog interrupt wakes the CPU from a low power mode at the
+// end of every interval, as it does by default and delay() relies on. Turn
+// it off to sleep until another interrupt while micros() keeps counting.
+void wakeOnTick(unsigned char enable);
+
+// Whether the watchdog runs from ACLK from its next interval on, as it does
+// in the long delays, so that the CPU waits for an interrupt in LPM3 with
+// SMCLK and the DCO off. micros() then advances in steps of the ACLK
+// interval, until an interval after this is turned off again.
+void keepTimeOnACLK(unsigned char enable);
+
 #endif //SpriteRadio_h
@@ -0,0 +1,39 @@
+/*
+  clock.h - Main clock of the CC430 unified clock system (UCS)
+
+  clock_init() raises the core voltage as far as the clock frequency and the
+  radio need, and locks MCLK and SMCLK to F_CPU (LIBSPRITE_CLOCK_FREQ, 1 to
+  20 MHz) with the FLL against REFO, and ACLK to the VLO or REFO
+  (LIBSPRITE_CLOCK_ACLK). Every delay and timer constant of the library is
+  counted in cycles of this clock at compile time, see ClockConfig.h.
+
+  ACLK keeps time while delay() sleeps in LPM3, and neither the VLO nor
+  REFO is accurate enough uncalibrated: clock_measureACLK() counts SMCLK
+  cycles over ACLK periods, and delay() calls it again whenever the last
+  measurement is older than LIBSPRITE_ACLK_CAL_MAX_AGE_MS.
+
+  SpriteRadio_SpriteRadio() calls clock_init() unless the library is built
+  with LIBSPRITE_CLOCK_INIT=0, for applications that set up the clock
+  system themselves.
+*/
+
+#ifndef LIBSPRITE_CLOCK_H
+#define LIBSPRITE_CLOCK_H
+
+#include <stdint.h>
+
+// Raise the core voltage and lock MCLK and SMCLK to F_CPU. Busy-waits for
+// the DCO to settle, 31 ms.
+void clock_init(void);
+
+// Raise the core voltage to level (0 to 3) one level at a time. Lowering
+// it is not supported.
+void clock_setVCore(uint8_t level);
+
+// SMCLK cycles per CLOCK_WDT_SLEEP_TICKS periods of ACLK, measured over
+// a few intervals of the watchdog on ACLK with Timer_A1 running from SMCLK,
+// about 20 ms of busy-waiting with the VLO. Takes over the watchdog and
+// leaves it stopped, and stores the cycles it took in elapsed.
+uint32_t clock_measureACLK(uint32_t *elapsed);
+
+#endif // LIBSPRITE_CLOCK_H
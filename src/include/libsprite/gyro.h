@@ -24,9 +24,6 @@ class SpriteGyro {
 	AngularVelocity read();
 	
   private:
-  	unsigned char m_sendBufer[2];
-  	unsigned char m_receiveBuffer[6];
-	
 	int m_biasx;
 	int m_biasy;
 	int m_biasz;
@@ -0,0 +1,82 @@
+/*
+  i2cdevice.h - Register-map driver for I2C sensors
+
+  The bus, device address, prescaler and data register layout are template
+  parameters, so a device compiles down to the same straight-line calls into
+  the bus driver as a hand-written one: no virtual calls and no configuration
+  stored in RAM. Adding a sensor only takes a typedef and its conversions.
+*/
+
+#ifndef I2CDevice_h
+#define I2CDevice_h
+
+#include <stdint.h>
+
+#include "TI_USCI_I2C_master.h"
+
+#if __cplusplus >= 201103L
+#define I2C_CONSTEXPR constexpr
+#else
+#define I2C_CONSTEXPR inline
+#endif
+
+// Bus policy for the USCI_B0 I2C master driver
+struct USCI_I2C {
+	static inline void write(uint8_t address, uint8_t prescale, unsigned char *data, uint8_t length) {
+		TI_USCI_I2C_transmitinit(address, prescale);
+		TI_USCI_I2C_transmit(data, length);
+	}
+
+	static inline void read(uint8_t address, uint8_t prescale, unsigned char *data, uint8_t length) {
+		TI_USCI_I2C_receiveinit(address, prescale);
+		TI_USCI_I2C_receive(data, length);
+	}
+};
+
+// Signed 16-bit value from a big-endian register pair
+I2C_CONSTEXPR int16_t i2c_be16(const unsigned char *data) {
+	return (int16_t)(((uint16_t)data[0] << 8) | data[1]);
+}
+
+// Block of three big-endian 16-bit axis registers starting at Register, with
+// the byte offset of each axis within the block
+template <uint8_t Register, uint8_t X, uint8_t Y, uint8_t Z>
+struct AxisRegisters {
+	enum { address = Register, length = 6 };
+
+	static I2C_CONSTEXPR int16_t x(const unsigned char *data) { return i2c_be16(data + X); }
+	static I2C_CONSTEXPR int16_t y(const unsigned char *data) { return i2c_be16(data + Y); }
+	static I2C_CONSTEXPR int16_t z(const unsigned char *data) { return i2c_be16(data + Z); }
+};
+
+template <class Bus, uint8_t Address, class Data, uint8_t Prescale = I2C_PRESCALE>
+class I2CDevice {
+  public:
+	typedef Data Layout;
+
+	// Write one register
+	void write(uint8_t reg, uint8_t value) {
+		m_sendBuffer[0] = reg;
+		m_sendBuffer[1] = value;
+		Bus::write(Address, Prescale, m_sendBuffer, 2);
+	}
+
+	// Read length bytes (at most Data::length) starting at reg
+	const unsigned char *read(uint8_t reg, uint8_t length) {
+		m_sendBuffer[0] = reg;
+		Bus::write(Address, Prescale, m_sendBuffer, 1);
+		Bus::read(Address, Prescale, m_receiveBuffer, length);
+		return m_receiveBuffer;
+	}
+
+	// Burst read of the whole data register block
+	const unsigned char *readData() {
+		return read(Data::address, Data::length);
+	}
+
+  private:
+	unsigned char m_sendBuffer[2];
+	unsigned char m_receiveBuffer[Data::length];
+};
+
+#endif //I2CDevice_h
@@ -0,0 +1,87 @@
+/*
+  instrument.h - Cycle and spin-count instrumentation of the driver
+
+  Built with CONFIG_INSTRUMENT (LIBSPRITE_INSTRUMENT=1), each probe below
+  counts its calls, the iterations of its busy-wait loops (spins) and the
+  time it took, from Timer_A1 clocked by SMCLK / 2^INSTRUMENT_TICK_SHIFT.
+  Timed spans must be shorter than 65536 ticks. Without CONFIG_INSTRUMENT
+  the macros expand to nothing and the library is unchanged.
+
+  instrument_dump() serializes the counters as a little-endian telemetry
+  record for the downlink:
+
+      uint8_t  version;         // INSTRUMENT_VERSION
+      uint8_t  probes;          // INSTRUMENT_PROBES
+      uint8_t  tick_shift;      // CPU cycles per tick = 1 << tick_shift
+      uint8_t  reserved;
+      struct {
+          uint32_t count;       // Calls
+          uint32_t spins;       // Busy-wait iterations, total
+          uint16_t spins_max;   // ... and most in one call
+          uint16_t ticks_min;   // Duration of a call, 0 when not timed
+          uint16_t ticks_max;
+          uint32_t ticks;       // Total duration
+      } probe[INSTRUMENT_PROBES];
+*/
+
+#ifndef LIBSPRITE_INSTRUMENT_H
+#define LIBSPRITE_INSTRUMENT_H
+
+#include <stdint.h>
+
+#ifndef CONFIG_INSTRUMENT
+#define CONFIG_INSTRUMENT 0
+#endif
+
+#define INSTRUMENT_VERSION    1
+#define INSTRUMENT_TICK_SHIFT 3
+
+enum {
+	PROBE_RF_STROBE,      // strobe(), spinning on RFINSTRIFG/RFSTATIFG
+	PROBE_RF_READ,        // readRegister(), spinning on RFDOUTIFG
+	PROBE_RF_WRITE,       // writeRegister(), spinning on RFINSTRIFG
+	PROBE_RF_TXFIFO,      // writeTXBuffer(Zeros)(), spinning on RFINSTRIFG/RFDINIFG
+	PROBE_TX_IDLE_WAIT,   // beginRawTransmit() waking the radio and polling for IDLE
+	PROBE_TX_END_WAIT,    // endRawTransmit() polling for the FIFO to drain
+	PROBE_FSCAL_WAIT,     // Frequency synthesizer calibration
+	PROBE_DELAY,          // delay(), spins are watchdog interrupts (not timed)
+	INSTRUMENT_PROBES
+};
+
+#define INSTRUMENT_PROBE_SIZE  18
+#define INSTRUMENT_RECORD_SIZE (4 + INSTRUMENT_PROBES * INSTRUMENT_PROBE_SIZE)
+
+#if CONFIG_INSTRUMENT
+
+typedef struct {
+	uint16_t start;
+	uint16_t spins;
+} instrument_span_t;
+
+#define INSTRUMENT_BEGIN(span)         instrument_span_t span = { TA1R, 0 }
+#define INSTRUMENT_SPIN(span)          ((span).spins++)
+#define INSTRUMENT_END(span, probe)    instrument_end(&(span), (probe), 1)
+#define INSTRUMENT_COUNT(span, probe)  instrument_end(&(span), (probe), 0)
+
+void instrument_end(const instrument_span_t *span, uint8_t probe, uint8_t timed);
+
+// Clear the counters and (re)start Timer_A1
+void instrument_reset(void);
+
+// Write the telemetry record into buffer, returning its length, or 0 if
+// size is less than INSTRUMENT_RECORD_SIZE
+unsigned int instrument_dump(uint8_t *buffer, unsigned int size);
+
+#else
+
+#define INSTRUMENT_BEGIN(span)
+#define INSTRUMENT_SPIN(span)          ((void)0)
+#define INSTRUMENT_END(span, probe)    ((void)0)
+#define INSTRUMENT_COUNT(span, probe)  ((void)0)
+
+#define instrument_reset()             ((void)0)
+#define instrument_dump(buffer, size)  0u
+
+#endif
+
+#endif
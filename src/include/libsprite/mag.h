@@ -19,11 +19,22 @@ class SpriteMag {
 
 	void init();
 
+	// Read the field. In single measurement mode this triggers a conversion
+	// and sleeps until it is done; if it is not done in time, the field is
+	// NaN and the timeout is counted.
 	MagneticField read();
-	
+
+	// Conversions that read() gave up waiting for
+	unsigned long timeouts() const { return m_timeouts; }
+
+	// Single measurement mode: trigger a conversion and poll for its result
+	void startMeasurement();
+	bool dataReady();
+
   private:
-  	unsigned char m_sendBufer[2];
-  	unsigned char m_receiveBuffer[6];
+	bool waitForData();
+
+	unsigned long m_timeouts;
 
 };
 
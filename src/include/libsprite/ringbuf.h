@@ -0,0 +1,50 @@
+/*
+  ringbuf.h - Lock-free single-producer/single-consumer queue of variable-length records
+
+  The producer (typically an ISR) reserves space for a record, fills it in place
+  and commits it; the consumer (the main loop) peeks at the oldest record, uses
+  it in place and releases it. Neither side ever masks interrupts: each index is
+  written by one side only and published with a single aligned 16-bit store.
+*/
+
+#ifndef LIBSPRITE_RINGBUF_H
+#define LIBSPRITE_RINGBUF_H
+
+#include <stdint.h>
+
+// Each record is preceded by a 16-bit length and padded to an even size
+#define RINGBUF_HEADER_SIZE 2
+
+// Storage needed to hold one record of the given payload length
+#define RINGBUF_RECORD_SIZE(length) (RINGBUF_HEADER_SIZE + (((length) + 1) & ~1u))
+
+// Longest record a queue of size bytes takes: its records use up to half of it
+#define RINGBUF_MAX_LENGTH(size) ((size) / 2 - RINGBUF_HEADER_SIZE)
+
+typedef struct {
+	uint8_t *buffer;
+	uint16_t mask;        // size - 1, size is a power of two
+	uint16_t head;        // Free-running write index, written by the producer only
+	uint16_t tail;        // Free-running read index, written by the consumer only
+	uint16_t pad;         // Producer: bytes skipped at the end by the pending reservation
+	uint16_t peeked;      // Consumer: storage used by the record being read
+} ringbuf_t;
+
+// Initialize a queue over storage of size bytes: a power of two from 4 to 32768,
+// aligned to 2 bytes.
+void ringbuf_init(ringbuf_t *rb, uint8_t *storage, uint16_t size);
+
+// Producer: reserve contiguous space for a record of up to length bytes.
+// Returns NULL if the queue is too full, or length exceeds RINGBUF_MAX_LENGTH().
+uint8_t *ringbuf_reserve(ringbuf_t *rb, uint16_t length);
+
+// Producer: publish the reserved record with its actual length (<= reserved length).
+void ringbuf_commit(ringbuf_t *rb, uint16_t length);
+
+// Consumer: oldest record and its length, or NULL if the queue is empty.
+const uint8_t *ringbuf_peek(ringbuf_t *rb, uint16_t *length);
+
+// Consumer: drop the record returned by the last ringbuf_peek().
+void ringbuf_release(ringbuf_t *rb);
+
+#endif // LIBSPRITE_RINGBUF_H
@@ -0,0 +1,76 @@
+/*
+  sensors.h - Multi-rate sampling scheduler for sensors sharing the I2C bus
+
+  Each sensor is registered with its sampling period and a read callback. The
+  scheduler sleeps until the earliest sensor is due, then reads every sensor
+  that falls due within the batching window in a single bus session, so the
+  CPU and bus wake up once for all of them. Samples are timestamped with
+  micros() and queued per sensor as ringbuf records:
+
+      uint32_t timestamp;  // micros() when the sample was read
+      uint8_t  data[];     // sample_size bytes written by the read callback
+
+  The C++ drivers are wrapped with a small callback, e.g.
+
+      static void readGyro(void *gyro, uint8_t *sample) {
+          AngularVelocity w = ((SpriteGyro *)gyro)->read();
+          memcpy(sample, &w, sizeof(w));
+      }
+*/
+
+#ifndef LIBSPRITE_SENSORS_H
+#define LIBSPRITE_SENSORS_H
+
+#include <stdint.h>
+
+#include "ringbuf.h"
+
+#define SENSORS_MAX 4
+
+#define SENSOR_TIMESTAMP_SIZE 4
+
+// Read one sample of the sensor into sample; called inside a bus session
+typedef void (*sensor_read_fn)(void *context, uint8_t *sample);
+
+typedef struct {
+	uint32_t period_us;
+	uint32_t next_due;      // micros() at which the next sample is due
+	sensor_read_fn read;
+	void *context;
+	uint8_t sample_size;
+	ringbuf_t *buffer;
+
+	uint32_t samples;       // Samples queued
+	uint32_t dropped;       // Samples lost to a full buffer
+	uint32_t missed;        // Periods skipped because the scheduler fell behind
+	int32_t jitter_min_us;  // Sample time minus due time
+	int32_t jitter_max_us;
+} sensor_t;
+
+typedef struct {
+	sensor_t *sensors[SENSORS_MAX];
+	uint8_t count;
+	uint32_t window_us;     // Sensors due this close to the earliest one are batched
+
+	void (*bus_begin)(void);  // Optional: power up / enable the bus for a session
+	void (*bus_end)(void);
+
+	uint32_t sessions;
+	uint32_t busy_us;       // Time spent in bus sessions
+} sensor_sched_t;
+
+// Initialize a scheduler. bus_begin/bus_end may be NULL.
+void sensors_init(sensor_sched_t *sched, uint32_t window_us,
+                  void (*bus_begin)(void), void (*bus_end)(void));
+
+// Register a sensor sampled every period_us. Samples go to buffer.
+// Returns 0 if the scheduler is full.
+int sensors_add(sensor_sched_t *sched, sensor_t *sensor, uint32_t period_us,
+                sensor_read_fn read, void *context, uint8_t sample_size,
+                ringbuf_t *buffer);
+
+// Sleep until the next bus session is due and run it. The sleep is timed by
+// Timer_A0, which the application must leave to the scheduler.
+void sensors_run(sensor_sched_t *sched);
+
+#endif // LIBSPRITE_SENSORS_H
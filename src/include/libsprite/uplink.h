@@ -0,0 +1,71 @@
+/*
+  uplink.h - Wake-on-radio receiver for commands from the ground
+
+  While listening, the radio core sleeps and its WOR timer wakes it every
+  period to listen for a fraction of it (12.5% >> duty_shift). An RX window
+  closes early when no carrier is sensed, and stays open while a preamble
+  or packet is being received, so the average current is a few uA to tens
+  of uA. The ground station must send a preamble at least one period long.
+
+  Packets use the CC1101 packet engine: variable length, hardware address
+  filtering and CRC-16, with the RSSI and LQI appended. The payload is
+
+      uint8_t address;   // CONFIG_UPLINK_ADDRESS, or UPLINK_BROADCAST
+      uint8_t sequence;  // Repeated packets carry the same sequence number
+      uint8_t opcode;
+      uint8_t args[];    // Up to UPLINK_MAX_ARGS bytes
+
+  The end-of-packet interrupt drains the RX FIFO, validates the packet and
+  queues the command for uplink_receive(), then puts the radio back to WOR.
+  Transmitting needs the radio: call uplink_stop() before, and uplink_start()
+  again after.
+*/
+
+#ifndef LIBSPRITE_UPLINK_H
+#define LIBSPRITE_UPLINK_H
+
+#include <stdint.h>
+
+#define UPLINK_MAX_ARGS   8
+#define UPLINK_BROADCAST  0x00
+#define UPLINK_DUTY_MAX   6       // Largest duty_shift, 0.2% duty cycle
+
+// Command payload without arguments
+#define UPLINK_HEADER_SIZE 3
+
+typedef struct {
+	uint8_t address;
+	uint8_t sequence;
+	uint8_t opcode;
+	uint8_t length;               // Argument bytes
+	uint8_t args[UPLINK_MAX_ARGS];
+	uint8_t rssi;                 // Raw RSSI and LQI status bytes
+	uint8_t lqi;
+} uplink_command_t;
+
+typedef struct {
+	uint16_t packets;             // Packets received
+	uint16_t accepted;            // Commands queued
+	uint16_t crc_errors;
+	uint16_t malformed;           // Bad length, foreign address or RX FIFO overflow
+	uint16_t duplicates;          // Repeats of the last accepted command
+	uint16_t dropped;             // Command queue full
+} uplink_stats_t;
+
+// Configure the radio for the uplink and start listening, waking every
+// period_ms (up to 1890 ms) for 12.5% >> duty_shift of the period
+void uplink_start(uint16_t period_ms, uint8_t duty_shift);
+
+// Stop listening and reinitialize the radio for transmitting
+void uplink_stop(void);
+
+// Copy the oldest queued command, returning 0 if there is none
+int uplink_receive(uplink_command_t *command);
+
+// Sleep in LPM3 until a command is queued, with the watchdog keeping time
+// on ACLK (see keepTimeOnACLK()) so that SMCLK and the DCO stop.
+void uplink_wait(void);
+
+const uplink_stats_t *uplink_stats(void);
+
+#endif // LIBSPRITE_UPLINK_H
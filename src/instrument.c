@@ -0,0 +1,117 @@
+/*
+  instrument.c - Cycle and spin-count instrumentation of the driver
+*/
+
+#include <stdint.h>
+
+#include "cc430f5137.h"
+#include "instrument.h"
+#include "state.h"
+
+#if CONFIG_INSTRUMENT
+
+#if INSTRUMENT_TICK_SHIFT == 0
+#define INSTRUMENT_ID ID_0
+#elif INSTRUMENT_TICK_SHIFT == 1
+#define INSTRUMENT_ID ID_1
+#elif INSTRUMENT_TICK_SHIFT == 2
+#define INSTRUMENT_ID ID_2
+#elif INSTRUMENT_TICK_SHIFT == 3
+#define INSTRUMENT_ID ID_3
+#else
+#error INSTRUMENT_TICK_SHIFT must be 0 to 3
+#endif
+
+typedef struct {
+	uint32_t count;
+	uint32_t spins;
+	uint16_t spins_max;
+	uint16_t ticks_min;
+	uint16_t ticks_max;
+	uint32_t ticks;
+} instrument_probe_t;
+
+static SPRITE_STATE instrument_probe_t s_probes[INSTRUMENT_PROBES];
+
+void instrument_end(const instrument_span_t *span, uint8_t probe, uint8_t timed)
+{
+	instrument_probe_t *p = &s_probes[probe];
+
+	p->count++;
+	p->spins += span->spins;
+	if (span->spins > p->spins_max)
+		p->spins_max = span->spins;
+
+	if (timed)
+	{
+		uint16_t ticks = TA1R - span->start;
+
+		if (ticks < p->ticks_min)
+			p->ticks_min = ticks;
+		if (ticks > p->ticks_max)
+			p->ticks_max = ticks;
+		p->ticks += ticks;
+	}
+}
+
+void instrument_reset(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < INSTRUMENT_PROBES; i++)
+	{
+		s_probes[i].count = 0;
+		s_probes[i].spins = 0;
+		s_probes[i].spins_max = 0;
+		s_probes[i].ticks_min = 0xFFFF;
+		s_probes[i].ticks_max = 0;
+		s_probes[i].ticks = 0;
+	}
+
+	// Continuous mode from SMCLK: TA1R is a free-running tick counter
+	TA1CTL = TASSEL_2 | INSTRUMENT_ID | MC_2 | TACLR;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t value)
+{
+	p[0] = value;
+	p[1] = value >> 8;
+	return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t value)
+{
+	p = put16(p, value);
+	return put16(p, value >> 16);
+}
+
+unsigned int instrument_dump(uint8_t *buffer, unsigned int size)
+{
+	uint8_t *p = buffer;
+	uint8_t i;
+
+	if (size < INSTRUMENT_RECORD_SIZE)
+		return 0;
+
+	*p++ = INSTRUMENT_VERSION;
+	*p++ = INSTRUMENT_PROBES;
+	*p++ = INSTRUMENT_TICK_SHIFT;
+	*p++ = 0;
+
+	for (i = 0; i < INSTRUMENT_PROBES; i++)
+	{
+		const instrument_probe_t *probe = &s_probes[i];
+
+		p = put32(p, probe->count);
+		p = put32(p, probe->spins);
+		p = put16(p, probe->spins_max);
+		// Still 0xFFFF with ticks_max 0: nothing was timed
+		p = put16(p, probe->ticks_max ? probe->ticks_min : 0);
+		p = put16(p, probe->ticks_max);
+		p = put32(p, probe->ticks);
+	}
+
+	return p - buffer;
+}
+
+#endif
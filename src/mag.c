@@ -3,44 +3,121 @@
 
 */
 
-#include "SpriteMag.h"
-#include "utility/HMC5883L_Config.h"
-#include "TI_USCI_I2C_master.h"
+#include <math.h>
+
+#include "Energia.h"
+#include "mag.h"
+#include "HMC5883L.h"
+#include "i2cdevice.h"
+
+// Data registers are ordered X, Z, Y
+typedef I2CDevice<USCI_I2C, MAG_ADDRESS, AxisRegisters<MAG_DATA_REG, 0, 4, 2> > HMC5883L;
+
+static HMC5883L s_mag;
+
+// Microtesla per LSb at the configured gain
+static I2C_CONSTEXPR float magScale(uint8_t gain) {
+	return gain == 0x00 ? .073f :
+	       gain == 0x20 ? .092f :
+	       gain == 0x40 ? .122f :
+	       gain == 0x60 ? .152f :
+	       gain == 0x80 ? .227f :
+	       gain == 0xA0 ? .256f :
+	       gain == 0xC0 ? .303f : .435f;
+}
+
+#ifdef MAG_DRDY_PIN
+static volatile bool s_dataReady;
+
+static void magDataReady() {
+	s_dataReady = true;
+	wakeup();
+}
+#endif
 
 SpriteMag::SpriteMag() {
 
+	m_timeouts = 0;
 }
 
 void SpriteMag::init() {
 
-	m_sendBufer[0] = 0x00;
-	m_sendBufer[1] = (MAG_SAMPLES_AVE|MAG_DATA_RATE|MAG_MEAS_MODE);
+	s_mag.write(MAG_CONFIG_A_REG, MAG_SAMPLES_AVE|MAG_DATA_RATE|MAG_MEAS_MODE);
+	s_mag.write(MAG_CONFIG_B_REG, MAG_GAIN);
+
+#if MAG_OPER_MODE == MAG_MODE_SINGLE
+	// Stay idle until a measurement is requested
+	s_mag.write(MAG_MODE_REG, MAG_MODE_IDLE);
+#else
+	s_mag.write(MAG_MODE_REG, MAG_OPER_MODE);
+#endif
 
-	TI_USCI_I2C_transmitinit(MAG_ADDRESS, I2C_PRESCALE);
-	TI_USCI_I2C_transmit(m_sendBufer, 2);
+#ifdef MAG_DRDY_PIN
+	pinMode(MAG_DRDY_PIN, INPUT_PULLUP);
+	attachInterrupt(MAG_DRDY_PIN, magDataReady, FALLING);
+#endif
+}
+
+void SpriteMag::startMeasurement() {
 
-	m_sendBufer[0] = 0x01; m_sendBufer[1] = MAG_GAIN;
-	TI_USCI_I2C_transmit(m_sendBufer, 2);
+#ifdef MAG_DRDY_PIN
+	s_dataReady = false;
+#endif
 
-	m_sendBufer[0] = 0x02; m_sendBufer[1] = MAG_OPER_MODE;
-	TI_USCI_I2C_transmit(m_sendBufer, 2);
+	s_mag.write(MAG_MODE_REG, MAG_MODE_SINGLE);
 }
 
-MagneticField SpriteMag::read() {
+bool SpriteMag::dataReady() {
+
+	return s_mag.read(MAG_STATUS_REG, 1)[0] & MAG_STATUS_RDY;
+}
 
-	m_sendBufer[0] = 0x03;
+bool SpriteMag::waitForData() {
+
+#ifdef MAG_DRDY_PIN
+	// Sleep until the DRDY falling edge, whose wakeup() ends sleep() early,
+	// for no longer than the polling below: if the edge is lost, poll.
+	for (int i = 0; i < MAG_CONVERSION_MS && !s_dataReady; i++) {
+		sleep(1);
+	}
+	for (int i = 0; i < MAG_READY_RETRIES; i++) {
+		if (s_dataReady || dataReady())
+			return true;
+		sleep(1);
+	}
+	return s_dataReady || dataReady();
+#else
+	// Sleep through the conversion, then make sure it has finished
+	sleep(MAG_CONVERSION_MS);
+	for (int i = 0; i < MAG_READY_RETRIES; i++) {
+		if (dataReady())
+			return true;
+		sleep(1);
+	}
+	return dataReady();
+#endif
+}
+
+MagneticField SpriteMag::read() {
 
-	TI_USCI_I2C_transmitinit(MAG_ADDRESS, I2C_PRESCALE);
-	TI_USCI_I2C_transmit(m_sendBufer, 1);
+#if MAG_OPER_MODE == MAG_MODE_SINGLE
+	startMeasurement();
+	if (!waitForData()) {
+		// The data registers still hold the previous sample
+		m_timeouts++;
+		MagneticField none = { NAN, NAN, NAN };
+		return none;
+	}
+#endif
 
-	TI_USCI_I2C_receiveinit(MAG_ADDRESS, I2C_PRESCALE);
-	TI_USCI_I2C_receive(m_receiveBuffer, 6);
+	// Burst read of the six data registers
+	const unsigned char *data = s_mag.readData();
 
 	MagneticField b;
 	//Units are microtesla
-	b.x = -.073*((m_receiveBuffer[0] << 8) | m_receiveBuffer[1]);
-	b.z = .073*((m_receiveBuffer[2] << 8) | m_receiveBuffer[3]);
-	b.y = -.073*((m_receiveBuffer[4] << 8) | m_receiveBuffer[5]);
+	b.x = -magScale(MAG_GAIN)*HMC5883L::Layout::x(data);
+	b.z = magScale(MAG_GAIN)*HMC5883L::Layout::z(data);
+	b.y = -magScale(MAG_GAIN)*HMC5883L::Layout::y(data);
 
 	return b;
 }
@@ -2,7 +2,7 @@
  * Generated by Zac Manchester (KickSat) */
 
 #if CONFIG_PRN_0 == 2
-unsigned char PRN_0[64] = {
+const unsigned char PRN_0[64] = {
   0b00000001, 0b01011110, 0b11010100, 0b01100001, 0b00001011, 0b11110011, 0b00110001, 0b01011100,
   0b01100110, 0b10010010, 0b01011011, 0b00101010, 0b11100000, 0b10100011, 0b00000000, 0b11100001,
   0b10111011, 0b10011111, 0b00110001, 0b11001111, 0b11110111, 0b11000000, 0b10110010, 0b01110101,
@@ -15,7 +15,7 @@ unsigned char PRN_0[64] = {
 #endif
 
 #if CONFIG_PRN_1 == 3
-unsigned char PRN_1[64] = {
+const unsigned char PRN_1[64] = {
   0b11111101, 0b00111110, 0b01110111, 0b11010101, 0b00100101, 0b11101111, 0b00101100, 0b01101001,
   0b00101010, 0b11101001, 0b00111100, 0b11000100, 0b00000111, 0b10010011, 0b11000101, 0b00000111,
   0b00110111, 0b00011111, 0b01111011, 0b11010001, 0b10111010, 0b00000111, 0b10010000, 0b00110111,
@@ -28,7 +28,7 @@ unsigned char PRN_1[64] = {
 #endif
 
 #if CONFIG_PRN_0 == 266
-unsigned char PRN_0[64] = {
+const unsigned char PRN_0[64] = {
   0b11000010, 0b01001001, 0b01001110, 0b01010011, 0b00001010, 0b11011011, 0b01001000, 0b01101011,
   0b01111010, 0b00011011, 0b01010010, 0b11111101, 0b00010101, 0b10000000, 0b01101010, 0b11101101,
   0b01110001, 0b11001011, 0b01100010, 0b01000101, 0b00010010, 0b10100000, 0b10000101, 0b11111101,
@@ -41,7 +41,7 @@ unsigned char PRN_0[64] = {
 #endif
 
 #if CONFIG_PRN_1 == 267
-unsigned char PRN_1[64] = {
+const unsigned char PRN_1[64] = {
   0b01111011, 0b00010001, 0b01000011, 0b10110001, 0b00100111, 0b10111111, 0b11011110, 0b00000111,
   0b00010011, 0b11111011, 0b00101111, 0b01101011, 0b11101101, 0b11010101, 0b00010001, 0b00011110,
   0b10100011, 0b10110111, 0b11011100, 0b11000100, 0b01110000, 0b11000111, 0b11111111, 0b00100110,
@@ -54,7 +54,7 @@ unsigned char PRN_1[64] = {
 #endif
 
 #if CONFIG_PRN_0 == 268
-unsigned char PRN_0[64] = {
+const unsigned char PRN_0[64] = {
   0b00001001, 0b10100001, 0b01011000, 0b01110101, 0b01111101, 0b01110110, 0b11110010, 0b11011111,
   0b11000000, 0b00111011, 0b11010100, 0b01000110, 0b00011101, 0b01111111, 0b11100110, 0b11111001,
   0b00000111, 0b01001110, 0b10100001, 0b11000110, 0b10110100, 0b00001001, 0b00001010, 0b10010001,
@@ -67,7 +67,7 @@ unsigned char PRN_0[64] = {
 #endif
 
 #if CONFIG_PRN_1 == 269
-unsigned char PRN_1[64] = {
+const unsigned char PRN_1[64] = {
   0b11101100, 0b11000001, 0b01101111, 0b11111101, 0b11001000, 0b11100100, 0b10101011, 0b01101110,
   0b01100111, 0b10111010, 0b00100010, 0b00011101, 0b11111100, 0b00101010, 0b00001001, 0b00110110,
   0b01001110, 0b10111100, 0b01011011, 0b11000011, 0b00111101, 0b10010100, 0b11100001, 0b11111111,
@@ -1,8 +1,8 @@
 #ifndef LIBSPRITE_PRN_H
 #define LIBSPRITE_PRN_H
 
-/* A pair of PRN arrays for communication using Gold codes */
-static unsigned char PRN_0[];
-static unsigned char PRN_1[];
+/* A pair of PRN arrays for communication using Gold codes, kept in flash */
+extern const unsigned char PRN_0[];
+extern const unsigned char PRN_1[];
 
 #endif // LIBSPRITE_PRN_H
@@ -0,0 +1,45 @@
+/*
+  radio.c - Transmitter API of libsprite, see radio.h
+*/
+
+#include "SpriteRadio.h"
+
+void radio_init()
+{
+	SpriteRadio_SpriteRadio();
+}
+
+void radio_setPower(int tx_power_dbm)
+{
+	SpriteRadio_setPower(tx_power_dbm);
+}
+
+void radio_rawTransmit(const unsigned char bytes[], unsigned int length)
+{
+	SpriteRadio_rawTransmit(bytes, length);
+}
+
+void radio_transmitByte(const char byte)
+{
+	SpriteRadio_transmitByte(byte);
+}
+
+void radio_transmit(const char bytes[], unsigned int length)
+{
+	SpriteRadio_transmit(bytes, length);
+}
+
+void radio_transmitv(const radio_segment_t segments[], unsigned int count)
+{
+	SpriteRadio_transmitv(segments, count);
+}
+
+void radio_txInit()
+{
+	SpriteRadio_txInit();
+}
+
+void radio_sleep()
+{
+	SpriteRadio_sleep();
+}
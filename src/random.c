@@ -43,6 +43,8 @@ static char sccsid[] = "@(#)rand.c	8.1 (Berkeley) 6/14/93";
 
 #include <stdlib.h>
 
+#include "state.h"
+
 static long
 do_random(unsigned long *ctx)
 {
@@ -76,7 +78,7 @@ random_r(unsigned long *ctx)
 }
 
 
-static unsigned long next = 1;
+static SPRITE_STATE unsigned long next = 1;
 
 long
 random(void)
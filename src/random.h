@@ -4,3 +4,4 @@
 * until msp430-libc adds supports for random and srandom */
 long random(void);
 void srandom(unsigned long __seed);
+long random_r(unsigned long *ctx);
@@ -0,0 +1,105 @@
+/*
+  ringbuf.c - Lock-free single-producer/single-consumer queue of variable-length records
+
+  Records never wrap around the end of the buffer, so that both sides can use
+  them in place. When a record does not fit before the end, the producer writes
+  a wrap marker and the record starts again at offset 0.
+*/
+
+#include <stdint.h>
+
+#include "ringbuf.h"
+
+#define WRAP_MARKER 0xFFFF
+
+// Indexes are published with release stores and read with acquire loads. On the
+// MSP430 these are plain aligned word accesses with a compiler barrier.
+#define LOAD_ACQUIRE(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static inline uint16_t *header(ringbuf_t *rb, uint16_t index)
+{
+	return (uint16_t *)(rb->buffer + (index & rb->mask));
+}
+
+void ringbuf_init(ringbuf_t *rb, uint8_t *storage, uint16_t size)
+{
+	rb->buffer = storage;
+	rb->mask = size - 1;
+	rb->head = 0;
+	rb->tail = 0;
+	rb->pad = 0;
+	rb->peeked = 0;
+}
+
+uint8_t *ringbuf_reserve(ringbuf_t *rb, uint16_t length)
+{
+	uint16_t head = rb->head;
+	uint16_t tail = LOAD_ACQUIRE(&rb->tail);
+	uint16_t size = rb->mask + 1;
+	uint16_t free = size - (uint16_t)(head - tail);
+	uint16_t offset = head & rb->mask;
+	uint16_t contiguous = size - offset;
+	uint16_t need;
+
+	// A record of up to half the buffer fits either before its end or at
+	// offset 0 once the queue drains; a larger one may fit in neither
+	if (length > RINGBUF_MAX_LENGTH(size))
+		return 0;
+	need = RINGBUF_RECORD_SIZE(length);
+
+	if (need <= contiguous) {
+		if (need > free)
+			return 0;
+		rb->pad = 0;
+		return rb->buffer + offset + RINGBUF_HEADER_SIZE;
+	}
+
+	// Skip the end of the buffer and start over at offset 0
+	if ((uint16_t)(contiguous + need) > free)
+		return 0;
+	rb->pad = contiguous;
+	return rb->buffer + RINGBUF_HEADER_SIZE;
+}
+
+void ringbuf_commit(ringbuf_t *rb, uint16_t length)
+{
+	uint16_t head = rb->head;
+
+	if (rb->pad) {
+		*header(rb, head) = WRAP_MARKER;
+		head += rb->pad;
+		rb->pad = 0;
+	}
+	*header(rb, head) = length;
+	STORE_RELEASE(&rb->head, (uint16_t)(head + RINGBUF_RECORD_SIZE(length)));
+}
+
+const uint8_t *ringbuf_peek(ringbuf_t *rb, uint16_t *length)
+{
+	uint16_t tail = rb->tail;
+	uint16_t head = LOAD_ACQUIRE(&rb->head);
+	uint16_t value;
+
+	if (head == tail)
+		return 0;
+
+	value = *header(rb, tail);
+	if (value == WRAP_MARKER) {
+		tail += (rb->mask + 1) - (tail & rb->mask);
+		STORE_RELEASE(&rb->tail, tail);
+		if (head == tail)
+			return 0;
+		value = *header(rb, tail);
+	}
+
+	rb->peeked = RINGBUF_RECORD_SIZE(value);
+	*length = value;
+	return rb->buffer + (tail & rb->mask) + RINGBUF_HEADER_SIZE;
+}
+
+void ringbuf_release(ringbuf_t *rb)
+{
+	STORE_RELEASE(&rb->tail, (uint16_t)(rb->tail + rb->peeked));
+	rb->peeked = 0;
+}
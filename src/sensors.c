@@ -0,0 +1,157 @@
+/*
+  sensors.c - Multi-rate sampling scheduler for sensors sharing the I2C bus
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "cc430f5137.h"
+#include "SpriteRadio.h"
+#include "ClockConfig.h"
+#include "sensors.h"
+
+// Signed difference of two micros() values, valid across wrap-around
+#define TIME_DIFF(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)))
+
+void sensors_init(sensor_sched_t *sched, uint32_t window_us,
+                  void (*bus_begin)(void), void (*bus_end)(void))
+{
+	memset(sched, 0, sizeof(*sched));
+	sched->window_us = window_us;
+	sched->bus_begin = bus_begin;
+	sched->bus_end = bus_end;
+}
+
+int sensors_add(sensor_sched_t *sched, sensor_t *sensor, uint32_t period_us,
+                sensor_read_fn read, void *context, uint8_t sample_size,
+                ringbuf_t *buffer)
+{
+	if (sched->count >= SENSORS_MAX)
+		return 0;
+
+	memset(sensor, 0, sizeof(*sensor));
+	sensor->period_us = period_us;
+	sensor->next_due = micros();
+	sensor->read = read;
+	sensor->context = context;
+	sensor->sample_size = sample_size;
+	sensor->buffer = buffer;
+	sensor->jitter_min_us = INT32_MAX;
+	sensor->jitter_max_us = INT32_MIN;
+
+	sched->sensors[sched->count++] = sensor;
+	return 1;
+}
+
+__attribute__((interrupt(TIMER0_A0_VECTOR)))
+void timer0_a0_isr(void)
+{
+	TA0CTL = MC_0;
+	TA0CCTL0 = 0;
+	__bic_SR_register_on_exit(LPM0_bits);
+}
+
+// Sleep in LPM0 for at least us microseconds, in one-shot intervals of
+// Timer_A0, while the watchdog keeps time without waking the CPU
+static void sleepFor(uint32_t us)
+{
+	uint32_t interval, ticks;
+
+	wakeOnTick(0);
+	while (us > 0)
+	{
+		interval = us < CLOCK_TIMER_MAX_US ? us : CLOCK_TIMER_MAX_US;
+		us -= interval;
+
+		// Up mode counts TA0CCR0 + 1 ticks and halts at TA0CCR0 = 0, so a
+		// tick or less is not slept for
+		ticks = (interval * CLOCK_CYCLES_PER_US + CLOCK_TIMER_DIV - 1) / CLOCK_TIMER_DIV;
+		if (ticks < 2)
+			continue;
+
+		// Arm and sleep with interrupts disabled, so that an interrupt in
+		// between cannot be lost: setting GIE and CPUOFF is atomic
+		__dint();
+		TA0CCR0 = ticks - 1;
+		TA0CCTL0 = CCIE;
+		TA0CTL = TASSEL_2 | ID_3 | MC_1 | TACLR;
+		while (TA0CCTL0 & CCIE)
+		{
+			__bis_SR_register(LPM0_bits + GIE);
+			__dint();
+		}
+		__eint();
+	}
+	wakeOnTick(1);
+}
+
+static void sample(sensor_t *sensor)
+{
+	uint32_t now = micros();
+	int32_t jitter = TIME_DIFF(now, sensor->next_due);
+	uint8_t *record;
+
+	if (jitter < sensor->jitter_min_us)
+		sensor->jitter_min_us = jitter;
+	if (jitter > sensor->jitter_max_us)
+		sensor->jitter_max_us = jitter;
+
+	record = ringbuf_reserve(sensor->buffer, SENSOR_TIMESTAMP_SIZE + sensor->sample_size);
+	if (record)
+	{
+		memcpy(record, &now, SENSOR_TIMESTAMP_SIZE);
+		sensor->read(sensor->context, record + SENSOR_TIMESTAMP_SIZE);
+		ringbuf_commit(sensor->buffer, SENSOR_TIMESTAMP_SIZE + sensor->sample_size);
+		sensor->samples++;
+	}
+	else
+	{
+		sensor->dropped++;
+	}
+
+	// Keep the schedule anchored to the original phase, skipping whole
+	// periods if we fell behind
+	sensor->next_due += sensor->period_us;
+	while (TIME_DIFF(now, sensor->next_due) >= (int32_t)sensor->period_us)
+	{
+		sensor->next_due += sensor->period_us;
+		sensor->missed++;
+	}
+}
+
+void sensors_run(sensor_sched_t *sched)
+{
+	uint32_t due, start;
+	uint8_t i;
+
+	if (sched->count == 0)
+		return;
+
+	due = sched->sensors[0]->next_due;
+	for (i = 1; i < sched->count; i++)
+	{
+		if (TIME_DIFF(sched->sensors[i]->next_due, due) < 0)
+			due = sched->sensors[i]->next_due;
+	}
+
+	// Sleep until the session is due. micros() only advances at the end of
+	// a watchdog interval, so it lags and the wait is never short.
+	if (TIME_DIFF(due, micros()) > 0)
+		sleepFor(TIME_DIFF(due, micros()));
+
+	start = micros();
+	if (sched->bus_begin)
+		sched->bus_begin();
+
+	for (i = 0; i < sched->count; i++)
+	{
+		if (TIME_DIFF(sched->sensors[i]->next_due, due) <= (int32_t)sched->window_us)
+			sample(sched->sensors[i]);
+	}
+
+	if (sched->bus_end)
+		sched->bus_end();
+
+	sched->sessions++;
+	sched->busy_us += micros() - start;
+}
@@ -0,0 +1,11 @@
+#ifndef LIBSPRITE_STATE_H
+#define LIBSPRITE_STATE_H
+
+/* Storage class of the library's mutable global state. Empty on target; the
+ * host emulator defines it as __thread so that every worker thread runs its
+ * own sprite instance. */
+#ifndef SPRITE_STATE
+#define SPRITE_STATE
+#endif
+
+#endif // LIBSPRITE_STATE_H
@@ -0,0 +1,242 @@
+/*
+  uplink.c - Wake-on-radio receiver for commands from the ground
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "cc430f5137.h"
+#include "CC430Radio.h"
+#include "SpriteRadio.h"
+#include "CC1101Config.h"
+#include "uplink.h"
+#include "ringbuf.h"
+#include "state.h"
+
+// Address of this sprite, matched by the packet engine
+#ifndef CONFIG_UPLINK_ADDRESS
+#define CONFIG_UPLINK_ADDRESS 0x01
+#endif
+
+// Sync word sent by the ground station
+#ifndef CONFIG_UPLINK_SYNC
+#define CONFIG_UPLINK_SYNC 0xD391
+#endif
+
+#define UPLINK_QUEUE_SIZE  256      // Bytes, a power of two
+#define UPLINK_STATUS_SIZE 2        // RSSI and LQI/CRC_OK appended by the radio
+#define UPLINK_PKTLEN      (UPLINK_HEADER_SIZE + UPLINK_MAX_ARGS)
+
+// WOR timer: EVENT0 counts periods of 750 / f_xosc with WORCTRL.WOR_RES = 0
+#define UPLINK_EVENT0(ms)  ((unsigned long)(ms) * (CONFIG_RF_XOSC_FREQ / 1000) / 750)
+
+	// Receiver configuration, as recommended by SmartRF Studio for 2-FSK at
+	// low data rates. The TEST registers are left at their reset values,
+	// which they return to whenever WOR puts the core to sleep.
+	static const CC1101Settings m_rx_settings = {
+		0x06,   // FSCTRL1   IF frequency 152 kHz
+		0x00,   // FSCTRL0
+		CC1101_FREQ2,   // FREQ2
+		CC1101_FREQ1,   // FREQ1
+		CC1101_FREQ0,   // FREQ0
+		CC1101_UPLINK_MDMCFG4, // MDMCFG4
+		CC1101_UPLINK_MDMCFG3, // MDMCFG3
+		0x03,   // MDMCFG2   2-FSK, 30/32 sync word bits
+		0x22,   // MDMCFG1   4 preamble bytes
+		0xF8,   // MDMCFG0
+		CC1101_CHANNR,  // CHANNR
+		CC1101_UPLINK_DEVIATN, // DEVIATN
+		0x56,   // FREND1
+		0x10,   // FREND0
+		0x38,   // MCSM0     Calibrate on every 4th wake-up, PO_TIMEOUT = 64
+		0x16,   // FOCCFG
+		0x6C,   // BSCFG
+		0x43,   // AGCCTRL2
+		0x40,   // AGCCTRL1
+		0x91,   // AGCCTRL0
+		0xE9,   // FSCAL3
+		0x2A,   // FSCAL2
+		0x00,   // FSCAL1
+		0x1F,   // FSCAL0
+		0x59,   // FSTEST
+		0x88,   // TEST2
+		0x31,   // TEST1
+		0x0B,   // TEST0
+		0x47,   // FIFOTHR
+		0x29,   // IOCFG2
+		0x06,   // IOCFG0    Sync word received / end of packet
+		0x26,   // PKTCTRL1  PQT = 4, append status, address check with 0x00 broadcast
+		0x05,   // PKTCTRL0  CRC, variable packet length
+		CONFIG_UPLINK_ADDRESS, // ADDR
+		UPLINK_PKTLEN   // PKTLEN    Longest packet accepted
+	};
+
+	static SPRITE_STATE uint16_t m_storage[UPLINK_QUEUE_SIZE / 2];
+	static SPRITE_STATE ringbuf_t m_queue;
+	static SPRITE_STATE uplink_stats_t m_stats;
+	static SPRITE_STATE uint8_t m_sequence;
+	static SPRITE_STATE uint8_t m_sequence_valid;
+
+static void waitIdle(void)
+{
+	char status;
+
+	status = strobe(RF_SIDLE);
+	while (status & 0xF0)
+	{
+		status = strobe(RF_SNOP);
+	}
+}
+
+// Read the packet in the RX FIFO and queue it if it is a command for us
+static void receivePacket(void)
+{
+	unsigned char packet[1 + UPLINK_PKTLEN + UPLINK_STATUS_SIZE];
+	unsigned char bytes = readRegister(RXBYTES);
+	unsigned char length;
+	uplink_command_t *command;
+
+	m_stats.packets++;
+
+	// Overflowed, or longer than the packet engine lets through
+	if ((bytes & 0x80) || bytes > sizeof(packet) || bytes < 1 + UPLINK_STATUS_SIZE)
+	{
+		m_stats.malformed++;
+		strobe(RF_SFRX);
+		return;
+	}
+	readRXBuffer(packet, bytes);
+	length = packet[0];
+
+	if (!(packet[bytes - 1] & 0x80))  // CRC_OK
+	{
+		m_stats.crc_errors++;
+		return;
+	}
+	if (length + 1 + UPLINK_STATUS_SIZE != bytes || length < UPLINK_HEADER_SIZE ||
+	    (packet[1] != CONFIG_UPLINK_ADDRESS && packet[1] != UPLINK_BROADCAST))
+	{
+		m_stats.malformed++;
+		return;
+	}
+	// The ground repeats a command until it is acknowledged
+	if (m_sequence_valid && packet[2] == m_sequence)
+	{
+		m_stats.duplicates++;
+		return;
+	}
+
+	command = (uplink_command_t *)ringbuf_reserve(&m_queue, sizeof(*command));
+	if (!command)
+	{
+		m_stats.dropped++;
+		return;
+	}
+	command->address = packet[1];
+	command->sequence = packet[2];
+	command->opcode = packet[3];
+	command->length = length - UPLINK_HEADER_SIZE;
+	memcpy(command->args, packet + 1 + UPLINK_HEADER_SIZE, command->length);
+	command->rssi = packet[bytes - 2];
+	command->lqi = packet[bytes - 1];
+	ringbuf_commit(&m_queue, sizeof(*command));
+
+	m_sequence = packet[2];
+	m_sequence_valid = 1;
+	m_stats.accepted++;
+}
+
+__attribute__((interrupt(CC1101_VECTOR)))
+void cc1101_isr(void)
+{
+	switch (RF1AIV)
+	{
+	case RF1AIV_RFIFG9:   // Falling edge: end of packet
+		// MCSM1.RXOFF_MODE has put the core in IDLE
+		receivePacket();
+		strobe(RF_SWOR);
+		__bic_SR_register_on_exit(LPM3_bits);
+		break;
+	default:
+		break;
+	}
+}
+
+void uplink_start(uint16_t period_ms, uint8_t duty_shift)
+{
+	unsigned long event0 = UPLINK_EVENT0(period_ms);
+
+	if (event0 == 0)
+		event0 = 1;
+	if (event0 > 0xFFFF)
+		event0 = 0xFFFF;
+	if (duty_shift > UPLINK_DUTY_MAX)
+		duty_shift = UPLINK_DUTY_MAX;
+
+	if (!m_queue.buffer)
+		ringbuf_init(&m_queue, (uint8_t *)m_storage, sizeof(m_storage));
+
+	SpriteRadio_wake();
+	waitIdle();
+
+	writeConfiguration(&m_rx_settings);
+	writeRegister(SYNC1,   (CONFIG_UPLINK_SYNC >> 8) & 0xFF);
+	writeRegister(SYNC0,   CONFIG_UPLINK_SYNC & 0xFF);
+	writeRegister(MCSM2,   0x18 | duty_shift);  // RX_TIME_RSSI, RX_TIME_QUAL, RX_TIME
+	writeRegister(MCSM1,   0x30);               // RXOFF_MODE and TXOFF_MODE = IDLE
+	writeRegister(WOREVT1, event0 >> 8);
+	writeRegister(WOREVT0, event0 & 0xFF);
+	writeRegister(WORCTRL, 0x38);               // EVENT1 = 12 RC periods, RC_CAL, WOR_RES = 0
+	strobe(RF_SFRX);
+
+	RF1AIES |= BIT9;
+	RF1AIFG &= ~BIT9;
+	RF1AIE |= BIT9;
+
+	strobe(RF_SWORRST);
+	strobe(RF_SWOR);
+}
+
+void uplink_stop(void)
+{
+	RF1AIE &= ~BIT9;
+	waitIdle();
+	SpriteRadio_txInit();
+}
+
+int uplink_receive(uplink_command_t *command)
+{
+	const uint8_t *record;
+	uint16_t length;
+
+	if (!m_queue.buffer || !(record = ringbuf_peek(&m_queue, &length)))
+		return 0;
+	memcpy(command, record, sizeof(*command));
+	ringbuf_release(&m_queue);
+	return 1;
+}
+
+void uplink_wait(void)
+{
+	uint16_t length;
+
+	// With the watchdog on SMCLK, LPM3 would keep SMCLK and the DCO running
+	keepTimeOnACLK(1);
+
+	// Check and sleep with interrupts disabled, so that a command queued in
+	// between still wakes us: setting GIE and CPUOFF is atomic.
+	for (;;)
+	{
+		__dint();
+		if (m_queue.buffer && ringbuf_peek(&m_queue, &length))
+			break;
+		__bis_SR_register(LPM3_bits + GIE);
+	}
+	__eint();
+	keepTimeOnACLK(0);
+}
+
+const uplink_stats_t *uplink_stats(void)
+{
+	return &m_stats;
+}